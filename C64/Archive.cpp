@@ -22,6 +22,7 @@
 #include "P00Archive.h"
 #include "G64Archive.h"
 #include "NIBArchive.h"
+#include "PackedFile.h"
 
 Archive::Archive()
 {
@@ -54,9 +55,32 @@ Archive::makeArchiveWithFile(const char *path)
     if (NIBArchive::isNIBFile(path)) {
         return NIBArchive::makeNIBArchiveWithFile(path);
     }
+    if (PackedFile::isZipPath(path)) {
+        return makeArchiveWithZipFile(path);
+    }
     return NULL;
 }
 
+Archive *
+Archive::makeArchiveWithZipFile(const char *path)
+{
+    PackedFile *zip = PackedFile::makePackedFileWithPath(path);
+    Archive *archive = NULL;
+    
+    if (zip == NULL)
+        return NULL;
+    
+    for (unsigned i = 0; archive == NULL && i < zip->getNumberOfMembers(); i++) {
+        
+        char *member = PackedFile::makeMemberPath(path, zip->getNameOfMember(i));
+        archive = makeArchiveWithFile(member);
+        free(member);
+    }
+    
+    delete zip;
+    return archive;
+}
+
 size_t
 Archive::getSizeOfItem(int n)
 {
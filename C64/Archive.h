@@ -48,8 +48,16 @@ public:
     //! Factory methods
     //
     
+    /*! @brief    Creates an archive from a file
+     *  @details  Packed files are decompressed on the fly. If a zip archive is passed
+     *            as a whole, the first member that can be read as an archive is taken.
+     *  @see      PackedFile
+     */
     static Archive *makeArchiveWithFile(const char *filename);
     
+    //! @brief    Creates an archive from the first suitable member of a zip archive
+    static Archive *makeArchiveWithZipFile(const char *filename);
+    
     //
     //! Accessing archive attributes
     //
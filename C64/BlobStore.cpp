@@ -0,0 +1,201 @@
+/*!
+ * @header      BlobStore.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "BlobStore.h"
+
+BlobStore::Blob *BlobStore::blobs = NULL;
+pthread_mutex_t BlobStore::lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t
+BlobStore::hash(const uint8_t *data, size_t size)
+{
+    uint64_t result = hashBlock(data, size, 0);
+    return result ? result : 1;
+}
+
+BlobStore::Blob *
+BlobStore::find(uint64_t hash)
+{
+    for (Blob *blob = blobs; blob != NULL; blob = blob->next) {
+        if (blob->hash == hash)
+            return blob;
+    }
+    return NULL;
+}
+
+uint64_t
+BlobStore::insert(const uint8_t *data, size_t size)
+{
+    uint64_t h = hash(data, size);
+    return insert(h, data, size) ? h : 0;
+}
+
+uint64_t
+BlobStore::share(const uint8_t *data, size_t size, const void *owner)
+{
+    assert(owner != NULL);
+    
+    uint64_t h = hash(data, size);
+    bool result = true;
+    
+    pthread_mutex_lock(&lock);
+    
+    Blob *blob = find(h);
+    
+    if (blob != NULL) {
+        
+        // Make sure that we don't mix up different data with the same hash
+        if (blob->size == size && memcmp(blob->data, data, size) == 0) {
+            blob->refCount++;
+        } else {
+            result = false;
+        }
+        
+    } else {
+        
+        blob = new Blob;
+        blob->hash = h;
+        blob->data = data;
+        blob->size = size;
+        blob->owner = owner;
+        blob->refCount = 1;
+        blob->next = blobs;
+        blobs = blob;
+    }
+    
+    pthread_mutex_unlock(&lock);
+    return result ? h : 0;
+}
+
+bool
+BlobStore::insert(uint64_t hash, const uint8_t *data, size_t size)
+{
+    bool result = true;
+
+    pthread_mutex_lock(&lock);
+
+    Blob *blob = find(hash);
+
+    if (blob != NULL) {
+
+        // Make sure that we don't mix up different data with the same hash
+        if (blob->size == size && memcmp(blob->data, data, size) == 0) {
+            blob->refCount++;
+        } else {
+            result = false;
+        }
+
+    } else if (BlobStore::hash(data, size) == hash) {
+
+        uint8_t *copy = new uint8_t[size];
+        memcpy(copy, data, size);
+        
+        blob = new Blob;
+        blob->hash = hash;
+        blob->data = copy;
+        blob->size = size;
+        blob->owner = NULL;
+        blob->refCount = 1;
+        blob->next = blobs;
+        blobs = blob;
+
+    } else {
+        result = false;
+    }
+
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+bool
+BlobStore::retain(uint64_t hash)
+{
+    pthread_mutex_lock(&lock);
+
+    Blob *blob = find(hash);
+    if (blob != NULL)
+        blob->refCount++;
+
+    pthread_mutex_unlock(&lock);
+    return blob != NULL;
+}
+
+void
+BlobStore::release(uint64_t hash)
+{
+    unshare(hash, NULL);
+}
+
+void
+BlobStore::unshare(uint64_t hash, const void *owner)
+{
+    pthread_mutex_lock(&lock);
+
+    for (Blob **ptr = &blobs; *ptr != NULL; ptr = &(*ptr)->next) {
+
+        Blob *blob = *ptr;
+        if (blob->hash != hash)
+            continue;
+
+        assert(blob->refCount > 0);
+        if (--blob->refCount == 0) {
+            *ptr = blob->next;
+            if (blob->owner == NULL)
+                delete[] blob->data;
+            delete blob;
+        } else if (owner != NULL && blob->owner == owner) {
+            
+            // The owner is about to modify its buffer. Others still need the data.
+            uint8_t *copy = new uint8_t[blob->size];
+            memcpy(copy, blob->data, blob->size);
+            blob->data = copy;
+            blob->owner = NULL;
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+bool
+BlobStore::copy(uint64_t hash, uint8_t *dst, size_t size)
+{
+    pthread_mutex_lock(&lock);
+
+    Blob *blob = find(hash);
+    bool result = blob != NULL && blob->size == size;
+    if (result)
+        memcpy(dst, blob->data, size);
+
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+size_t
+BlobStore::size(uint64_t hash)
+{
+    pthread_mutex_lock(&lock);
+
+    Blob *blob = find(hash);
+    size_t result = blob ? blob->size : 0;
+
+    pthread_mutex_unlock(&lock);
+    return result;
+}
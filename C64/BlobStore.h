@@ -0,0 +1,112 @@
+/*!
+ * @header      BlobStore.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _BLOBSTORE_INC
+#define _BLOBSTORE_INC
+
+#include "basic.h"
+
+/*! @class    BlobStore
+ *  @brief    Content-addressed storage for large immutable data blocks
+ *  @details  ROM images, disks, and tapes are stored only once, no matter how many
+ *            snapshots refer to them. A blob is identified by the hash of its contents
+ *            and freed when its reference counter drops to zero. The hash value 0 is
+ *            reserved for "no blob". The store is shared by all emulator instances
+ *            and can be accessed from any thread.
+ *
+ *            A blob created with share() refers to the buffer of its owner instead of
+ *            copying it. The owner must call unshare() before it modifies or frees the
+ *            buffer. If the blob is still referenced by others, e.g., by a snapshot, the
+ *            data is copied at that point.
+ */
+class BlobStore {
+
+private:
+
+    //! @brief    A single blob
+    typedef struct Blob {
+
+        uint64_t hash;
+        const uint8_t *data;
+        size_t size;
+        
+        //! @brief    Owner of the buffer the blob refers to (NULL if the blob owns its data)
+        const void *owner;
+        unsigned refCount;
+        struct Blob *next;
+
+    } Blob;
+
+    //! @brief    All stored blobs
+    static Blob *blobs;
+
+    //! @brief    Protects the blob list
+    static pthread_mutex_t lock;
+
+    //! @brief    Returns the blob with the specified hash or NULL (lock must be held)
+    static Blob *find(uint64_t hash);
+
+public:
+
+    //! @brief    Computes the hash of a data block (never 0)
+    static uint64_t hash(const uint8_t *data, size_t size);
+
+    /*! @brief    Stores a data block
+     *  @details  If a blob with the same contents exists, its reference counter is
+     *            increased. Otherwise, the data is copied into a new blob.
+     *  @return   The hash of the blob or 0, if the hash is taken by other data.
+     */
+    static uint64_t insert(const uint8_t *data, size_t size);
+
+    /*! @brief    Stores a data block without copying it
+     *  @details  Like insert(), but a new blob refers to the data where it is. The buffer
+     *            must stay unchanged until unshare() is called with the same owner.
+     *  @param    owner  Identifies the reference of the owner, e.g., the address of the
+     *                   variable storing the hash.
+     */
+    static uint64_t share(const uint8_t *data, size_t size, const void *owner);
+
+    /*! @brief    Stores a data block under a known hash
+     *  @return   false, if the hash does not match the data.
+     */
+    static bool insert(uint64_t hash, const uint8_t *data, size_t size);
+
+    //! @brief    Increases the reference counter of a blob
+    static bool retain(uint64_t hash);
+
+    //! @brief    Decreases the reference counter of a blob and frees it if unused
+    static void release(uint64_t hash);
+    
+    /*! @brief    Releases a reference obtained with share()
+     *  @details  If other references remain, the blob takes a copy of the owner's buffer.
+     *            Works like release() if the blob doesn't refer to the owner's buffer.
+     */
+    static void unshare(uint64_t hash, const void *owner);
+
+    /*! @brief    Copies the contents of a blob into a buffer
+     *  @return   false, if the blob does not exist or has a different size.
+     */
+    static bool copy(uint64_t hash, uint8_t *dst, size_t size);
+
+    //! @brief    Returns the size of a blob (0 if the blob does not exist)
+    static size_t size(uint64_t hash);
+};
+
+#endif
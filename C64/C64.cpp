@@ -54,7 +54,8 @@ void
 	
 	// Prepare to run...
 	c64->cpu.clearErrorState();
-	c64->floppy.cpu.clearErrorState();
+	for (unsigned i = 0; i < IEC::numDrives; i++)
+		c64->floppy[i].cpu.clearErrorState();
 	c64->restartTimer();
     
 	while (1) {		
@@ -70,6 +71,14 @@ void
 }
 
 
+//! @brief    Default time source (reads the host's wall clock)
+static uint64_t hostTime(const void *sender)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (uint64_t)1000000 * (uint64_t)t.tv_sec + (uint64_t)t.tv_usec;
+}
+
 //
 // Class methods
 //
@@ -83,6 +92,15 @@ C64::C64()
     warp = false;
     alwaysWarp = false;
     warpLoad = false;
+    instantLoad = false;
+    setRandomSeed(0);
+    setTimeSource(NULL, NULL);
+    runAheadFrames = 0;
+    runningAhead = false;
+    runAheadStopped = false;
+    runAheadState = NULL;
+    runAheadStateSize = 0;
+    realTime = true;
 	
     // Register sub components
     VirtualComponent *subcomponents[] = {
@@ -95,7 +113,7 @@ C64::C64()
         &cia1, &cia2,
         &iec,
         &expansionport,
-        &floppy,
+        &floppy[0], &floppy[1], &floppy[2], &floppy[3],
         &datasette,
         &keyboard,
         &joystickA,
@@ -105,6 +123,14 @@ C64::C64()
     registerSubComponents(subcomponents, sizeof(subcomponents));
     setC64(this);
     
+    // Tag the entry point of the KERNAL LOAD routine (reached via the ILOAD vector at $0330)
+    cpu.setBreakpoint(0xF4A5, EMULATOR_TRAP);
+    
+    // Tag the KERNAL serial bus routines
+    uint16_t serialRoutines[] = { 0xED09, 0xED0C, 0xEDB9, 0xEDC7, 0xEDDD, 0xEDEF, 0xEDFE, 0xEE13 };
+    for (unsigned i = 0; i < sizeof(serialRoutines) / sizeof(uint16_t); i++)
+        cpu.setBreakpoint(serialRoutines[i], EMULATOR_TRAP);
+    
     // Register snapshot items
     SnapshotItem items[] = {
  
@@ -120,6 +146,7 @@ C64::C64()
         { &rasterline,      sizeof(rasterline),         CLEAR_ON_RESET },
         { &rasterlineCycle, sizeof(rasterlineCycle),    CLEAR_ON_RESET },
         { &ultimax,         sizeof(ultimax),            CLEAR_ON_RESET },
+        { &randomState,     sizeof(randomState),        KEEP_ON_RESET },
         { NULL,             0,                          0 }};
     
     registerSnapshotItems(items, sizeof(items));
@@ -129,11 +156,11 @@ C64::C64()
     mem.cpu = &cpu;
     // cia1.tod.cia = &cia1;
     // cia2.tod.cia = &cia2;
-    floppy.cpu.mem = &c64->floppy.mem;
-    floppy.mem.cpu = &c64->floppy.cpu;
-    floppy.mem.iec = &c64->iec;
-    floppy.mem.floppy = &c64->floppy;
-    floppy.iec = &c64->iec;
+    for (unsigned i = 0; i < IEC::numDrives; i++) {
+        floppy[i].setDeviceNr(8 + i);
+        floppy[i].mem.iec = &iec;
+        floppy[i].iec = &iec;
+    }
     
     // Configure VIC
     setPAL();
@@ -150,6 +177,7 @@ C64::C64()
     }
     autoSaveSnapshots = true;
     autoSaveInterval = 3;
+    screenshotScale = 4;
 
     reset();
 }
@@ -158,6 +186,8 @@ C64::~C64()
 {
     debug(1, "Destroying virtual C64[%p]\n", this);
 	halt();
+    
+    delete[] runAheadState;
 }
 
 void
@@ -281,7 +311,7 @@ C64::threadCleanup()
 bool
 C64::isRunnable()
 {
-    return mem.basicRomIsLoaded() && mem.charRomIsLoaded() && mem.kernalRomIsLoaded() && floppy.mem.romIsLoaded();
+    return mem.basicRomIsLoaded() && mem.charRomIsLoaded() && mem.kernalRomIsLoaded() && floppy[0].mem.romIsLoaded();
 }
 
 bool
@@ -315,7 +345,8 @@ C64::step()
 {
     // Clear error states
     cpu.clearErrorState();
-    floppy.cpu.clearErrorState();
+    for (unsigned i = 0; i < IEC::numDrives; i++)
+        floppy[i].cpu.clearErrorState();
     
     // Execute next command
     do {
@@ -341,7 +372,8 @@ C64::step()
 if (cycle >= wakeUpCycleCIA1) cia1.executeOneCycle(); else idleCounterCIA1++; \
 if (cycle >= wakeUpCycleCIA2) cia2.executeOneCycle(); else idleCounterCIA2++; \
 if (!cpu.executeOneCycle()) result = false; \
-if (!floppy.executeOneCycle()) result = false; \
+for (unsigned i = 0; i < IEC::numDrives; i++) \
+    if (iec.driveIsConnected(8 + i) && !floppy[i].executeOneCycle()) result = false; \
 datasette.execute(); \
 cycle++; \
 rasterlineCycle++;
@@ -504,6 +536,18 @@ C64::executeOneLine()
     return true;
 }
 
+bool
+C64::executeOneFrame()
+{
+    uint64_t current = frame;
+    
+    while (frame == current) {
+        if (!executeOneLine())
+            return false;
+    }
+    return true;
+}
+
 void
 C64::beginOfRasterline()
 {
@@ -544,13 +588,31 @@ C64::endOfFrame()
     iec.execute();
     expansionport.execute();
     
+    // Frames computed ahead of time are discarded. Skip everything else.
+    if (runningAhead)
+        return;
+    
+    // Share the disks that have been encoded in the background
+    for (unsigned i = 0; i < IEC::numDrives; i++)
+        floppy[i].disk.checkEncoding();
+    
     // Take a snapshot once in a while
     if (autoSaveSnapshots && frame % (vic.getFramesPerSecond() * autoSaveInterval) == 0) {
         takeAutoSnapshot();
     }
     
+    // Record the current state for rewinding
+    if (rewindBuffer.isEnabled()) {
+        rewindBuffer.record(this);
+    }
+    
+    // Compute the frame to display
+    if (runAheadFrames) {
+        runAhead();
+    }
+    
     // Count some sheep (zzzzzz) ...
-    if (!getWarp()) {
+    if (!getWarp() && realTime) {
             synchronizeTiming();
     }
 }
@@ -648,6 +710,40 @@ C64::synchronizeTiming()
 }
 
 
+//
+//! @functiongroup Random numbers and time
+//
+
+void
+C64::setRandomSeed(uint64_t seed)
+{
+    // The xorshift generator must never run with an all zero state
+    randomState = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+uint32_t
+C64::randomNumber()
+{
+    // xorshift64* (Marsaglia, Vigna)
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t)((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void
+C64::setTimeSource(const void *sender, uint64_t(*func)(const void *))
+{
+    if (func) {
+        timeSource = func;
+        timeSourceListener = sender;
+    } else {
+        timeSource = hostTime;
+        timeSourceListener = NULL;
+    }
+}
+
+
 //
 //! @functiongroup Loading ROM images
 //
@@ -678,7 +774,8 @@ C64::loadRom(const char *filename)
     }
     
     if (VC1541Memory::is1541Rom(filename)) {
-        result = floppy.mem.loadRom(filename);
+        for (unsigned i = 0; i < IEC::numDrives; i++)
+            result = floppy[i].mem.loadRom(filename);
         if (result) putMessage(MSG_VC1541_ROM_LOADED);
     }
     
@@ -768,11 +865,18 @@ C64::saveToSnapshotUnsafe(Snapshot *snapshot)
         return;
     
     snapshot->setCapacity(stateSize());
-    snapshot->setTimestamp(time(NULL));
-    snapshot->takeScreenshot((uint32_t *)vic.screenBuffer(), isPAL());
+    snapshot->setTimestamp((time_t)(getTime() / 1000000));
+    uint32_t palette[16];
+    for (unsigned i = 0; i < 16; i++)
+        palette[i] = vic.getColor(i);
+    snapshot->takeScreenshot((uint32_t *)vic.screenBuffer(), isPAL(), palette, screenshotScale);
 
     uint8_t *ptr = snapshot->getData();
     saveToBuffer(&ptr);
+    
+    // Keep the shared data blocks alive as long as the snapshot exists
+    uint64_t blobs[32];
+    snapshot->setBlobs(blobs, collectBlobs(blobs, 32));
 }
 
 void
@@ -894,6 +998,233 @@ C64::deleteUserSnapshot(unsigned index)
 }
 
 
+//
+//! @functiongroup Rewinding
+//
+
+void
+C64::setRewindBudget(size_t bytes, unsigned seconds)
+{
+    suspend();
+    rewindBuffer.configure(bytes, seconds * vic.getFramesPerSecond());
+    resume();
+}
+
+unsigned
+C64::rewind(unsigned frames)
+{
+    unsigned result;
+    
+    suspend();
+    result = rewindBuffer.restore(this, frames);
+    keyboard.releaseAll(); // Avoid constantly pressed keys
+    ping();
+    resume();
+    
+    return result;
+}
+
+
+//
+//! @functiongroup Running ahead
+//
+
+void
+C64::setRunAhead(unsigned frames)
+{
+    suspend();
+    
+    runAheadFrames = frames;
+    vic.setHideFrame(frames != 0);
+    if (frames == 0) {
+        delete[] runAheadState;
+        runAheadState = NULL;
+        runAheadStateSize = 0;
+    }
+    
+    resume();
+}
+
+void
+C64::runAhead()
+{
+    uint8_t *ptr;
+    size_t size = stateSize();
+    
+    if (size != runAheadStateSize) {
+        delete[] runAheadState;
+        runAheadState = new uint8_t[size];
+        runAheadStateSize = size;
+    }
+    
+    // Keep the shared data blocks alive, e.g., if a disk is written while running ahead
+    uint64_t blobs[32];
+    unsigned numBlobs = collectBlobs(blobs, 32);
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::retain(blobs[i]);
+    
+    // Save the current state
+    setNativeFormat(true);
+    ptr = runAheadState;
+    saveToBuffer(&ptr);
+    
+    // Run ahead with the current input. Only the last frame shows up on the screen.
+    bool complete = true;
+    runningAhead = true;
+    runAheadStopped = false;
+    for (unsigned i = 1; i <= runAheadFrames && complete; i++) {
+        
+        uint64_t current = frame;
+        vic.setHideFrame(i < runAheadFrames);
+        while (frame == current && !runAheadStopped) {
+            if (!executeOneLine())
+                break;
+        }
+        
+        // Breakpoints and traps stopping the look-ahead are hit again in the regular frame
+        complete = frame != current;
+    }
+    runningAhead = false;
+    
+    // Restore the saved state. The regular frame is displayed if no frame ahead has been.
+    ptr = runAheadState;
+    loadFromBuffer(&ptr);
+    setNativeFormat(false);
+    vic.setHideFrame(complete);
+    
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::release(blobs[i]);
+}
+
+
+//
+//! @functiongroup Forking
+//
+
+C64 *
+C64::fork()
+{
+    uint8_t *state, *ptr;
+    uint64_t blobs[32];
+    unsigned numBlobs;
+    size_t size;
+    
+    debug(2, "Forking\n");
+    
+    // Save the current state. The blobs are kept alive until the fork has loaded it.
+    suspend();
+    size = stateSize();
+    state = new uint8_t[size];
+    numBlobs = collectBlobs(blobs, 32);
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::retain(blobs[i]);
+    setNativeFormat(true);
+    ptr = state;
+    saveToBuffer(&ptr);
+    setNativeFormat(false);
+    resume();
+    
+    // Create the new instance
+    C64 *result = new C64();
+    result->autoSaveSnapshots = false;
+    result->realTime = false;
+    result->instantLoad = instantLoad;
+    for (unsigned nr = 8; nr < 12; nr++)
+        result->iec.attachDirectory(nr, iec.getDirectory(nr));
+    result->setNativeFormat(true);
+    ptr = state;
+    result->loadFromBuffer(&ptr);
+    result->setNativeFormat(false);
+    
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::release(blobs[i]);
+    delete[] state;
+    
+    return result;
+}
+
+//! @brief    Work shared by the worker threads of C64::runBatch()
+typedef struct {
+    
+    C64 **instances;
+    unsigned count;
+    unsigned frames;
+    C64::BatchInput input;
+    void *userData;
+    
+    //! @brief    Index of the next instance to run
+    unsigned next;
+    pthread_mutex_t lock;
+    
+} BatchJob;
+
+//! @brief    Worker thread of C64::runBatch()
+static void *
+runBatchWorker(void *arg)
+{
+    BatchJob *job = (BatchJob *)arg;
+    
+    while (true) {
+        
+        pthread_mutex_lock(&job->lock);
+        unsigned index = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        
+        if (index >= job->count)
+            break;
+        
+        C64 *c64 = job->instances[index];
+        for (unsigned frame = 0; frame < job->frames; frame++) {
+            if (job->input)
+                job->input(c64, index, frame, job->userData);
+            if (!c64->executeOneFrame())
+                break;
+        }
+    }
+    
+    return NULL;
+}
+
+void
+C64::runBatch(C64 **instances, unsigned count, unsigned frames,
+              BatchInput input, void *userData, unsigned threads)
+{
+    assert(instances != NULL);
+    
+    BatchJob job;
+    job.instances = instances;
+    job.count = count;
+    job.frames = frames;
+    job.input = input;
+    job.userData = userData;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (unsigned)cores : 1;
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    
+    // The calling thread is one of the workers
+    pthread_t *workers = new pthread_t[threads];
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, runBatchWorker, &job) == 0)
+            started++;
+    }
+    runBatchWorker(&job);
+    
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    
+    delete[] workers;
+    pthread_mutex_destroy(&job.lock);
+}
+
+
 //
 //! @functiongroup Handling archives, tapes, and cartridges
 //
@@ -922,11 +1253,229 @@ C64::flushArchive(Archive *a, int item)
 }
 
 bool
-C64::insertDisk(Archive *a)
+C64::executeTrap(uint16_t addr)
+{
+    switch (addr) {
+            
+        case 0xF4A5:
+            return instantLoad && trapLoad();
+            
+        case 0xED09: case 0xED0C: case 0xEDB9: case 0xEDC7:
+        case 0xEDDD: case 0xEDEF: case 0xEDFE: case 0xEE13:
+            return trapSerial(addr);
+            
+        default:
+            return false;
+    }
+}
+
+bool
+C64::trapLoad()
+{
+    // Make sure that the standard KERNAL routine is about to be executed
+    const uint8_t signature[] = { 0x85, 0x93, 0xA9, 0x00, 0x85, 0x90 };
+    for (unsigned i = 0; i < sizeof(signature); i++) {
+        if (mem.read(0xF4A5 + i) != signature[i])
+            return false;
+    }
+    
+    // Only serve load requests (A = 0) to a connected drive
+    unsigned nr = mem.readRam(0xBA);
+    if (cpu.getA() != 0 || !IEC::isDriveNumber(nr) || !iec.driveIsConnected(nr))
+        return false;
+    if (!floppy[nr - 8].hasDisk() || iec.isHostDevice(nr))
+        return false;
+    
+    // Get file name
+    uint8_t name[16];
+    unsigned length = mem.readRam(0xB7);
+    uint16_t ptr = LO_HI(mem.readRam(0xBB), mem.readRam(0xBC));
+    if (length == 0 || length > sizeof(name))
+        return false;
+    for (unsigned i = 0; i < length; i++)
+        name[i] = mem.read(ptr + i);
+    
+    // Directory listings are left to the drive
+    if (name[0] == '$')
+        return false;
+    
+    // Search the disk for the requested program
+    D64Archive *archive = floppy[nr - 8].getD64Image();
+    if (archive == NULL)
+        return false;
+    
+    int item, numItems = archive->getNumberOfItems();
+    for (item = 0; item < numItems; item++) {
+        if (strcmp(archive->getTypeOfItem(item), "PRG") == 0 &&
+            matchFilename(name, length, archive->getNameOfItem(item)))
+            break;
+    }
+    if (item == numItems)
+        return false;
+    
+    // Secondary address 0 relocates the program to the address passed in X/Y
+    uint16_t addr = archive->getDestinationAddrOfItem(item);
+    if (mem.readRam(0xB9) == 0)
+        addr = LO_HI(mem.readRam(0xC3), mem.readRam(0xC4));
+    
+    debug(2, "Loading item %d to %04X\n", item, addr);
+    
+    int data;
+    uint32_t end = addr;
+    archive->selectItem(item);
+    while (end <= 0xFFFF && (data = archive->getByte()) >= 0) {
+        mem.pokeRam(end++, (uint8_t)data);
+    }
+    addr = (uint16_t)end;
+    
+    // Return end address and status as the KERNAL does
+    mem.pokeRam(0xAE, LO_BYTE(addr));
+    mem.pokeRam(0xAF, HI_BYTE(addr));
+    mem.pokeRam(0x90, mem.readRam(0x90) | 0x40);
+    cpu.setX(LO_BYTE(addr));
+    cpu.setY(HI_BYTE(addr));
+    cpu.setC(0);
+    
+    returnFromTrap();
+    return true;
+}
+
+bool
+C64::trapSerial(uint16_t addr)
+{
+    // Only trap the KERNAL if a host directory device is involved
+    if (!iec.hasHostDevices())
+        return false;
+    
+    // Make sure that the standard KERNAL routine is about to be executed
+    static const struct { uint16_t addr; uint8_t signature[3]; } routines[] = {
+        { 0xED09, { 0x09, 0x40, 0x2C } },   // TALK
+        { 0xED0C, { 0x09, 0x20, 0x20 } },   // LISTEN
+        { 0xEDB9, { 0x85, 0x95, 0x20 } },   // SECOND
+        { 0xEDC7, { 0x85, 0x95, 0x20 } },   // TKSA
+        { 0xEDDD, { 0x24, 0x94, 0x30 } },   // CIOUT
+        { 0xEDEF, { 0x78, 0x20, 0x8E } },   // UNTALK
+        { 0xEDFE, { 0xA9, 0x3F, 0x20 } },   // UNLISTEN
+        { 0xEE13, { 0x78, 0xA9, 0x00 } }    // ACPTR
+    };
+    for (unsigned i = 0; i < sizeof(routines) / sizeof(routines[0]); i++) {
+        if (routines[i].addr != addr)
+            continue;
+        for (unsigned j = 0; j < 3; j++) {
+            if (mem.read(addr + j) != routines[i].signature[j])
+                return false;
+        }
+    }
+    
+    uint8_t status, byte;
+    
+    // Host devices can't be rewound. Stop running ahead instead, before anything happens.
+    if (runningAhead) {
+        
+        bool host;
+        
+        switch (addr) {
+            case 0xED09: // TALK
+            case 0xED0C: // LISTEN
+                host = iec.isHostDevice(cpu.getA() & 0x0F); break;
+            case 0xEDEF: // UNTALK
+            case 0xEE13: // ACPTR
+                host = iec.isTalking(); break;
+            case 0xEDFE: // UNLISTEN
+            case 0xEDDD: // CIOUT
+                host = iec.isListening(); break;
+            default:     // SECOND, TKSA
+                host = iec.isListening() || iec.isTalking(); break;
+        }
+        if (!host)
+            return false;
+        
+        // Keep the CPU at the trap until the look-ahead has been cancelled
+        runAheadStopped = true;
+        cpu.setPC(addr);
+        return true;
+    }
+    
+    switch (addr) {
+            
+        case 0xED09: // TALK
+        case 0xED0C: // LISTEN
+            
+            status = iec.IECOutATN((addr == 0xED09 ? 0x40 : 0x20) | cpu.getA());
+            if (status == IEC::IEC_NOTPRESENT)
+                return false; // Let the KERNAL address the device
+            break;
+            
+        case 0xEDEF: // UNTALK
+            
+            if (!iec.isTalking())
+                return false;
+            status = iec.IECOutATN(0x5F);
+            break;
+            
+        case 0xEDFE: // UNLISTEN
+            
+            if (!iec.isListening())
+                return false;
+            status = iec.IECOutATN(0x3F);
+            break;
+            
+        case 0xEDB9: // SECOND
+        case 0xEDC7: // TKSA
+            
+            if (!iec.isListening() && !iec.isTalking())
+                return false;
+            status = iec.IECOutSec(cpu.getA());
+            break;
+            
+        case 0xEDDD: // CIOUT
+            
+            if (!iec.isListening())
+                return false;
+            status = iec.IECOut(cpu.getA(), false);
+            cpu.setC(0);
+            break;
+            
+        case 0xEE13: // ACPTR
+            
+            if (!iec.isTalking())
+                return false;
+            status = iec.IECIn(&byte);
+            cpu.setA(byte);
+            cpu.setN(byte & 0x80);
+            cpu.setZ(byte == 0);
+            cpu.setC(0);
+            break;
+            
+        default:
+            return false;
+    }
+    
+    // Update status variable ST
+    if (status != IEC::IEC_OK)
+        mem.pokeRam(0x90, mem.readRam(0x90) | status);
+    
+    returnFromTrap();
+    return true;
+}
+
+void
+C64::returnFromTrap()
+{
+    uint8_t sp = cpu.getSP();
+    uint8_t lo = mem.readRam(0x100 + (uint8_t)(sp + 1));
+    uint8_t hi = mem.readRam(0x100 + (uint8_t)(sp + 2));
+    cpu.setSP(sp + 2);
+    cpu.setPC(LO_HI(lo, hi) + 1);
+}
+
+bool
+C64::insertDisk(Archive *a, unsigned nr)
 {
     assert(a != NULL);
+    assert(IEC::isDriveNumber(nr));
     
-    floppy.insertDisk(a);
+    floppy[nr - 8].insertDisk(a);
     return true;
     
 }
@@ -937,7 +1486,7 @@ C64::mountArchive(Archive *a)
 	if (a == NULL)
 		return false;
 		
-	floppy.insertDisk(a);
+	floppy[0].insertDisk(a);
 	return true;
 }
 
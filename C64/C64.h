@@ -51,7 +51,7 @@
 // Snapshot version number of this release
 #define V_MAJOR 1
 #define V_MINOR 9
-#define V_SUBMINOR 0
+#define V_SUBMINOR 1
 
 // Disables assert checking in relase version
 #define NDEBUG
@@ -64,6 +64,8 @@
 
 // Loading and saving
 #include "Snapshot.h"
+#include "RewindBuffer.h"
+#include "SnapshotWriter.h"
 #include "T64Archive.h"
 #include "D64Archive.h"
 #include "G64Archive.h"
@@ -260,8 +262,11 @@ public:
     //! @brief    The C64s virtual expansion port (cartdrige slot)
     ExpansionPort expansionport;
 
-    //! @brief    A virtual VC1541 floppy drive
-	VC1541 floppy;
+    /*! @brief    Virtual VC1541 floppy drives
+     *  @details  floppy[0] is device 8, floppy[1] is device 9, and so on. By default, only
+     *            device 8 is connected to the IEC bus.
+     */
+	VC1541 floppy[IEC::numDrives];
 
     //! @brief    A virtual datasette
     Datasette datasette;
@@ -312,6 +317,11 @@ private:
     //! Indicates that we should run as fast as possible at least during disk operations
     bool warpLoad;
     
+    /*! @brief    Indicates whether KERNAL LOAD requests are served directly from disk
+     *  @see      executeTrap
+     */
+    bool instantLoad;
+    
     
     //
     // Message queue
@@ -335,6 +345,26 @@ private:
      */
     bool ultimax;
     
+    //
+    // Random numbers and time
+    //
+    
+    /*! @brief    State of the pseudo random number generator
+     *  @details  Each virtual C64 owns its own generator. All components draw their
+     *            random numbers from here, so two runs started with the same seed and
+     *            fed with the same inputs produce identical frames and sound samples.
+     */
+    uint64_t randomState;
+    
+    /*! @brief    Time source callback function
+     *  @details  Returns the current time in microseconds since 1970. If no time source
+     *            has been injected, the host's wall clock is used.
+     */
+    uint64_t(*timeSource)(const void *);
+    
+    //! @brief    Registered time source listener (passed back into the callback function)
+    const void *timeSourceListener;
+    
     //
     // Snapshot storage
     //
@@ -347,6 +377,12 @@ public:
     //! @brief    Time in seconds between two auto-saved snapshots
     unsigned autoSaveInterval;
     
+    /*! @brief    Downscaling factor for snapshot screenshots
+     *  @details  By default, snapshots store a small preview image. Set to 1 to store
+     *            full screenshots.
+     */
+    unsigned screenshotScale;
+    
 private:
     
     //! @brief    Maximum number of auto-taken snapshots
@@ -361,6 +397,38 @@ private:
     //! @brief    Storage for user-taken snapshots
     Snapshot *userSavedSnapshots[MAX_USER_SAVED_SNAPSHOTS];
     
+    /*! @brief    Frame by frame recording of the emulator state
+     *  @details  Disabled by default. Use setRewindBudget() to enable it.
+     */
+    RewindBuffer rewindBuffer;
+    
+    /*! @brief    Number of frames the emulator runs ahead
+     *  @details  0 disables run-ahead.
+     *  @see      setRunAhead
+     */
+    unsigned runAheadFrames;
+    
+    //! @brief    Indicates whether the emulator is currently computing frames ahead of time
+    bool runningAhead;
+    
+    /*! @brief    Indicates that running ahead has been stopped early
+     *  @details  Set by traps with effects outside the emulated machine, e.g., accesses to
+     *            host directory devices. Those effects couldn't be undone.
+     */
+    bool runAheadStopped;
+    
+    //! @brief    State that is restored after running ahead (native format)
+    uint8_t *runAheadState;
+    
+    //! @brief    Size of runAheadState in bytes
+    size_t runAheadStateSize;
+    
+    /*! @brief    Indicates whether emulation is synchronized with the real time
+     *  @details  Forked instances compute frames as fast as possible without being in
+     *            warp mode, which would change their internal state.
+     */
+    bool realTime;
+    
     
 	// ---------------------------------------------------------------------------------------
 	//                                             Methods
@@ -417,25 +485,31 @@ public:
     bool getAudioFilter() { return sid.getAudioFilter(); }
 
 	//! @brief    Enables or disables SID audio filters.
-	void setAudioFilter(bool value) { sid.setAudioFilter(value); }
+	void setAudioFilter(bool value) { suspend(); sid.setAudioFilter(value); resume(); }
       
     //! @brief    Returns true if reSID library is used
     bool getReSID() { return sid.getReSID(); }
 
     //! @brief    Turns reSID library on or off
-    void setReSID(bool value) { sid.setReSID(value); }
+    void setReSID(bool value) { suspend(); sid.setReSID(value); resume(); }
 
     //! @brief    Gets the sampling method
     sampling_method getSamplingMethod() { return sid.getSamplingMethod(); }
     
     //! @brief    Sets the sampling method
-    void setSamplingMethod(sampling_method value) { sid.setSamplingMethod(value); }
+    void setSamplingMethod(sampling_method value) { suspend(); sid.setSamplingMethod(value); resume(); }
     
     //! @brief    Gets the SID chip model
     chip_model getChipModel() { return sid.getChipModel(); }
     
     //! @brief    Sets the SID chip model
-    void setChipModel(chip_model value) { sid.setChipModel(value); }
+    void setChipModel(chip_model value) { suspend(); sid.setChipModel(value); resume(); }
+
+    //! @brief    Returns true if SID runs without producing sound samples
+    bool getSilent() { return sid.getSilent(); }
+    
+    //! @brief    Switches SID sound synthesis off or on
+    void setSilent(bool value) { sid.setSilent(value); }
 
     
     //
@@ -482,6 +556,11 @@ public:
 	//! @brief    Executes until the end of the rasterline
 	bool executeOneLine();
     
+    /*! @brief    Executes until the end of the frame
+     *  @return   false, if a breakpoint has been reached.
+     */
+    bool executeOneFrame();
+    
 private:
 	
     //! @brief    Executes virtual C64 for one cycle
@@ -495,6 +574,11 @@ private:
 
     //! @brief    Invoked after executing the last rasterline of a frame
     void endOfFrame();
+    
+    /*! @brief    Computes the frames ahead of time
+     *  @details  Invoked at the end of each frame if run-ahead is enabled.
+     */
+    void runAhead();
 
     
     //
@@ -527,6 +611,17 @@ public:
     //! @brief    Setter for warpLoad.
     void setWarpLoad(bool b);
     
+    //! @brief    Returns true iff KERNAL LOAD requests are served directly from disk.
+    bool getInstantLoad() { return instantLoad; }
+    
+    /*! @brief    Setter for instantLoad.
+     *  @details  If enabled, the standard KERNAL LOAD routine is bypassed. Programs are copied
+     *            from the inserted disk into memory right away. The emulated drive is not
+     *            involved. Fast loaders that hook into the LOAD vector or talk to the drive
+     *            directly are not affected.
+     */
+    void setInstantLoad(bool b) { instantLoad = b; }
+    
     /*! @brief    Restarts the synchronization timer
      *  @details  The function is invoked at launch time to initialize the timer and reinvoked
      *            when the synchronization timer gets out of sync.
@@ -565,6 +660,34 @@ public:
     void setUltimax(bool b) { ultimax = b; }
     
     
+    //
+    //! @functiongroup Random numbers and time
+    //
+    
+    /*! @brief    Seeds the pseudo random number generator
+     *  @details  The generator state is part of the snapshot. It is kept on reset.
+     */
+    void setRandomSeed(uint64_t seed);
+    
+    //! @brief    Returns the next pseudo random number
+    uint32_t randomNumber();
+    
+    /*! @brief    Returns a pseudo random number without side effects
+     *  @details  Unlike randomNumber(), this function does not advance the generator.
+     *            It is intended for the side effect free read() functions.
+     */
+    uint32_t readRandomNumber() { return (uint32_t)(randomState >> 32); }
+    
+    /*! @brief    Injects a time source
+     *  @details  The callback function has to return the current time in microseconds
+     *            since 1970. Pass NULL to switch back to the host's wall clock.
+     */
+    void setTimeSource(const void *sender, uint64_t(*func)(const void *));
+    
+    //! @brief    Returns the current time in microseconds since 1970
+    uint64_t getTime() { return timeSource(timeSourceListener); }
+    
+    
     //
     //! @functiongroup Loading ROM images
     //
@@ -667,6 +790,95 @@ public:
     void deleteUserSnapshot(unsigned nr);
 
     
+    //
+    //! @functiongroup Rewinding
+    //
+    
+    //! @brief    Returns the memory budget of the rewind buffer in bytes
+    size_t getRewindBudget() { return rewindBuffer.getBudget(); }
+    
+    /*! @brief    Configures the rewind buffer
+     *  @details  The emulator state is recorded at the end of each frame. The budget
+     *            limits the memory used for storing the recorded frames. If the budget
+     *            runs out, or more than the specified number of seconds has been
+     *            recorded, the oldest frames are discarded. A budget of 0 disables
+     *            recording.
+     */
+    void setRewindBudget(size_t bytes, unsigned seconds = 60);
+    
+    //! @brief    Returns the number of frames that can be rewound
+    unsigned numRewindFrames() { return rewindBuffer.numFrames(); }
+    
+    /*! @brief    Winds back the emulator state
+     *  @details  The rewound frames are removed from the rewind buffer.
+     *  @return   The number of rewound frames. It is smaller than requested if
+     *            not enough frames have been recorded.
+     */
+    unsigned rewind(unsigned frames);
+    
+    
+    //
+    //! @functiongroup Running ahead
+    //
+    
+    //! @brief    Returns the number of frames the emulator runs ahead
+    unsigned getRunAhead() { return runAheadFrames; }
+    
+    /*! @brief    Enables or disables run-ahead
+     *  @details  At the end of each frame, the emulator saves its state, runs the specified
+     *            number of frames ahead with the current input, and restores the saved state
+     *            afterwards. Only the last frame computed ahead is displayed. This hides the
+     *            input lag of the emulated program. Sound is taken from the regular frames.
+     *            0 disables run-ahead.
+     */
+    void setRunAhead(unsigned frames);
+    
+    //! @brief    Returns true iff the emulator is currently computing frames ahead of time
+    bool isRunningAhead() { return runningAhead; }
+    
+    
+    //
+    //! @functiongroup Forking
+    //
+    
+    /*! @brief    Creates a new emulator instance in the current state
+     *  @details  The state is transferred in native format without a Snapshot round trip.
+     *            ROMs, disks, and tapes are shared via the blob store. The new instance
+     *            is halted, takes no auto-snapshots, and does not synchronize with the
+     *            real time. It is meant to be driven by executeOneFrame() or runBatch().
+     *  @note     The caller takes ownership of the returned object.
+     */
+    C64 *fork();
+    
+    //! @brief    Returns true iff emulation is synchronized with the real time
+    bool getRealTime() { return realTime; }
+    
+    //! @brief    Enables or disables synchronization with the real time
+    void setRealTime(bool value) { realTime = value; }
+    
+    /*! @brief    Callback function of runBatch()
+     *  @details  Invoked before each frame. Use it to feed in the input of an instance,
+     *            e.g., by pressing keys or moving a joystick.
+     *  @param    c64      Instance that is about to compute the next frame
+     *  @param    index    Position of the instance in the array passed to runBatch()
+     *  @param    frame    Number of the frame within the batch, starting at 0
+     *  @param    userData Pointer passed to runBatch()
+     */
+    typedef void (*BatchInput)(C64 *c64, unsigned index, unsigned frame, void *userData);
+    
+    /*! @brief    Advances multiple emulator instances in parallel
+     *  @details  All instances must be halted and must not share any state except the
+     *            blob store, e.g., instances created with fork(). Each worker thread runs
+     *            one instance at a time for the specified number of frames. The function
+     *            returns when all instances are done. An instance that reaches a
+     *            breakpoint stops early.
+     *  @param    input    Callback function invoked before each frame (may be NULL)
+     *  @param    threads  Number of worker threads (0 = one per processor core)
+     */
+    static void runBatch(C64 **instances, unsigned count, unsigned frames,
+                         BatchInput input, void *userData, unsigned threads = 0);
+    
+    
     //
     //! @functiongroup Handling disks, tapes, and cartridges
     //
@@ -674,11 +886,44 @@ public:
 	/*! @brief    Flushes a single item from an archive into memory.
      */
 	bool flushArchive(Archive *a, int item);
+    
+    /*! @brief    Executes a ROM routine on behalf of the CPU
+     *  @details  The CPU calls this function when it is about to execute an instruction tagged
+     *            with EMULATOR_TRAP. Right now, the KERNAL LOAD routine is trapped if instant
+     *            loading is enabled and the KERNAL serial bus routines are trapped to talk
+     *            to host directory devices.
+     *  @result   true, if the routine has been executed. In that case, the CPU continues
+     *            with the instruction following the JSR the routine was called with. If
+     *            false is returned, the CPU executes the routine itself.
+     */
+    bool executeTrap(uint16_t addr);
+
+private:
+    
+    /*! @brief    Executes the KERNAL LOAD routine on behalf of the CPU
+     *  @details  Only the standard KERNAL routine is emulated and only if a program is
+     *            loaded from the drive and can be found on disk. Everything else, such as
+     *            directory listings or verify requests, is left to the drive.
+     */
+    bool trapLoad();
+    
+    /*! @brief    Executes a KERNAL serial bus routine on behalf of the CPU
+     *  @details  LISTEN, TALK, UNLISTEN, UNTALK, SECOND, TKSA, CIOUT, and ACPTR are
+     *            forwarded to the IEC bus on byte level if a host directory device is
+     *            addressed. Transfers with other devices are left to the KERNAL.
+     */
+    bool trapSerial(uint16_t addr);
+    
+    //! @brief    Returns from a trapped subroutine
+    void returnFromTrap();
+    
+public:
 	
-	/*! @brief    Inserts an archive into the floppy drive as a virtual disk.
+	/*! @brief    Inserts an archive into a floppy drive as a virtual disk.
      *  @details  Only D64 and G64 archives are supported.
+     *  @param    nr  Device number of the drive (8 to 11)
      */
-    bool insertDisk(Archive *a);
+    bool insertDisk(Archive *a, unsigned nr = 8);
     
     /*! @brief    Old function for mounting an archive as a disk.
      *  @details  Only D64 and G64 archives are supported.
@@ -31,15 +31,18 @@ C64Memory::C64Memory()
 	charRomFile = NULL;
 	kernalRomFile = NULL;
 	basicRomFile = NULL;
+    basicRomBlob = 0;
+    charRomBlob = 0;
+    kernalRomBlob = 0;
     
     // Register snapshot items
     SnapshotItem items[] = {
         
-        { ram,          sizeof(ram),        KEEP_ON_RESET },
-        { colorRam,     sizeof(colorRam),   KEEP_ON_RESET },
-        { &rom[0xA000], 0x2000,             KEEP_ON_RESET  }, /* Basic ROM */
-        { &rom[0xD000], 0x1000,             KEEP_ON_RESET  }, /* Character ROM */
-        { &rom[0xE000], 0x2000,             KEEP_ON_RESET  }, /* Kernal ROM */
+        { ram,          sizeof(ram),        KEEP_ON_RESET,  dirtyRam,         0x100 },
+        { colorRam,     sizeof(colorRam),   KEEP_ON_RESET,  dirtyColorRam,    0x100 },
+        { &rom[0xA000], 0x2000,             KEEP_ON_RESET,  &dirtyRom[0xA0],  0x100, &basicRomBlob },  /* Basic ROM */
+        { &rom[0xD000], 0x1000,             KEEP_ON_RESET,  &dirtyRom[0xD0],  0x100, &charRomBlob },   /* Character ROM */
+        { &rom[0xE000], 0x2000,             KEEP_ON_RESET,  &dirtyRom[0xE0],  0x100, &kernalRomBlob }, /* Kernal ROM */
         { &peekSrc,     sizeof(peekSrc),    KEEP_ON_RESET },
         { &pokeTarget,  sizeof(pokeTarget), KEEP_ON_RESET },
         { NULL,         0,                  0 }};
@@ -70,7 +73,7 @@ C64Memory::reset()
     
     // Initialize color RAM with random numbers
     for (unsigned i = 0; i < sizeof(colorRam); i++) {
-        colorRam[i] = (rand() & 0xFF);
+        colorRam[i] = (c64->randomNumber() & 0xFF);
     }
     
     // Initialize peek source lookup table
@@ -99,8 +102,8 @@ C64Memory::dumpState()
 	msg("   Kernal ROM :%s loaded\n", kernalRomIsLoaded() ? "" : " not");
 	for (uint16_t i = 0; i < 0xFFFF; i++) {
 		uint8_t tag = cpu->getBreakpointTag(i);
-		if (tag != NO_BREAKPOINT) {
-			msg("Breakpoint at %0x4X %s\n", i, tag == SOFT_BREAKPOINT ? "(soft)" : "");
+		if (tag & (HARD_BREAKPOINT | SOFT_BREAKPOINT)) {
+			msg("Breakpoint at %0x4X %s\n", i, (tag & SOFT_BREAKPOINT) ? "(soft)" : "");
 		}
 	}
 	msg("\n");
@@ -164,12 +167,29 @@ bool C64Memory::isRom(const char *filename)
 	return isBasicRom(filename) || isCharRom(filename) || isKernalRom(filename);
 }
 
+void
+C64Memory::pokeRom(uint16_t addr, uint8_t value)
+{
+    // The ROM image is going to deviate from the shared one
+    if (isBasicRomAddr(addr)) {
+        if (basicRomBlob) unshareBlob(&basicRomBlob);
+    } else if (isCharRomAddr(addr)) {
+        if (charRomBlob) unshareBlob(&charRomBlob);
+    } else if (isKernalRomAddr(addr)) {
+        if (kernalRomBlob) unshareBlob(&kernalRomBlob);
+    }
+    
+    rom[addr] = value;
+    dirtyRom[addr >> 8] = 1;
+}
+
 bool 
 C64Memory::loadBasicRom(const char *filename)
 {
 	if (isBasicRom(filename)) {
 		basicRomFile = strdup(filename);
 		flashRom(filename, 0xA000);
+        shareBlob(&basicRomBlob, &rom[0xA000], 0x2000);
 		return true;
 	}
 	return false;
@@ -181,6 +201,7 @@ C64Memory::loadCharRom(const char *filename)
 	if (isCharRom(filename)) {
 		charRomFile = strdup(filename);
 		flashRom(filename, 0xD000);
+        shareBlob(&charRomBlob, &rom[0xD000], 0x1000);
 		return true;
 	}
 	return false;
@@ -192,6 +213,7 @@ C64Memory::loadKernalRom(const char *filename)
 	if (isKernalRom(filename)) {
 		kernalRomFile = strdup(filename);
 		flashRom(filename, 0xE000);
+        shareBlob(&kernalRomBlob, &rom[0xE000], 0x2000);
 		return true;
 	}
     
@@ -472,7 +494,8 @@ void C64Memory::pokeIO(uint16_t addr, uint8_t value)
         case 0xA: // Color RAM
         case 0xB: // Color RAM
             
-            colorRam[addr - 0xD800] = (value & 0x0F) | (rand() & 0xF0);
+            colorRam[addr - 0xD800] = (value & 0x0F) | (c64->randomNumber() & 0xF0);
+            dirtyColorRam[(addr - 0xD800) >> 8] = 1;
             return;
             
         case 0xC: // CIA 1
@@ -509,6 +532,7 @@ void C64Memory::poke(uint16_t addr, uint8_t value)
 			
 		case M_RAM:
 			ram[addr] = value;
+            dirtyRam[addr >> 8] = 1;
 			return;
 			
 		case M_IO:
@@ -527,6 +551,7 @@ void C64Memory::poke(uint16_t addr, uint8_t value)
             }
     
             ram[addr] = value;
+            dirtyRam[addr >> 8] = 1;
             return;
 
 		default:
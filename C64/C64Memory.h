@@ -114,6 +114,25 @@ public:
      */
     uint8_t rom[65536];
     
+    /*! @brief    Dirty flags of the RAM pages
+     *  @details  The flag of a 256 byte page is set whenever the page is written.
+     *  @see      VirtualComponent::saveDirtyToBuffer
+     */
+    uint8_t dirtyRam[256];
+    
+    //! @brief    Dirty flags of the color RAM pages
+    uint8_t dirtyColorRam[4];
+    
+    //! @brief    Dirty flags of the ROM pages
+    uint8_t dirtyRom[256];
+    
+    /*! @brief    Blob store hashes of the ROM images
+     *  @details  As long as a ROM is unmodified, snapshots only contain its hash.
+     */
+    uint64_t basicRomBlob;
+    uint64_t charRomBlob;
+    uint64_t kernalRomBlob;
+    
 public:
     
     /*! @brief    Checks the integrity of a Basic ROM image.
@@ -258,10 +277,10 @@ public:
     uint8_t read(uint16_t addr);
     
     //! @brief    Write a byte into RAM.
-    void pokeRam(uint16_t addr, uint8_t value) { ram[addr] = value; }
+    void pokeRam(uint16_t addr, uint8_t value) { ram[addr] = value; dirtyRam[addr >> 8] = 1; }
 
     //! @brief    Write a byte into ROM.
-    void pokeRom(uint16_t addr, uint8_t value) { rom[addr] = value; }
+    void pokeRom(uint16_t addr, uint8_t value);
 
     //! @brief    Write a byte into I/O space.
     void pokeIO(uint16_t addr, uint8_t value);
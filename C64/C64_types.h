@@ -48,6 +48,8 @@ typedef enum {
     MSG_VC1541_ROM_LOADED,
     MSG_ROM_MISSING,
     MSG_SNAPSHOT_TAKEN,
+    MSG_SNAPSHOT_SAVED,
+    MSG_SNAPSHOT_NOT_SAVED,
 
     // CPU related messages
     MSG_CPU_OK,
@@ -25,6 +25,7 @@ CPU::CPU()
 	
     // Chip model
     chipModel = MOS_6510;
+    floppy = NULL;
 
 	// Establish callback for each instruction
 	registerInstructions();
@@ -24,6 +24,9 @@
 #include "CPU_types.h"
 #include "Memory.h"
 
+// Forward declarations
+class VC1541;
+
 /*! @class  The virtual 6502 / 6510 processor
  */
 class CPU : public VirtualComponent {
@@ -64,6 +67,11 @@ public:
 	//! @brief    Reference to the connected virtual memory
 	Memory *mem;
 
+    /*! @brief    Reference to the drive this CPU belongs to
+     *  @details  NULL for the C64 CPU.
+     */
+    VC1541 *floppy;
+
     /*! @brief    Selected chip model
      *  @details  Right now, this atrribute is only used to distinguish the C64 CPU (MOS6510)
      *            from the VC1541 CPU (MOS6502). Hardware differences between both models
@@ -52,11 +52,17 @@ typedef enum {
  *
  *            HARD_BREAKPOINT: execution is halted
  *            SOFT_BREAKPOINT: execution is halted and the tag is deleted
+ *            EMULATOR_TRAP:   C64::executeTrap() is given the chance to execute the
+ *                             code on behalf of the CPU
+ *
+ *            The tags can be combined. If a trap address carries a hard or soft breakpoint,
+ *            execution is halted and the trap is skipped.
  */
 typedef enum {
     NO_BREAKPOINT   = 0x00,
     HARD_BREAKPOINT = 0x01,
-    SOFT_BREAKPOINT = 0x02
+    SOFT_BREAKPOINT = 0x02,
+    EMULATOR_TRAP   = 0x04
 } Breakpoint;
 
 //! @brief    Disassembled instruction
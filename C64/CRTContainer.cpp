@@ -59,7 +59,7 @@ void
 CRTContainer::dealloc()
     {
         if (data) {
-            free(data);
+            releaseBuffer(data);
             data = NULL;
         }
         
@@ -101,10 +101,9 @@ CRTContainer::isValidCRTFile(const char *filename)
 bool
 CRTContainer::readFromBuffer(const uint8_t *buffer, size_t length)
 {
-    if ((data = (uint8_t *)malloc(length)) == NULL) {
+    if ((data = adoptBuffer(buffer, length)) == NULL) {
         return false;
     }
-    memcpy(data, buffer, length);
     
     // Scan cartridge header
     if (memcmp("C64 CARTRIDGE   ", data, 16) != 0) {
@@ -203,6 +203,25 @@ Cartridge::saveToBuffer(uint8_t **buffer)
     assert(*buffer - old == stateSize());
 }
 
+uint64_t
+Cartridge::stateHash()
+{
+    uint8_t lines[2] = { initialGameLine, initialExromLine };
+    uint64_t result = hashBlock(lines, sizeof(lines), 0);
+    
+    result = hashBlock(chipStartAddress, sizeof(chipStartAddress), result);
+    result = hashBlock(chipSize, sizeof(chipSize), result);
+    for (unsigned i = 0; i < 64; i++) {
+        if (chipSize[i] > 0)
+            result = hashBlock(chip[i], chipSize[i], result);
+    }
+    result = hashBlock(blendedIn, sizeof(blendedIn), result);
+    result = hashBlock(&cycle, sizeof(cycle), result);
+    result = hashBlock(&regValue, sizeof(regValue), result);
+    
+    return result;
+}
+
 void
 Cartridge::dumpState()
 {
@@ -120,6 +120,9 @@ public:
     //! @brief    Save the current state into a buffer
     void saveToBuffer(uint8_t **buffer);
     
+    //! @brief    Computes a hash over the current state
+    uint64_t stateHash();
+    
     //! @brief    Prints debugging information
     void dumpState();
     
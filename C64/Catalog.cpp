@@ -0,0 +1,648 @@
+/*
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "Catalog.h"
+#include "Archive.h"
+#include "Disk525.h"
+#include "D64Archive.h"
+#include "G64Archive.h"
+#include "NIBArchive.h"
+#include "PackedFile.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+//! @brief    An archive scanned by a worker thread
+typedef struct {
+
+    char *path;
+    char *name;
+    uint64_t fileSize;
+    int64_t modified;
+    ContainerType type;
+
+    //! @brief    Items (the name field is an index into itemNames)
+    Catalog::ItemInfo *items;
+    char **itemNames;
+    unsigned numItems;
+
+    //! @brief    Indicates that the archive could be read
+    bool valid;
+
+} ScannedImage;
+
+//! @brief    Work shared by all worker threads
+typedef struct {
+
+    ScannedImage *images;
+    unsigned count;
+
+    //! @brief    Catalog to take unchanged archives from (optional)
+    Catalog *previous;
+
+    //! @brief    Index of the next archive to scan
+    unsigned next;
+    pthread_mutex_t lock;
+
+} ScanJob;
+
+
+//
+// Collecting archives
+//
+
+static bool
+isIndexable(const char *path)
+{
+    char *unpacked = PackedFile::getUnpackedPath(path);
+    const char *suffix = strrchr(unpacked, '.');
+    const char *known[] = { ".d64", ".g64", ".nib", ".t64", ".prg", ".p00" };
+    bool result = false;
+
+    for (unsigned i = 0; suffix && i < sizeof(known) / sizeof(known[0]); i++) {
+        if (strcasecmp(suffix, known[i]) == 0)
+            result = true;
+    }
+    free(unpacked);
+    return result;
+}
+
+static void
+addPath(char ***paths, unsigned *count, const char *path)
+{
+    if ((*count & (*count - 1)) == 0) {
+        *paths = (char **)realloc(*paths, sizeof(char *) * (*count ? 2 * *count : 1));
+    }
+    (*paths)[(*count)++] = strdup(path);
+}
+
+static void
+collectPaths(char ***paths, unsigned *count, const char *path, bool explicitly)
+{
+    DIR *dir = opendir(path);
+
+    if (dir == NULL) {
+
+        // Each member of a zip archive is indexed separately
+        PackedFile *zip = PackedFile::isZipPath(path) ? PackedFile::makePackedFileWithPath(path) : NULL;
+        if (zip) {
+            for (unsigned i = 0; i < zip->getNumberOfMembers(); i++) {
+                char *member = PackedFile::makeMemberPath(path, zip->getNameOfMember(i));
+                if (isIndexable(member))
+                    addPath(paths, count, member);
+                free(member);
+            }
+            delete zip;
+        } else if (explicitly || isIndexable(path)) {
+            addPath(paths, count, path);
+        }
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        char *child = (char *)malloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(child, "%s/%s", path, entry->d_name);
+        collectPaths(paths, count, child, false);
+        free(child);
+    }
+    closedir(dir);
+}
+
+static int
+comparePaths(const void *p1, const void *p2)
+{
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+
+//
+// Scanning archives
+//
+
+//! @brief    Copies the directory of an archive
+static void
+scanArchive(ScannedImage *image, Archive *archive)
+{
+    unsigned count = archive->getNumberOfItems();
+
+    image->items = (Catalog::ItemInfo *)calloc(count ? count : 1, sizeof(Catalog::ItemInfo));
+    image->itemNames = (char **)calloc(count ? count : 1, sizeof(char *));
+    image->numItems = count;
+
+    for (unsigned n = 0; n < count; n++) {
+
+        Catalog::ItemInfo *item = &image->items[n];
+        const char *name = archive->getNameOfItem(n);
+        const char *type = archive->getTypeOfItem(n);
+
+        image->itemNames[n] = strdup(name ? name : "");
+        strncpy(item->type, type ? type : "", sizeof(item->type) - 1);
+        item->size = (uint32_t)archive->getSizeOfItem(n);
+        item->blocks = (uint16_t)archive->getSizeOfItemInBlocks(n);
+        item->loadAddr = archive->getDestinationAddrOfItem(n);
+    }
+}
+
+//! @brief    Reads the directory of a single archive
+static void
+scanImage(ScannedImage *image, Disk525 *disk)
+{
+    const char *path = image->path;
+    Archive *archive = NULL;
+
+    if (G64Archive::isG64File(path)) {
+
+        // Bit-stream images are decoded to find their directory
+        G64Archive *g64 = G64Archive::makeG64ArchiveWithFile(path);
+        if (g64) {
+            disk->encodeArchive(g64);
+            image->type = G64_CONTAINER;
+            image->name = strdup(g64->getName());
+            archive = D64Archive::makeD64ArchiveWithDisk(disk);
+            image->valid = true;
+            delete g64;
+        }
+
+    } else if (NIBArchive::isNIBFile(path)) {
+
+        NIBArchive *nib = NIBArchive::makeNIBArchiveWithFile(path);
+        if (nib) {
+            disk->encodeArchive(nib);
+            image->type = NIB_CONTAINER;
+            image->name = strdup(nib->getName());
+            archive = D64Archive::makeD64ArchiveWithDisk(disk);
+            image->valid = true;
+            delete nib;
+        }
+
+    } else if ((archive = Archive::makeArchiveWithFile(path)) != NULL) {
+
+        image->type = archive->type();
+        image->name = strdup(archive->getName());
+        image->valid = true;
+    }
+
+    // Bit-stream images without a standard DOS layout are indexed without items
+    if (archive) {
+        scanArchive(image, archive);
+        delete archive;
+    }
+}
+
+//! @brief    Takes an unchanged archive from the previous catalog
+static bool
+reuseImage(ScannedImage *image, Catalog *previous)
+{
+    int i;
+
+    if (previous == NULL || (i = previous->findImage(image->path)) < 0)
+        return false;
+
+    const Catalog::ImageInfo *info = previous->getImage(i);
+    if (info->fileSize != image->fileSize || info->modified != image->modified)
+        return false;
+
+    unsigned count = info->numItems;
+    image->type = (ContainerType)info->type;
+    image->name = strdup(previous->getNameOfImage(i));
+    image->items = (Catalog::ItemInfo *)calloc(count ? count : 1, sizeof(Catalog::ItemInfo));
+    image->itemNames = (char **)calloc(count ? count : 1, sizeof(char *));
+    image->numItems = count;
+    image->valid = true;
+
+    for (unsigned n = 0; n < count; n++) {
+        image->items[n] = *previous->getItem(i, n);
+        image->itemNames[n] = strdup(previous->getNameOfItem(i, n));
+    }
+    return true;
+}
+
+static void *
+scanWorker(void *arg)
+{
+    ScanJob *job = (ScanJob *)arg;
+    Disk525 *disk = NULL;
+
+    while (true) {
+
+        pthread_mutex_lock(&job->lock);
+        unsigned index = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        if (index >= job->count)
+            break;
+
+        ScannedImage *image = &job->images[index];
+        char *file = PackedFile::getFilePath(image->path);
+        struct stat info;
+        int result = stat(file, &info);
+
+        free(file);
+        if (result != 0)
+            continue;
+        image->fileSize = info.st_size;
+        image->modified = info.st_mtime;
+
+        if (reuseImage(image, job->previous))
+            continue;
+
+        // The virtual disk is only needed for G64 and NIB images
+        if (disk == NULL && (G64Archive::isG64File(image->path) || NIBArchive::isNIBFile(image->path)))
+            disk = new Disk525();
+        scanImage(image, disk);
+    }
+
+    delete disk;
+    return NULL;
+}
+
+
+//
+// Catalog
+//
+
+Catalog::Catalog()
+{
+    setDescription("Catalog");
+
+    data = NULL;
+    size = 0;
+    mapped = false;
+    header = NULL;
+    images = NULL;
+    items = NULL;
+    slots = NULL;
+    strings = NULL;
+}
+
+Catalog::~Catalog()
+{
+    clear();
+}
+
+void
+Catalog::clear()
+{
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        free(data);
+    }
+
+    data = NULL;
+    size = 0;
+    mapped = false;
+    header = NULL;
+    images = NULL;
+    items = NULL;
+    slots = NULL;
+    strings = NULL;
+}
+
+uint32_t
+Catalog::hashPath(const char *path)
+{
+    return (uint32_t)hashBlock(path, strlen(path), 0);
+}
+
+bool
+Catalog::attach(uint8_t *buffer, size_t length, bool isMapped)
+{
+    Header *h = (Header *)buffer;
+
+    if (length < sizeof(Header) || strcmp(h->magic, "VC64CAT") != 0) {
+        warn("Not a catalog file\n");
+        return false;
+    }
+    if (h->version != version || h->byteOrder != 0x01020304) {
+        warn("Unsupported catalog format (version %d)\n", h->version);
+        return false;
+    }
+
+    // Make sure that all tables are inside the buffer
+    uint64_t expected = sizeof(Header);
+    expected += (uint64_t)h->numImages * sizeof(ImageInfo);
+    expected += (uint64_t)h->numItems * sizeof(ItemInfo);
+    expected += (uint64_t)h->numSlots * sizeof(uint32_t);
+    expected += h->stringSize;
+
+    if (expected != length || h->numSlots == 0 || (h->numSlots & (h->numSlots - 1)) ||
+        h->stringSize == 0 || buffer[length - 1] != 0) {
+        warn("Catalog file is corrupted\n");
+        return false;
+    }
+
+    uint8_t *ptr = buffer + sizeof(Header);
+    ImageInfo *imageTable = (ImageInfo *)ptr;
+    ptr += h->numImages * sizeof(ImageInfo);
+    ItemInfo *itemTable = (ItemInfo *)ptr;
+    ptr += h->numItems * sizeof(ItemInfo);
+    uint32_t *slotTable = (uint32_t *)ptr;
+    ptr += h->numSlots * sizeof(uint32_t);
+
+    for (unsigned i = 0; i < h->numImages; i++) {
+        if ((uint64_t)imageTable[i].firstItem + imageTable[i].numItems > h->numItems) {
+            warn("Catalog file is corrupted\n");
+            return false;
+        }
+    }
+
+    clear();
+    data = buffer;
+    size = length;
+    mapped = isMapped;
+    header = h;
+    images = imageTable;
+    items = itemTable;
+    slots = slotTable;
+    strings = (const char *)ptr;
+
+    return true;
+}
+
+bool
+Catalog::build(const char **roots, unsigned count, unsigned threads, Catalog *previous)
+{
+    char **paths = NULL;
+    unsigned numPaths = 0;
+    uint64_t start = usec();
+
+    // Collect all archives (sorted, without duplicates)
+    for (unsigned i = 0; i < count; i++)
+        collectPaths(&paths, &numPaths, roots[i], true);
+    if (numPaths)
+        qsort(paths, numPaths, sizeof(char *), comparePaths);
+
+    ScanJob job;
+    memset(&job, 0, sizeof(job));
+    job.images = (ScannedImage *)calloc(numPaths ? numPaths : 1, sizeof(ScannedImage));
+    job.previous = previous;
+    for (unsigned i = 0; i < numPaths; i++) {
+        if (job.count && strcmp(paths[i], job.images[job.count - 1].path) == 0) {
+            free(paths[i]);
+        } else {
+            job.images[job.count++].path = paths[i];
+        }
+    }
+    free(paths);
+
+    // Scan all archives in parallel. The calling thread is one of the workers.
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (unsigned)cores : 1;
+    }
+    if (threads > job.count) {
+        threads = job.count ? job.count : 1;
+    }
+
+    unsigned scanThreads = NIBArchive::getScanThreads();
+    NIBArchive::setScanThreads(threads > 1 ? 1 : scanThreads);
+    pthread_mutex_init(&job.lock, NULL);
+
+    pthread_t *workers = new pthread_t[threads];
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, scanWorker, &job) == 0)
+            started++;
+    }
+    scanWorker(&job);
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    delete[] workers;
+    pthread_mutex_destroy(&job.lock);
+    NIBArchive::setScanThreads(scanThreads);
+
+    // Compute the size of the index
+    uint32_t numImages = 0, numItems = 0, numSlots = 1;
+    uint64_t stringSize = 1;
+    for (unsigned i = 0; i < job.count; i++) {
+
+        ScannedImage *image = &job.images[i];
+        if (!image->valid)
+            continue;
+
+        numImages++;
+        numItems += image->numItems;
+        stringSize += strlen(image->path) + strlen(image->name) + 2;
+        for (unsigned n = 0; n < image->numItems; n++)
+            stringSize += strlen(image->itemNames[n]) + 1;
+    }
+    while (numSlots < 2 * numImages)
+        numSlots *= 2;
+
+    size_t length =
+    sizeof(Header) +
+    numImages * sizeof(ImageInfo) +
+    numItems * sizeof(ItemInfo) +
+    numSlots * sizeof(uint32_t) +
+    stringSize;
+
+    bool success = stringSize <= UINT32_MAX;
+    uint8_t *buffer = success ? (uint8_t *)calloc(1, length) : NULL;
+
+    if (buffer) {
+
+        // Assemble the index
+        Header *h = (Header *)buffer;
+        strcpy(h->magic, "VC64CAT");
+        h->version = version;
+        h->byteOrder = 0x01020304;
+        h->numImages = numImages;
+        h->numItems = numItems;
+        h->numSlots = numSlots;
+        h->stringSize = (uint32_t)stringSize;
+
+        ImageInfo *imageTable = (ImageInfo *)(buffer + sizeof(Header));
+        ItemInfo *itemTable = (ItemInfo *)(imageTable + numImages);
+        uint32_t *slotTable = (uint32_t *)(itemTable + numItems);
+        char *stringTable = (char *)(slotTable + numSlots);
+        uint32_t stringPos = 1, imageNr = 0, itemNr = 0;
+
+        for (unsigned i = 0; i < job.count; i++) {
+
+            ScannedImage *image = &job.images[i];
+            if (!image->valid)
+                continue;
+
+            ImageInfo *info = &imageTable[imageNr];
+            info->path = stringPos;
+            strcpy(stringTable + stringPos, image->path);
+            stringPos += strlen(image->path) + 1;
+            info->name = stringPos;
+            strcpy(stringTable + stringPos, image->name);
+            stringPos += strlen(image->name) + 1;
+            info->firstItem = itemNr;
+            info->numItems = image->numItems;
+            info->fileSize = image->fileSize;
+            info->modified = image->modified;
+            info->type = image->type;
+
+            for (unsigned n = 0; n < image->numItems; n++) {
+                itemTable[itemNr] = image->items[n];
+                itemTable[itemNr].name = stringPos;
+                strcpy(stringTable + stringPos, image->itemNames[n]);
+                stringPos += strlen(image->itemNames[n]) + 1;
+                itemNr++;
+            }
+
+            // Insert into the hash table (linear probing)
+            uint32_t slot = hashPath(image->path) & (numSlots - 1);
+            while (slotTable[slot])
+                slot = (slot + 1) & (numSlots - 1);
+            slotTable[slot] = imageNr + 1;
+
+            imageNr++;
+        }
+
+        success = attach(buffer, length, false);
+        if (!success)
+            free(buffer);
+    }
+
+    debug(2, "%d of %d archives indexed (%d items) in %lld msec\n",
+          numImages, job.count, numItems, (long long)(usec() - start) / 1000);
+
+    for (unsigned i = 0; i < job.count; i++) {
+
+        ScannedImage *image = &job.images[i];
+        for (unsigned n = 0; n < image->numItems; n++)
+            free(image->itemNames[n]);
+        free(image->itemNames);
+        free(image->items);
+        free(image->name);
+        free(image->path);
+    }
+    free(job.images);
+
+    return success;
+}
+
+bool
+Catalog::save(const char *filename)
+{
+    FILE *file;
+
+    if (data == NULL)
+        return false;
+
+    // Write to a temporary file first, because the old catalog might still be mapped
+    char *tmp = (char *)malloc(strlen(filename) + 5);
+    sprintf(tmp, "%s.tmp", filename);
+
+    if (!(file = fopen(tmp, "w"))) {
+        warn("Cannot write catalog %s\n", filename);
+        free(tmp);
+        return false;
+    }
+
+    bool success = fwrite(data, 1, size, file) == size;
+    success = (fclose(file) == 0) && success;
+    success = success && rename(tmp, filename) == 0;
+
+    if (!success) {
+        warn("Cannot write catalog %s\n", filename);
+        unlink(tmp);
+    }
+    free(tmp);
+    return success;
+}
+
+bool
+Catalog::load(const char *filename)
+{
+    int fd;
+    struct stat info;
+
+    if ((fd = open(filename, O_RDONLY)) < 0) {
+        warn("Cannot open catalog %s\n", filename);
+        return false;
+    }
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(Header)) {
+        close(fd);
+        warn("Not a catalog file\n");
+        return false;
+    }
+
+    size_t length = info.st_size;
+    void *buffer = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (buffer == MAP_FAILED) {
+        warn("Cannot map catalog %s\n", filename);
+        return false;
+    }
+    if (!attach((uint8_t *)buffer, length, true)) {
+        munmap(buffer, length);
+        return false;
+    }
+    return true;
+}
+
+int
+Catalog::findImage(const char *path)
+{
+    if (header == NULL)
+        return -1;
+
+    uint32_t mask = header->numSlots - 1;
+    for (uint32_t slot = hashPath(path) & mask, probes = 0; probes <= mask; slot = (slot + 1) & mask, probes++) {
+
+        uint32_t entry = slots[slot];
+        if (entry == 0 || entry > header->numImages)
+            return -1;
+        if (strcmp(string(images[entry - 1].path), path) == 0)
+            return entry - 1;
+    }
+    return -1;
+}
+
+bool
+Catalog::isUpToDate(unsigned i)
+{
+    struct stat info;
+
+    if (i >= getNumberOfImages())
+        return false;
+
+    char *file = PackedFile::getFilePath(getPathOfImage(i));
+    int result = stat(file, &info);
+    free(file);
+    if (result != 0)
+        return false;
+
+    return (uint64_t)info.st_size == images[i].fileSize && (int64_t)info.st_mtime == images[i].modified;
+}
+
+ContainerType
+Catalog::getTypeOfImage(unsigned i)
+{
+    return i < getNumberOfImages() ? (ContainerType)images[i].type : UNKNOWN_CONTAINER_FORMAT;
+}
+
+const Catalog::ItemInfo *
+Catalog::getItem(unsigned i, unsigned n)
+{
+    return n < getNumberOfItems(i) ? &items[images[i].firstItem + n] : NULL;
+}
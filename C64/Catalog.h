@@ -0,0 +1,222 @@
+/*!
+ * @header      Catalog.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _CATALOG_INC
+#define _CATALOG_INC
+
+#include "Container.h"
+
+/*! @class    Catalog
+ *  @brief    Persistent index of all files stored in a library of archives
+ *  @details  A catalog lists the archives found in a set of directory trees together
+ *            with the directory entries of each archive. All archive types are supported.
+ *            G64 and NIB images are decoded to find their directory. Archives packed
+ *            with gzip and members of zip archives are indexed, too.
+ *
+ *            The whole index is a single memory block which is written to disk as is.
+ *            Loading maps the file into memory. Hence, opening a catalog takes constant
+ *            time, no matter how large the library is, and no archive is ever parsed
+ *            again. Archives are looked up by path via a hash table which is part of the
+ *            index. Items are looked up by number.
+ *
+ *            Index layout: Header, ImageInfo[numImages], ItemInfo[numItems],
+ *            uint32_t slots[numSlots], char strings[stringSize]
+ */
+class Catalog : public VC64Object {
+
+public:
+
+    //! @brief    Information about a single archive
+    typedef struct {
+
+        //! @brief    Path of the archive file (offset into the string table)
+        uint32_t path;
+
+        //! @brief    Logical name of the archive (offset into the string table)
+        uint32_t name;
+
+        //! @brief    Index of the first item in the item table
+        uint32_t firstItem;
+
+        //! @brief    Number of items
+        uint32_t numItems;
+
+        //! @brief    Size of the archive file in bytes
+        uint64_t fileSize;
+
+        //! @brief    Modification time of the archive file (seconds since the epoch)
+        int64_t modified;
+
+        //! @brief    Archive type (ContainerType)
+        uint32_t type;
+
+        uint32_t _pad;
+
+    } ImageInfo;
+
+    //! @brief    Information about a single item of an archive
+    typedef struct {
+
+        //! @brief    Name of the item (offset into the string table)
+        uint32_t name;
+
+        //! @brief    Size in bytes
+        uint32_t size;
+
+        //! @brief    Size in blocks
+        uint16_t blocks;
+
+        //! @brief    Load address
+        uint16_t loadAddr;
+
+        //! @brief    Type of the item (e.g., "PRG" or "SEQ <")
+        char type[8];
+
+    } ItemInfo;
+
+private:
+
+    //! @brief    Header of the index
+    typedef struct {
+
+        //! @brief    Signature ("VC64CAT")
+        char magic[8];
+
+        //! @brief    Format version
+        uint32_t version;
+
+        //! @brief    Byte order marker (the index is stored in native byte order)
+        uint32_t byteOrder;
+
+        uint32_t numImages;
+        uint32_t numItems;
+
+        //! @brief    Number of hash table slots (a power of two)
+        uint32_t numSlots;
+
+        //! @brief    Size of the string table in bytes
+        uint32_t stringSize;
+
+    } Header;
+
+    //! @brief    Current format version
+    static const uint32_t version = 1;
+
+    //! @brief    The index
+    uint8_t *data;
+
+    //! @brief    Size of the index in bytes
+    size_t size;
+
+    //! @brief    Indicates whether the index is a memory-mapped file
+    bool mapped;
+
+    //! @brief    Pointers into the index
+    Header *header;
+    ImageInfo *images;
+    ItemInfo *items;
+    uint32_t *slots;
+    const char *strings;
+
+public:
+
+    //
+    //! @functiongroup Creating and destructing catalogs
+    //
+
+    //! @brief    Constructor
+    Catalog();
+
+    //! @brief    Destructor
+    ~Catalog();
+
+    //! @brief    Removes all entries
+    void clear();
+
+    /*! @brief    Indexes all archives found in a set of files and directory trees
+     *  @details  The archives are scanned in parallel. Paths are stored as passed in.
+     *            If a previous catalog is provided, archives whose size and modification
+     *            time haven't changed are taken from there instead of being scanned again.
+     *  @param    roots     Files and directories to scan
+     *  @param    count     Number of entries in roots
+     *  @param    threads   Number of worker threads (0 = one per CPU core)
+     *  @param    previous  An older catalog of the same library (optional)
+     */
+    bool build(const char **roots, unsigned count, unsigned threads = 0, Catalog *previous = NULL);
+
+    //! @brief    Writes the index to a file
+    bool save(const char *filename);
+
+    //! @brief    Maps an index file into memory
+    bool load(const char *filename);
+
+
+    //
+    //! @functiongroup Looking up archives
+    //
+
+    //! @brief    Returns the number of indexed archives
+    unsigned getNumberOfImages() { return header ? header->numImages : 0; }
+
+    //! @brief    Returns the number of an archive or -1 if it is not indexed
+    int findImage(const char *path);
+
+    //! @brief    Returns information about an archive
+    const ImageInfo *getImage(unsigned i) { return i < getNumberOfImages() ? &images[i] : NULL; }
+
+    //! @brief    Returns true iff an archive hasn't been modified since it has been indexed
+    bool isUpToDate(unsigned i);
+
+    const char *getPathOfImage(unsigned i) { return i < getNumberOfImages() ? string(images[i].path) : NULL; }
+    const char *getNameOfImage(unsigned i) { return i < getNumberOfImages() ? string(images[i].name) : NULL; }
+    ContainerType getTypeOfImage(unsigned i);
+
+
+    //
+    //! @functiongroup Looking up items
+    //
+
+    //! @brief    Returns the number of items in an archive
+    unsigned getNumberOfItems(unsigned i) { return getImage(i) ? images[i].numItems : 0; }
+
+    //! @brief    Returns information about an item of an archive
+    const ItemInfo *getItem(unsigned i, unsigned n);
+
+    const char *getNameOfItem(unsigned i, unsigned n) { return getItem(i, n) ? string(getItem(i, n)->name) : NULL; }
+    const char *getTypeOfItem(unsigned i, unsigned n) { return getItem(i, n) ? getItem(i, n)->type : NULL; }
+    size_t getSizeOfItem(unsigned i, unsigned n) { return getItem(i, n) ? getItem(i, n)->size : 0; }
+    size_t getSizeOfItemInBlocks(unsigned i, unsigned n) { return getItem(i, n) ? getItem(i, n)->blocks : 0; }
+    uint16_t getDestinationAddrOfItem(unsigned i, unsigned n) { return getItem(i, n) ? getItem(i, n)->loadAddr : 0; }
+
+private:
+
+    //! @brief    Returns a string from the string table
+    const char *string(uint32_t offset) { return offset < header->stringSize ? strings + offset : ""; }
+
+    //! @brief    Hash function used for the hash table
+    static uint32_t hashPath(const char *path);
+
+    /*! @brief    Adopts an index
+     *  @details  Sets up the pointers into the index. Returns false if the index is malformed.
+     */
+    bool attach(uint8_t *buffer, size_t length, bool isMapped);
+};
+
+#endif
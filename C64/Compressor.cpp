@@ -0,0 +1,153 @@
+/*!
+ * @header      Compressor.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "Compressor.h"
+
+static inline uint32_t
+read32(const uint8_t *ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+void
+Compressor::writeLength(uint8_t **ptr, size_t length)
+{
+    while (length >= 255) {
+        *(*ptr)++ = 255;
+        length -= 255;
+    }
+    *(*ptr)++ = (uint8_t)length;
+}
+
+size_t
+Compressor::compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    const uint8_t *ip = src, *anchor = src, *end = src + size;
+    uint8_t *op = dst;
+    
+    // The last match must start 12 bytes before the end. The last 5 bytes are literals.
+    if (size > 12) {
+        
+        uint32_t *table = new uint32_t[1 << hashBits]();
+        
+        while (ip < end - 12) {
+            
+            uint32_t sequence = read32(ip);
+            uint32_t hash = (sequence * 2654435761U) >> (32 - hashBits);
+            const uint8_t *ref = src + table[hash];
+            table[hash] = (uint32_t)(ip - src);
+            
+            if (ref >= ip || (size_t)(ip - ref) > maxOffset || read32(ref) != sequence) {
+                ip++;
+                continue;
+            }
+            
+            // Extend match
+            const uint8_t *match = ip + minMatch;
+            while (match < end - 5 && *match == ref[match - ip]) match++;
+            
+            size_t literals = ip - anchor;
+            size_t length = match - ip - minMatch;
+            size_t offset = ip - ref;
+            
+            // Write sequence
+            uint8_t *token = op++;
+            *token = (uint8_t)((MIN(literals, 15) << 4) | MIN(length, 15));
+            if (literals >= 15) writeLength(&op, literals - 15);
+            memcpy(op, anchor, literals);
+            op += literals;
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+            if (length >= 15) writeLength(&op, length - 15);
+            
+            ip = anchor = match;
+        }
+        
+        delete[] table;
+    }
+    
+    // Write remaining literals
+    size_t literals = end - anchor;
+    *op++ = (uint8_t)(MIN(literals, 15) << 4);
+    if (literals >= 15) writeLength(&op, literals - 15);
+    memcpy(op, anchor, literals);
+    op += literals;
+    
+    return op - dst;
+}
+
+bool
+Compressor::decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize)
+{
+    const uint8_t *ip = src, *iend = src + srcSize;
+    uint8_t *op = dst, *oend = dst + dstSize;
+    uint8_t byte;
+    
+    while (ip < iend) {
+        
+        uint8_t token = *ip++;
+        
+        // Copy literals
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            do {
+                if (ip == iend) return false;
+                literals += (byte = *ip++);
+            } while (byte == 255);
+        }
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op))
+            return false;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        
+        // The last sequence has no match
+        if (ip == iend)
+            break;
+        
+        // Copy match
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return false;
+        
+        size_t length = token & 0x0F;
+        if (length == 15) {
+            do {
+                if (ip == iend) return false;
+                length += (byte = *ip++);
+            } while (byte == 255);
+        }
+        length += minMatch;
+        if (length > (size_t)(oend - op))
+            return false;
+        
+        // Source and target may overlap
+        for (size_t i = 0; i < length; i++, op++)
+            *op = *(op - offset);
+    }
+    
+    return op == oend;
+}
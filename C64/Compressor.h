@@ -0,0 +1,72 @@
+/*!
+ * @header      Compressor.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _COMPRESSOR_INC
+#define _COMPRESSOR_INC
+
+#include "basic.h"
+
+/*! @class    Compressor
+ *  @brief    Fast built-in LZ compression
+ *  @details  The compressed data is stored in the LZ4 block format. The compressor is a
+ *            simple greedy matcher that favors speed over compression ratio. Emulator
+ *            snapshots contain large, mostly zeroed memory areas and compress well anyway.
+ */
+class Compressor {
+    
+private:
+    
+    //! @brief    Minimum length of a match
+    static const size_t minMatch = 4;
+    
+    //! @brief    Maximum distance between a match and its reference
+    static const size_t maxOffset = 65535;
+    
+    //! @brief    Number of bits of the hash table index
+    static const unsigned hashBits = 16;
+    
+    //! @brief    Writes a length value that doesn't fit into a token nibble
+    static void writeLength(uint8_t **ptr, size_t length);
+    
+public:
+    
+    //! @brief    Returns the maximum size of compressed data
+    static size_t maxCompressedSize(size_t size) { return size + size / 255 + 16; }
+    
+    /*! @brief    Returns the maximum size of decompressed data
+     *  @details  A single byte of compressed data expands to at most 255 bytes.
+     */
+    static size_t maxDecompressedSize(size_t size) { return size * 255; }
+    
+    /*! @brief    Compresses a data block
+     *  @param    dst must provide space for maxCompressedSize(size) bytes.
+     *  @return   The number of bytes written into dst.
+     */
+    static size_t compress(const uint8_t *src, size_t size, uint8_t *dst);
+    
+    /*! @brief    Decompresses a data block
+     *  @details  All accesses are bounds checked. Hence, corrupted data is detected.
+     *  @return   true, if exactly dstSize bytes have been decompressed.
+     */
+    static bool decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+};
+
+#endif
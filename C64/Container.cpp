@@ -17,12 +17,16 @@
  */
 
 #include "Container.h"
+#include "PackedFile.h"
 
 Container::Container()
 {
     const char *defaultName = "HELLO VIRTUALC64";
     
 	path = NULL;
+    mapping = NULL;
+    mappingSize = 0;
+    mappingAdopted = false;
     memcpy(name, defaultName, strlen(defaultName) + 1);
 }
 
@@ -30,6 +34,50 @@ Container::~Container()
 {
 	if (path)
 		free(path);
+    unmap();
+}
+
+void
+Container::unmap()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    
+    mapping = NULL;
+    mappingSize = 0;
+    mappingAdopted = false;
+}
+
+uint8_t *
+Container::adoptBuffer(const uint8_t *buffer, size_t length)
+{
+    assert(buffer != NULL);
+    
+    // Hand over the mapped file contents
+    if (buffer == mapping && length <= mappingSize && !mappingAdopted) {
+        mappingAdopted = true;
+        return mapping;
+    }
+    
+    // Create a copy
+    uint8_t *result = (uint8_t *)malloc(length);
+    if (result)
+        memcpy(result, buffer, length);
+    
+    return result;
+}
+
+void
+Container::releaseBuffer(uint8_t *buffer)
+{
+    if (buffer == NULL)
+        return;
+    
+    if (buffer == mapping && mappingAdopted) {
+        unmap();
+    } else {
+        free(buffer);
+    }
 }
 
 bool
@@ -84,61 +132,86 @@ Container::readFromFile(const char *filename)
     
     bool success = false;
 	uint8_t *buffer = NULL;
-	FILE *file = NULL;
+	int fd = -1;
 	struct stat fileProperties;
     char *name = NULL;
-	
+    char *unpacked = NULL;
+	size_t size;
+    PackedFile *packed = NULL;
+    
 	// Check file type
     if (!hasSameType(filename)) {
 		goto exit;
 	}
 	
-	// Get file properties
-    if (stat(filename, &fileProperties) != 0) {
-		goto exit;
-	}
-		
+    // Decompress packed files directly into an anonymous mapping
+    if (PackedFile::isPackedPath(filename)) {
+        
+        if ((packed = PackedFile::makePackedFileWithPath(filename)) == NULL) {
+            goto exit;
+        }
+        if ((buffer = packed->mapMember(packed->getSelectedMember(), &size)) == NULL) {
+            goto exit;
+        }
+        goto read;
+    }
+    
 	// Open file
-	if (!(file = fopen(filename, "r"))) {
+	if ((fd = open(filename, O_RDONLY)) < 0) {
 		goto exit;
 	}
 
-	// Allocate memory
-	if (!(buffer = (uint8_t *)malloc(fileProperties.st_size))) {
+	// Get file properties
+    if (fstat(fd, &fileProperties) != 0 || fileProperties.st_size == 0) {
 		goto exit;
 	}
 	
-	// Read from file
-	int c;
-	for (unsigned i = 0; i < fileProperties.st_size; i++) {
-		c = fgetc(file);
-		if (c == EOF)
-			break;
-		buffer[i] = (uint8_t)c;
+	// Map file into memory (copy-on-write)
+    size = (size_t)fileProperties.st_size;
+	buffer = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (buffer == MAP_FAILED) {
+        buffer = NULL;
+		goto exit;
 	}
 	
+read:
 	// Read from buffer (subclass specific behaviour)
 	dealloc();
-	if (!readFromBuffer(buffer, (unsigned)fileProperties.st_size)) {
+    unmap();
+    mapping = buffer;
+    mappingSize = size;
+	success = readFromBuffer(buffer, size);
+    
+    // Keep the mapping only if it has been adopted by the subclass
+    if (!mappingAdopted) {
+        unmap();
+    }
+    buffer = NULL;
+    
+	if (!success) {
 		goto exit;
 	}
 
 	// Set path and default name
     setPath(filename);
-    name = ExtractFilenameWithoutSuffix(filename);
+    unpacked = PackedFile::getUnpackedPath(filename);
+    name = ExtractFilenameWithoutSuffix(unpacked);
     setName(name);
         
     debug(1, "Container %s (%s) read successfully from file %s\n", name, getName(), path);
-	success = true;
 
 exit:
 	
     if (name)
         free(name);
-    if (file)
-		fclose(file);
+    if (unpacked)
+        free(unpacked);
+    if (packed)
+        delete packed;
+    if (fd >= 0)
+		close(fd);
 	if (buffer)
-		free(buffer);
+		munmap(buffer, size);
 
 	return success;
 }
@@ -179,9 +252,9 @@ Container::writeToFile(const char *filename)
 	}
 
 	// Write to file
-	for (unsigned i = 0; i < filesize; i++) {
-		fputc(data[i], file);
-	}	
+	if (fwrite(data, 1, filesize, file) != filesize) {
+		goto exit;
+	}
 	
 	success = true;
 
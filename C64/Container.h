@@ -36,6 +36,21 @@ private:
     //! @brief    The physical name (full path name) of the container.
     char *path;
     
+    /*! @brief    Memory-mapped file contents
+     *  @details  Set while readFromFile() is running and as long as a subclass has
+     *            adopted the mapping via adoptBuffer().
+     */
+    uint8_t *mapping;
+    
+    //! @brief    Size of the memory-mapped file contents in bytes
+    size_t mappingSize;
+    
+    //! @brief    Indicates whether a subclass has adopted the mapping
+    bool mappingAdopted;
+    
+    //! @brief    Unmaps the memory-mapped file contents
+    void unmap();
+    
 protected:
     
     /*! @brief    Checks the header signature of a buffer.
@@ -48,6 +63,18 @@ protected:
      */
     static bool checkBufferHeader(const uint8_t *buffer, size_t length, const uint8_t *header);
     
+    /*! @brief    Provides a private copy of the buffer passed to readFromBuffer()
+     *  @details  If the buffer is the memory-mapped file read by readFromFile(), no copy
+     *            is made. The mapping is handed over instead. It is mapped copy-on-write,
+     *            so the returned data can be modified without touching the file, and
+     *            unmodified pages are shared with all other processes mapping the file.
+     *  @return   The data or NULL, if memory is exhausted. Free it with releaseBuffer().
+     */
+    uint8_t *adoptBuffer(const uint8_t *buffer, size_t length);
+    
+    //! @brief    Frees a buffer returned by adoptBuffer() or allocated with malloc()
+    void releaseBuffer(uint8_t *buffer);
+    
     /*! @brief    The logical name of the container.
      *  @details  Some archives store a logical name in their header section. 
      *            If they don't store a special name, the logical name is the raw filename
@@ -123,8 +150,10 @@ public:
     virtual bool readFromBuffer(const uint8_t *buffer, size_t length) { return false; }
 	
     /*! @brief    Read container contents from a file.
-     *  @details  This function requires no custom implementation. It first reads in the file contents 
-     *            in memory and invokes readFromBuffer afterwards. 
+     *  @details  This function requires no custom implementation. It maps the file into
+     *            memory and invokes readFromBuffer afterwards. Subclasses that adopt the
+     *            buffer keep the file mapped as long as they use the data.
+     *  @note     A mapped file must not be truncated while the container is alive.
      *  @param    filename The name of a file containing a binary representation.
      */
 	bool readFromFile(const char *filename);
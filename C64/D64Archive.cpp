@@ -17,6 +17,7 @@
  */
 
 #include "D64Archive.h"
+#include "Disk525.h"
 #include "T64Archive.h"
 #include "PRGArchive.h"
 #include "P00Archive.h"
@@ -86,8 +87,10 @@ D64Archive::D64Archive()
     memset(name, 0, sizeof(name));
     memset(data, 0, sizeof(data));
     memset(errors, 0, sizeof(errors));
+    numDirEntries = -1;
     numTracks = 35;
     fp = 0;
+    fpSectors = 0;
 }
 
 D64Archive *
@@ -116,6 +119,33 @@ D64Archive::makeD64ArchiveWithFile(const char *path)
     return archive;
 }
 
+D64Archive *
+D64Archive::makeD64ArchiveWithDisk(Disk525 *disk)
+{
+    assert(disk != NULL);
+    
+    D64Archive *archive = new D64Archive();
+    archive->debug(1, "Creating D64 archive from a disk with %d tracks...\n", disk->numTracks);
+    
+    // Perform test run
+    int error;
+    size_t size = disk->decodeDisk(NULL, &error);
+    unsigned tracks = disk->numTracks;
+    if (tracks == 35 || tracks == 40 || tracks == 42) {
+        archive->numTracks = tracks;
+    }
+    if (error || archive->numTracks != tracks || size != archive->writeToBuffer(NULL)) {
+        archive->debug(2, "Cannot create archive (error code: %d, %zu bytes)\n", error, size);
+        delete archive;
+        return NULL;
+    }
+    
+    // Decode disk
+    disk->decodeDisk(archive->data);
+    
+    return archive;
+}
+
 D64Archive *
 D64Archive::makeD64ArchiveWithAnyArchive(Archive *otherArchive)
 {
@@ -347,6 +377,7 @@ D64Archive::readFromBuffer(const uint8_t *buffer, size_t length)
 	}
 	
 	// Read tracks
+	numDirEntries = -1;
 	uint8_t *source = (uint8_t *)buffer;
 	for(unsigned track = 1; track <= numTracks; track++) {
 		
@@ -420,12 +451,9 @@ D64Archive::getUnicodeName(size_t maxChars)
 int
 D64Archive::getNumberOfItems()
 {
-    unsigned offsets[144]; // a C64 disk contains at most 144 files
-    unsigned noOfFiles;
-    
-    scanDirectory(offsets, &noOfFiles);
+    cacheDirectory();
     
-    return noOfFiles;
+    return numDirEntries;
 }
 
 const char *
@@ -533,6 +561,7 @@ void
 D64Archive::selectItem(int item)
 {
     fp = -1;
+    fpSectors = 0;
     
     // check, if item exists
     if (item >= getNumberOfItems())
@@ -576,7 +605,7 @@ D64Archive::getByte()
     if (isLastByteOfSector(fp)) {
         
         // Continue reading in new sector
-        if (!jumpToNextSector(&fp)) {
+        if (++fpSectors >= sizeof(errors) || !jumpToNextSector(&fp)) {
             // The current sector points to an invalid next track/sector
             // We won't jump off the cliff and terminate reading here.
             fp = -1;
@@ -631,14 +660,26 @@ D64Archive::setNumberOfTracks(unsigned tracks)
 uint8_t *
 D64Archive::findSector(unsigned track, unsigned sector)
 {
-    return data + offset(track, sector);
+    int pos = offset(track, sector);
+    if (pos < 0)
+        return NULL;
+
+    numDirEntries = -1;
+    return data + pos;
+}
+
+const uint8_t *
+D64Archive::readSector(unsigned track, unsigned sector)
+{
+    int pos = offset(track, sector);
+    return pos < 0 ? NULL : data + pos;
 }
 
 int
 D64Archive::offset(int track, int sector)
 {
-    assert(1 <= track && track <= 42);
-    assert(sector < D64Map[track].numberOfSectors);
+    if (track < 1 || track > 42 || sector < 0 || sector >= D64Map[track].numberOfSectors)
+        return -1;
     
     return D64Map[track].offset + (sector * 256);
 }
@@ -678,7 +719,7 @@ D64Archive::jumpToNextSector(int *pos)
 	nTrack = nextTrack(*pos);
 	nSector = nextSector(*pos);
     
-    if (nTrack > (int)numTracks || nSector > D64Map[nTrack].numberOfSectors) {
+    if (nTrack > (int)numTracks || offset(nTrack, nSector) < 0) {
         return false;
     }
     
@@ -693,6 +734,9 @@ D64Archive::writeByteToSector(uint8_t byte, uint8_t *t, uint8_t *s)
     uint8_t sector = *s;
     
     int pos = offset(track, sector);
+    if (pos < 0)
+        return false;
+
     uint8_t positionOfLastDataByte = data[pos + 1];
     
     if (positionOfLastDataByte == 0xFF) {
@@ -706,6 +750,7 @@ D64Archive::writeByteToSector(uint8_t byte, uint8_t *t, uint8_t *s)
         data[pos++] = track;
         data[pos] = sector;
         pos = offset(track, sector);
+        assert(pos >= 0);
         positionOfLastDataByte = 0;
     }
     
@@ -870,12 +915,28 @@ D64Archive::scanDirectory(unsigned *offsets, unsigned *noOfFiles, bool skipInvis
 }
 
 
+void
+D64Archive::cacheDirectory()
+{
+    unsigned noOfFiles;
+    
+    if (numDirEntries < 0) {
+        scanDirectory(dirEntries, &noOfFiles);
+        numDirEntries = noOfFiles;
+    }
+}
+
 int
 D64Archive::findDirectoryEntry(int item, bool skipInvisibleFiles)
 {
     unsigned offsets[144];
     unsigned noOfFiles;
     
+    if (skipInvisibleFiles) {
+        cacheDirectory();
+        return (item >= 0 && item < numDirEntries) ? dirEntries[item] : -1;
+    }
+    
     scanDirectory(offsets, &noOfFiles, skipInvisibleFiles);
     // printf("scanDirectory: %d %d\n", noOfFiles, offsets[0]);
     
@@ -887,6 +948,7 @@ D64Archive::writeDirectoryEntry(unsigned nr, const char *name, uint8_t startTrac
 {
 	int pos;
 	
+    numDirEntries = -1;
     if (nr >= 144) {
         warn("Cannot write directory entry. Number of files is limited to 144\n");
 		return false;
@@ -950,6 +1012,10 @@ D64Archive::dumpSector(int track, int sector)
 {
     int pos = offset(track, sector);
     
+    if (pos < 0) {
+        msg("Sector %d/%d does not exist\n", track, sector);
+        return;
+    }
     msg("Sector %d/%d\n", track, sector);
     for (int i = 0; i < 256; i++) {
         msg("%02X ", data[pos++]);
@@ -24,6 +24,9 @@
 
 #include "Archive.h"
 
+// Forward declarations
+class Disk525;
+
 // D64 files come in six different sizes
 #define D64_683_SECTORS 174848
 #define D64_683_SECTORS_ECC 175531
@@ -48,6 +51,16 @@ private:
      */
 	uint8_t errors[802];
 	
+	/*! @brief   Offsets of all visible directory entries
+     *  @details The directory is scanned on first access. Every function handing out a
+     *           pointer into the archive data invalidates the cache.
+     *  @see     cacheDirectory
+     */
+	unsigned dirEntries[144];
+	
+	//! @brief   Number of cached directory entries (-1 if the cache is invalid)
+	int numDirEntries;
+	
 	/*! @brief   The number of tracks stored in this archive.
         @details Possible values are 35, 40, and 42.
      */
@@ -57,6 +70,11 @@ private:
         @details An offset into the data array. 
      */
 	int fp;
+	
+	/*! @brief   Number of sectors the file pointer has moved through
+        @details Used to stop reading when a corrupted image contains a cyclic sector chain.
+     */
+	unsigned fpSectors;
 
     //! @brief    Unicode name representation
     // unsigned short unicodeName[256];
@@ -81,6 +99,12 @@ public:
      */
     static D64Archive *makeD64ArchiveWithAnyArchive(Archive *otherArchive);
     
+    /*! @brief    Factory method
+     *  @details  Decodes all tracks of a virtual floppy disk. Returns NULL, if the disk
+     *            cannot be decoded or doesn't have the regular number of sectors per track.
+     */
+    static D64Archive *makeD64ArchiveWithDisk(Disk525 *disk);
+    
     //! @brief    Standard destructor
     ~D64Archive();
     
@@ -122,7 +146,7 @@ public:
     //
 
     //! @brief    Returns a pointer to the raw archive data
-    uint8_t *getData() { return data; }
+    uint8_t *getData() { numDirEntries = -1; return data; }
 
     //! @brief    Returns the number of tracks stored in this image
     unsigned numberOfTracks();
@@ -150,6 +174,13 @@ public:
 	//! @brief    Returns the high byte of the disk ID
 	uint8_t diskIdHi() { return data[offset(18, 0) + 0xA3]; }
 
+    /*! @brief    Returns the error code of a sector
+     *  @details  The codes are taken from the error information stored in the D64 file.
+     *            0 and 1 indicate that the sector has been read without errors. 0 is also
+     *            returned if the file doesn't contain any error information.
+     */
+    uint8_t errorCode(unsigned track, unsigned sector) { return errors[offset(track, sector) / 256]; }
+
  
     //
     //! @functiongroup Accessing tracks and sectors
@@ -157,9 +188,16 @@ public:
     
 public:
 
-    //! Returns a pointer to the raw sector data
+    //! Returns a pointer to the raw sector data (NULL if the sector doesn't exist)
     uint8_t *findSector(unsigned track, unsigned sector);
 
+    /*! @brief    Returns a pointer to the raw sector data for reading
+     *  @details  Unlike findSector(), this function doesn't modify the archive. Hence, it
+     *            can be called by multiple threads concurrently (e.g., by the background
+     *            encoder of a disk).
+     */
+    const uint8_t *readSector(unsigned track, unsigned sector);
+
 private:
         
     //! Translates a track and sector number into an offset
@@ -221,6 +259,9 @@ private:
      */
     void scanDirectory(unsigned *offsets, unsigned *noOfFiles, bool skipInvisibleFiles = true);
     
+    //! @brief   Scans the directory for visible files unless the result is cached already
+    void cacheDirectory();
+    
     /*! @brief   Looks up a directory item by number.
      *  @details This function searches the directory for the requested item. 
      *  @param   itemBumber Number of the item. The first item has number 0.
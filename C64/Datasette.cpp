@@ -50,6 +50,7 @@ Datasette::Datasette()
     // Initialize all values that are not initialized in reset()
     data = NULL;
     size = 0;
+    dataBlob = 0;
     type = 0;
     durationInCycles = 0;
 }
@@ -58,8 +59,10 @@ Datasette::~Datasette()
 {
     debug(3, "Releasing Datasette...\n");
 
+    if (dataBlob)
+        BlobStore::unshare(dataBlob, &dataBlob);
     if (data)
-        delete data;
+        free(data);
 }
 
 void
@@ -82,7 +85,13 @@ Datasette::ping()
 size_t
 Datasette::stateSize()
 {
-    return VirtualComponent::stateSize() + size;
+    size_t result = VirtualComponent::stateSize();
+
+    // Tag byte, followed by the blob hash or the tape data
+    if (size)
+        result += 1 + (dataBlob ? sizeof(dataBlob) : size);
+    
+    return result;
 }
 
 void
@@ -90,12 +99,33 @@ Datasette::loadFromBuffer(uint8_t **buffer)
 {
     uint8_t *old = *buffer;
     
+    uint64_t oldBlob = dataBlob;
+    
     VirtualComponent::loadFromBuffer(buffer);
+    dataBlob = 0;
     if (size) {
-        if (data == NULL)
+        uint64_t hash = read8(buffer) ? read64(buffer) : 0;
+        if (hash == 0 || hash != oldBlob) {
+            if (oldBlob)
+                BlobStore::unshare(oldBlob, &dataBlob);
+            oldBlob = 0;
+            if (data)
+                free(data);
             data = (uint8_t *)malloc(size);
-        readBlock(buffer, (uint8_t *)data, size);
+        }
+        if (hash == 0) {
+            readBlock(buffer, (uint8_t *)data, size);
+        } else if (hash == oldBlob) {
+            oldBlob = 0; // Keep reference
+        } else if (!BlobStore::copy(hash, data, size) || !BlobStore::retain(hash)) {
+            warn("Tape blob %016llX is missing. Snapshot is corrupted.\n", hash);
+            memset(data, 0, size);
+            hash = 0;
+        }
+        dataBlob = hash;
     }
+    if (oldBlob)
+        BlobStore::unshare(oldBlob, &dataBlob);
     
     if (*buffer - old != stateSize())
         assert(0);
@@ -109,13 +139,43 @@ Datasette::saveToBuffer(uint8_t **buffer)
     VirtualComponent::saveToBuffer(buffer);
     if (size) {
         assert(data != NULL);
-        writeBlock(buffer, (uint8_t *)data, size);
+        write8(buffer, dataBlob ? 1 : 0);
+        if (dataBlob)
+            write64(buffer, dataBlob);
+        else
+            writeBlock(buffer, (uint8_t *)data, size);
     }
     
     if (*buffer - old != stateSize())
         assert(0);
 }
 
+uint64_t
+Datasette::stateHash()
+{
+    uint64_t result = VirtualComponent::stateHash();
+    
+    if (size) {
+        if (dataBlob)
+            result = hashBlock(&dataBlob, sizeof(dataBlob), result);
+        else
+            result = hashBlock(data, size, result);
+    }
+    
+    return result;
+}
+
+unsigned
+Datasette::collectBlobs(uint64_t *hashes, unsigned max)
+{
+    unsigned count = VirtualComponent::collectBlobs(hashes, max);
+    
+    if (dataBlob && count < max)
+        hashes[count++] = dataBlob;
+    
+    return count;
+}
+
 void
 Datasette::dumpState()
 {
@@ -146,6 +206,7 @@ Datasette::insertTape(TAPContainer *a)
     // Copy data
     data = (uint8_t *)malloc(size);
     memcpy(data, a->getData(), size);
+    shareBlob(&dataBlob, data, size);
 
     // Determine tape length (by fast forwarding)
     rewind();
@@ -169,6 +230,7 @@ Datasette::ejectTape()
     pressStop();
     
     assert(data != NULL);
+    unshareBlob(&dataBlob);
     free(data);
     data = NULL;
     size = 0;
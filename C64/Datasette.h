@@ -51,6 +51,12 @@ public:
     
     //! @brief    Saves the current state into a buffer
     void saveToBuffer(uint8_t **buffer);
+    
+    //! @brief    Computes a hash over the current state, including the tape
+    uint64_t stateHash();
+    
+    //! @brief    Collects the hashes of all referenced blobs
+    unsigned collectBlobs(uint64_t *hashes, unsigned max);
 
     //! @brief    Dumps the current state
     void dumpState();
@@ -76,6 +82,11 @@ private:
      */
     uint64_t size;
     
+    /*! @brief    Blob store hash of the data buffer
+     *  @details  If the hash is not 0, snapshots only contain the hash instead of the data.
+     */
+    uint64_t dataBlob;
+    
     /*! @brief    Data format (TAP type)
      *  @details  In TAP format 0, data byte 0 signals a long puls without stating its length precisely.
      *            In TAP format 1, each 0 is followed by three bytes stating the precise length in
@@ -21,18 +21,70 @@
 #include "D64Archive.h"
 #include "G64Archive.h"
 #include "NIBArchive.h"
+#include <sys/mman.h>
+
+//! @brief    File holding the blank disk all disk data is mapped from
+static int blankDisk = -1;
+
+//! @brief    Synchronizes the creation of the blank disk
+static pthread_once_t blankDiskOnce = PTHREAD_ONCE_INIT;
+
+//! @brief    Blob store hash of the blank disk (the blob is never released)
+static uint64_t blankDiskBlob = 0;
+
+static void
+createBlankDisk()
+{
+    uint8_t halftrack[7928];
+    FILE *file = tmpfile();
+    
+    if (file == NULL)
+        return;
+    
+    memset(halftrack, 0x55, sizeof(halftrack));
+    for (unsigned i = 0; i < sizeof(DiskData) / sizeof(halftrack); i++) {
+        if (fwrite(halftrack, 1, sizeof(halftrack), file) != sizeof(halftrack)) {
+            fclose(file);
+            return;
+        }
+    }
+    fflush(file);
+    
+    // The file stays open until the application terminates
+    blankDisk = fileno(file);
+    
+    // All empty drives share a single blob. Hence, snapshots only contain its hash.
+    void *addr = mmap(NULL, sizeof(DiskData), PROT_READ, MAP_SHARED, blankDisk, 0);
+    if (addr != MAP_FAILED)
+        blankDiskBlob = BlobStore::share((const uint8_t *)addr, sizeof(DiskData), &blankDiskBlob);
+}
 
 Disk525::Disk525()
 {
     setDescription("Disk525");
+    data = NULL;
+    mapped = false;
+    text = NULL;
+    blob = 0;
+    source = NULL;
+    sourceBlob = 0;
+    pendingTracks = 0;
+    encoderStarted = false;
+    encoderPaused = false;
+    pthread_mutex_init(&encodeLock, NULL);
+    pthread_cond_init(&encodeCond, NULL);
+    if (!mapBlankDisk())
+        memset(data, 0x55, sizeof(DiskData));
 
     // Register snapshot items
     SnapshotItem items[] = {        
-        { data.track[0],    sizeof(data.track),     KEEP_ON_RESET },
+        { data->track[0],   sizeof(data->track),    KEEP_ON_RESET,  dirty,  sizeof(data->halftrack[0]), &blob },
         { length.track[0],  sizeof(length.track),   KEEP_ON_RESET | WORD_FORMAT },
         { &numTracks,       sizeof(numTracks),      KEEP_ON_RESET },
         { &writeProtected,  sizeof(writeProtected), KEEP_ON_RESET },
         { &modified,        sizeof(modified),       KEEP_ON_RESET },
+        { &pendingTracks,   sizeof(pendingTracks),  KEEP_ON_RESET },
+        { &sourceBlob,      sizeof(sourceBlob),     KEEP_ON_RESET },
         { NULL,             0,                      0 }};
     
     registerSnapshotItems(items, sizeof(items));
@@ -47,6 +99,124 @@ Disk525::Disk525()
 
 Disk525::~Disk525()
 {
+    cancelEncoding();
+    pthread_cond_destroy(&encodeCond);
+    pthread_mutex_destroy(&encodeLock);
+    
+    // The blob store must not refer to the disk data anymore
+    if (blob) {
+        BlobStore::unshare(blob, &blob);
+        blob = 0;
+    }
+    
+    if (mapped)
+        munmap(data, sizeof(DiskData));
+    else
+        delete data;
+    delete[] text;
+}
+
+bool
+Disk525::mapBlankDisk()
+{
+    pthread_once(&blankDiskOnce, createBlankDisk);
+    
+    if (blankDisk >= 0 && (mapped || data == NULL)) {
+        
+        int flags = mapped ? MAP_PRIVATE | MAP_FIXED : MAP_PRIVATE;
+        void *addr = mmap(data, sizeof(DiskData), PROT_READ | PROT_WRITE, flags, blankDisk, 0);
+        
+        if (addr != MAP_FAILED) {
+            data = (DiskData *)addr;
+            mapped = true;
+            return true;
+        }
+        
+        // A failed MAP_FIXED request leaves the old mapping in an undefined state
+        assert(!mapped);
+    }
+    
+    if (data == NULL) {
+        warn("Cannot map disk data. Allocating %zu bytes on the heap.\n", sizeof(DiskData));
+        data = new DiskData;
+    }
+    return false;
+}
+
+void
+Disk525::loadFromBuffer(uint8_t **buffer)
+{
+    // The background thread must not overwrite the restored data
+    cancelEncoding();
+    VirtualComponent::loadFromBuffer(buffer);
+    setModifiedHalftracks();
+    
+    // The snapshot might have been taken after the last track had been encoded
+    if (pendingTracks == 0) {
+        if (sourceBlob != 0)
+            shareData();
+        sourceBlob = 0;
+        return;
+    }
+    
+    // Encode the tracks that were pending when the snapshot was taken
+    D64Archive *archive = NULL;
+    size_t size = BlobStore::size(sourceBlob);
+    uint8_t *d64 = new uint8_t[size];
+    if (size && BlobStore::copy(sourceBlob, d64, size) && BlobStore::retain(sourceBlob)) {
+        if ((archive = D64Archive::makeD64ArchiveWithBuffer(d64, size)) == NULL)
+            BlobStore::release(sourceBlob);
+    }
+    delete[] d64;
+    
+    if (archive == NULL) {
+        warn("D64 archive %016llX is missing. Pending tracks are left blank.\n", sourceBlob);
+        sourceBlob = 0;
+        pendingTracks = 0;
+        return;
+    }
+    startEncoding(archive, pendingTracks);
+}
+
+void
+Disk525::saveToBuffer(uint8_t **buffer)
+{
+    bool locked = lockEncoder();
+    VirtualComponent::saveToBuffer(buffer);
+    unlockEncoder(locked);
+}
+
+void
+Disk525::saveDirtyToBuffer(uint8_t **buffer)
+{
+    bool locked = lockEncoder();
+    VirtualComponent::saveDirtyToBuffer(buffer);
+    unlockEncoder(locked);
+}
+
+unsigned
+Disk525::collectBlobs(uint64_t *hashes, unsigned max)
+{
+    unsigned count = 0;
+    
+    // The blank disk is always in the blob store
+    if (blob == 0 || blob != blankDiskBlob)
+        count = VirtualComponent::collectBlobs(hashes, max);
+    
+    // Pending tracks are encoded from the archive when the snapshot is loaded
+    if (isEncoding() && sourceBlob != 0 && count < max)
+        hashes[count++] = sourceBlob;
+    
+    return count;
+}
+
+uint64_t
+Disk525::stateHash()
+{
+    bool locked = lockEncoder();
+    uint64_t result = VirtualComponent::stateHash();
+    unlockEncoder(locked);
+    return result;
 }
 
 void
@@ -55,6 +225,8 @@ Disk525::dumpState()
     unsigned noOfOneBits, alignedSyncs, unalignedSyncs;
     uint8_t bit;
     
+    finishEncoding();
+    
     msg("5,25\" floppy disk\n");
     msg("-----------------\n\n");
 
@@ -62,7 +234,7 @@ Disk525::dumpState()
         assert(isTrackNumber(track));
         noOfOneBits = alignedSyncs = unalignedSyncs = 0;
         for (unsigned offset = 0; offset < length.track[track][0]; offset++) {
-            if ((bit = readBit(data.track[track], offset))) {
+            if ((bit = readBit(data->track[track], offset))) {
                 noOfOneBits++;
             } else {
                 if (noOfOneBits >= 10) { // SYNC FOUND
@@ -114,6 +286,7 @@ void
 Disk525::dumpHalftrack(Halftrack ht, unsigned min, unsigned max, unsigned highlight)
 {
     assert(isHalftrackNumber(ht));
+    requestHalftrack(ht);
     
     uint16_t bytesOnTrack = length.halftrack[ht] / 8;
     
@@ -121,7 +294,7 @@ Disk525::dumpHalftrack(Halftrack ht, unsigned min, unsigned max, unsigned highli
     
     msg("Dumping track %d (length = %d)\n", ht, bytesOnTrack);
     for (unsigned i = min; i < max; i++) {
-        msg(i == highlight ? "(%02X) " : "%02X ", data.halftrack[ht][i]);
+        msg(i == highlight ? "(%02X) " : "%02X ", data->halftrack[ht][i]);
     }
     msg("\n");
 }
@@ -129,26 +302,87 @@ Disk525::dumpHalftrack(Halftrack ht, unsigned min, unsigned max, unsigned highli
 void
 Disk525::clearDisk()
 {
+    cancelEncoding();
+    
+    // Remapping the blank disk frees all pages that have been written
+    if (blob) unshareBlob(&blob);
+    bool blank = mapBlankDisk();
+    
     for (Halftrack ht = 1; ht <= 84; ht++) {
-        clearHalftrack(ht);
-        length.halftrack[ht] = sizeof(data.halftrack[ht]) * 8;
+        if (!blank) clearHalftrack(ht);
+        length.halftrack[ht] = sizeof(data->halftrack[ht]) * 8;
     }
     writeProtected = false;
     modified = false; 
+    memset(dirty, 1, sizeof(dirty));
+    setModifiedHalftracks();
+    
+    // A heap allocated disk has the same contents as the mapped one
+    if (blankDiskBlob == 0 || !retainBlob(&blob, blankDiskBlob))
+        shareData();
 }
 
 void
 Disk525::clearHalftrack(Halftrack ht)
 {
     assert(isHalftrackNumber(ht));
-    memset(data.halftrack[ht], 0x55, sizeof(data.halftrack[ht]));
+    if (blob) unshareBlob(&blob);
+    memset(data->halftrack[ht], 0x55, sizeof(data->halftrack[ht]));
+    dirty[ht + 1] = 1;
+    modifiedHalftracks[ht] = 1;
+}
+
+unsigned
+Disk525::readBitsFromHalftrack(Halftrack ht, unsigned offset, uint64_t *bits)
+{
+    assert(isHalftrackNumber(ht));
+    
+    unsigned len = length.halftrack[ht];
+    if (offset >= len) {
+        *bits = 0;
+        return 0;
+    }
+    
+    unsigned count = MIN(64, len - offset);
+    unsigned shift = offset % 8;
+    unsigned bytes = (shift + count + 7) / 8;
+    uint8_t *ptr = data->halftrack[ht] + offset / 8;
+    
+    // Never touch bytes beyond the end of the halftrack
+    uint64_t result = 0;
+    for (unsigned i = 0; i < 8; i++)
+        result = (result << 8) | (i < bytes ? ptr[i] : 0);
+    result <<= shift;
+    if (bytes > 8)
+        result |= ptr[8] >> (8 - shift);
+    
+    // Mask out the bits beyond the end of the halftrack
+    *bits = count < 64 ? result & ~(~0ULL >> count) : result;
+    return count;
+}
+
+bool
+Disk525::isEmptyHalftrack(Halftrack ht)
+{
+    assert(isHalftrackNumber(ht));
+    
+    requestHalftrack(ht);
+    for (unsigned i = 0; i < length.halftrack[ht] / 8; i++) {
+        if (data->halftrack[ht][i] != 0x55)
+            return false;
+    }
+    return true;
 }
 
 const char *
 Disk525::dataAbs(Halftrack ht, int start, unsigned n)
 {
     assert(isHalftrackNumber(ht));
-    assert(n < sizeof(text));
+    assert(n <= 8 * sizeof(data->halftrack[ht]));
+    requestHalftrack(ht);
+    
+    if (text == NULL)
+        text = new char[8 * sizeof(data->halftrack[ht]) + 1];
     
     // We also accept negative values for 'start'
     start = (start + length.halftrack[ht]) % length.halftrack[ht];
@@ -165,6 +399,22 @@ Disk525::dataAbs(Halftrack ht, int start, unsigned n)
 //                               Data encoding and decoding
 // ---------------------------------------------------------------------------------------------
 
+/*! @brief    Writes up to 64 bits into a zero-initialized buffer
+ *  @details  The bits are left-aligned. All bits beyond count must be 0.
+ */
+static inline void
+orBits(uint8_t *dest, unsigned offset, uint64_t bits, unsigned count)
+{
+    uint8_t *ptr = dest + offset / 8;
+    unsigned shift = offset % 8;
+    unsigned bytes = (shift + count + 7) / 8;
+    
+    for (unsigned i = 0; i < bytes && i < 8; i++)
+        ptr[i] |= (uint8_t)((bits >> shift) >> (56 - 8 * i));
+    if (bytes > 8)
+        ptr[8] |= (uint8_t)(bits << (8 - shift));
+}
+
 void
 Disk525::encodeArchive(G64Archive *a)
 {
@@ -173,6 +423,7 @@ Disk525::encodeArchive(G64Archive *a)
     assert(a != NULL);
 
     clearDisk();
+    unshareBlob(&blob);
     for (Halftrack ht = 1; ht <= 84; ht++) {
         
         unsigned item = ht - 1;
@@ -193,10 +444,13 @@ Disk525::encodeArchive(G64Archive *a)
             int b = a->getByte();
             // printf(" %02X", b);
             assert(b != -1);
-            data.halftrack[ht][i] = (uint8_t)b;
+            data->halftrack[ht][i] = (uint8_t)b;
         }
         assert(a->getByte() == -1); /* check for EOF */
     }
+    
+    // Tracks beyond track 35 only count if they contain sectors
+    for (numTracks = 42; numTracks > 35 && decodeTrack(numTracks, NULL) == 0; numTracks--);
 }
 
 void
@@ -207,6 +461,7 @@ Disk525::encodeArchive(NIBArchive *a)
     assert(a != NULL);
     
     clearDisk();
+    unshareBlob(&blob);
     for (Halftrack ht = 1; ht <= 84; ht++) {
         
         size_t size = a->getSizeOfItem(ht - 1);
@@ -226,69 +481,323 @@ Disk525::encodeArchive(NIBArchive *a)
         for (unsigned i = 0; i < bytesTotal; i++) {
             int b = a->getByte();
             assert(b != -1);
-            data.halftrack[ht][i] = (uint8_t)b;
+            data->halftrack[ht][i] = (uint8_t)b;
         }
     }
+    
+    // Tracks beyond track 35 only count if they contain sectors
+    for (numTracks = 42; numTracks > 35 && decodeTrack(numTracks, NULL) == 0; numTracks--);
 }
 
 void
 Disk525::encodeArchive(D64Archive *a)
 {
-    // Interleave patterns (no interleave)
-    /*
-    int zone1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, -1 };
-    int track18[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, -1 };
-    int zone2[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, -1 };
-    int zone3[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, -1 };
-    int zone4[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, -1 };
-    */
-    
-    // Interleave patterns (minics real VC1541 sector layout)
-    int zone1[] = { 0, 10, 20, 9, 19, 8, 18, 7, 17, 6, 16, 5, 15, 4, 14, 3, 13, 2, 12, 1, 11, -1 };
-    int track18[] = { 0, 3, 6, 9, 12, 15, 18, 2, 5, 8, 11, 14, 17, 1, 4, 7, 10, 13, 16, -1 };
-    int zone2[] = { 0, 10, 1, 11, 2, 12, 3, 13, 4, 14, 5, 15, 6, 16, 7, 17, 8, 18, 9, -1 };
-    int zone3[] = { 0, 10, 2, 12, 4, 14, 6, 16, 8, 1, 11, 3, 13, 5, 15, 7, 17, 9, -1 };
-    int zone4[] = { 0, 10, 3, 13, 6, 16, 9, 2, 12, 5, 15, 8, 1, 11, 4, 14, 7, -1 };
-
     unsigned track, encodedBits;
     
     assert(a != NULL);
     
     clearDisk();
+    unshareBlob(&blob);
     numTracks = a->numberOfTracks();
     
     debug(2, "Encoding D64 archive with %d tracks\n", numTracks);
     
-    // Zone 1: Tracks 1 - 17 (21 sectors, tailgap 9/9 (even/odd sectors))
-    for (track = 1; track <= 17; track++) {
-        (void)encodeTrack(a, track, zone1, 9, 9);
+    // The last track is encoded right away. Its length is inherited by all remaining tracks.
+    encodedBits = encodeTrack(a, numTracks);
+    
+    // Clear remaining tracks (if any)
+    for (track = numTracks + 1; track <= 42; track++) {
+        length.track[track][0] = encodedBits;  // Track t
+        length.track[track][1] = encodedBits;  // Half track above
     }
     
-    // Zone 2: Tracks 18 - 24 (19 sectors, tailgap 9/19 (even/odd sectors))
-    (void)encodeTrack(a, track, track18, 9, 19); // Directory track
-    for (track = 19; track <= 24; track++) {
-        (void)encodeTrack(a, track, zone2, 9, 19);
+    // All other tracks are encoded lazily from a private copy of the archive. Snapshots
+    // taken in the meantime find the archive in the blob store.
+    size_t size = a->writeToBuffer(NULL);
+    uint8_t *buffer = new uint8_t[size];
+    a->writeToBuffer(buffer);
+    D64Archive *archive = D64Archive::makeD64ArchiveWithBuffer(buffer, size);
+    sourceBlob = archive ? BlobStore::insert(buffer, size) : 0;
+    delete[] buffer;
+    
+    if (sourceBlob == 0) {
+        delete archive;
+        for (track = 1; track < numTracks; track++)
+            (void)encodeTrack(a, track);
+        return;
     }
     
-    // Zone 3: Tracks 25 - 30 (18 sectors, tailgap 9/13 (even/odd sectors))
-    for (track = 25; track <= 30; track++) {
-        (void)encodeTrack(a, track, zone3, 9, 13);
+    startEncoding(archive, (1ULL << numTracks) - 2);
+}
+
+void
+Disk525::startEncoding(D64Archive *archive, uint64_t tracks)
+{
+    assert(archive != NULL);
+    assert(!isEncoding());
+    
+    pthread_mutex_lock(&encodeLock);
+    memset(trackState, TRACK_ENCODED, sizeof(trackState));
+    numPendingTracks = 0;
+    for (Track t = 1; t <= 42; t++) {
+        if (tracks & (1ULL << t)) {
+            trackState[t] = TRACK_PENDING;
+            numPendingTracks++;
+        }
     }
+    pendingTracks = tracks;
+    preferredTrack = 18;
+    quitEncoder = false;
+    encoderPaused = false;
+    __atomic_store_n(&source, archive, __ATOMIC_RELEASE);
+    encoderStarted = pthread_create(&encoder, NULL, encoderMain, (void *)this) == 0;
+    pthread_mutex_unlock(&encodeLock);
+}
+
+void
+Disk525::waitForTrack(Track t)
+{
+    assert(isTrackNumber(t));
     
-    // Zone 4: Tracks 31 - 35..42 (17 sectors, tailgap 9/10 (even/odd sectors))
-    for (track = 31; track <= a->numberOfTracks(); track++) {
-        encodedBits = encodeTrack(a, track, zone4, 9, 10);
+    pthread_mutex_lock(&encodeLock);
+    
+    // Encoding might have been stopped in the meantime
+    if (source == NULL || quitEncoder) {
+        pthread_mutex_unlock(&encodeLock);
+        return;
     }
     
-    // Clear remaining tracks (if any)
-    for (track = numTracks + 1; track <= 42; track++) {
-        length.track[track][0] = encodedBits;  // Track t
-        length.track[track][1] = encodedBits;  // Half track above
+    preferredTrack = t;
+    
+    if (trackState[t] == TRACK_PENDING) {
+        
+        debug(3, "Encoding track %d on demand\n", t);
+        trackState[t] = TRACK_ENCODING;
+        pthread_mutex_unlock(&encodeLock);
+        (void)encodeTrack(source, t);
+        pthread_mutex_lock(&encodeLock);
+        trackState[t] = TRACK_ENCODED;
+        numPendingTracks--;
+        pthread_cond_broadcast(&encodeCond);
+    }
+    
+    // The background thread might be encoding the track right now
+    while (trackState[t] != TRACK_ENCODED)
+        pthread_cond_wait(&encodeCond, &encodeLock);
+    
+    pthread_mutex_unlock(&encodeLock);
+}
+
+void
+Disk525::finishEncoding()
+{
+    if (!isEncoding())
+        return;
+    
+    // Lend the background thread a hand
+    pthread_mutex_lock(&encodeLock);
+    if (source != NULL) {
+        encodePendingTracks();
+        while (numPendingTracks > 0 && !quitEncoder)
+            pthread_cond_wait(&encodeCond, &encodeLock);
     }
+    bool complete = numPendingTracks == 0;
+    pthread_mutex_unlock(&encodeLock);
+    
+    // Only the thread that stops the encoder shares the data
+    if (!cancelEncoding() || !complete)
+        return;
     
     for (Halftrack ht = 1; ht <= 84; ht++) {
-        assert(length.halftrack[ht] <= sizeof(data.halftrack[ht]) * 8);
-    }    
+        assert(length.halftrack[ht] <= sizeof(data->halftrack[ht]) * 8);
+    }
+    
+    debug(2, "D64 archive encoded\n");
+    shareData();
+}
+
+void
+Disk525::checkEncoding()
+{
+    if (!isEncoding())
+        return;
+    
+    // Without a background thread, the tracks are only encoded on demand
+    pthread_mutex_lock(&encodeLock);
+    bool complete = numPendingTracks == 0 || !encoderStarted;
+    pthread_mutex_unlock(&encodeLock);
+    
+    if (complete)
+        finishEncoding();
+}
+
+bool
+Disk525::lockEncoder()
+{
+    uint64_t pending = 0;
+    bool locked = isEncoding();
+    
+    if (locked) {
+        
+        pthread_mutex_lock(&encodeLock);
+        encoderPaused = true;
+        for (Track t = 1; t <= 42; t++) {
+            while (trackState[t] == TRACK_ENCODING)
+                pthread_cond_wait(&encodeCond, &encodeLock);
+            if (source != NULL && trackState[t] == TRACK_PENDING)
+                pending |= 1ULL << t;
+        }
+    }
+    
+    // Tracks encoded in the meantime have been written by the background thread
+    for (Track t = 1; t <= 42; t++) {
+        if ((pendingTracks & ~pending) & (1ULL << t))
+            dirty[2 * t] = dirty[2 * t + 1] = 1;
+    }
+    pendingTracks = pending;
+    
+    return locked;
+}
+
+void
+Disk525::unlockEncoder(bool locked)
+{
+    if (!locked)
+        return;
+    
+    encoderPaused = false;
+    pthread_cond_broadcast(&encodeCond);
+    pthread_mutex_unlock(&encodeLock);
+}
+
+bool
+Disk525::cancelEncoding()
+{
+    if (!isEncoding())
+        return false;
+    
+    pthread_mutex_lock(&encodeLock);
+    
+    // Wait if another thread is stopping the encoder
+    if (source == NULL || quitEncoder) {
+        while (source != NULL)
+            pthread_cond_wait(&encodeCond, &encodeLock);
+        pthread_mutex_unlock(&encodeLock);
+        return false;
+    }
+    quitEncoder = true;
+    pthread_cond_broadcast(&encodeCond);
+    
+    // Wait for all tracks that are being encoded on demand
+    for (Track t = 1; t <= 42; t++) {
+        while (trackState[t] == TRACK_ENCODING)
+            pthread_cond_wait(&encodeCond, &encodeLock);
+    }
+    bool started = encoderStarted;
+    encoderStarted = false;
+    pthread_mutex_unlock(&encodeLock);
+    
+    if (started)
+        pthread_join(encoder, NULL);
+    
+    pthread_mutex_lock(&encodeLock);
+    D64Archive *archive = source;
+    __atomic_store_n(&source, (D64Archive *)NULL, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&encodeCond);
+    pthread_mutex_unlock(&encodeLock);
+    
+    delete archive;
+    
+    // From now on, snapshots don't refer to the archive anymore
+    BlobStore::release(sourceBlob);
+    sourceBlob = 0;
+    return true;
+}
+
+void *
+Disk525::encoderMain(void *disk)
+{
+    Disk525 *d = (Disk525 *)disk;
+    
+    pthread_mutex_lock(&d->encodeLock);
+    d->encodePendingTracks();
+    pthread_mutex_unlock(&d->encodeLock);
+    return NULL;
+}
+
+void
+Disk525::encodePendingTracks()
+{
+    Track t;
+    
+    while (!quitEncoder) {
+        
+        // Snapshots are taken while the encoder is paused
+        if (encoderPaused) {
+            pthread_cond_wait(&encodeCond, &encodeLock);
+            continue;
+        }
+        if ((t = nextPendingTrack()) == 0)
+            break;
+        
+        trackState[t] = TRACK_ENCODING;
+        pthread_mutex_unlock(&encodeLock);
+        (void)encodeTrack(source, t);
+        pthread_mutex_lock(&encodeLock);
+        trackState[t] = TRACK_ENCODED;
+        numPendingTracks--;
+        pthread_cond_broadcast(&encodeCond);
+    }
+}
+
+Track
+Disk525::nextPendingTrack()
+{
+    for (unsigned d = 0; d < 42; d++) {
+        
+        if (preferredTrack + d <= 42 && trackState[preferredTrack + d] == TRACK_PENDING)
+            return preferredTrack + d;
+        if (preferredTrack > d && trackState[preferredTrack - d] == TRACK_PENDING)
+            return preferredTrack - d;
+    }
+    return 0;
+}
+
+unsigned
+Disk525::encodeTrack(D64Archive *a, Track t)
+{
+    // Interleave patterns (no interleave)
+    /*
+    static int zone1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, -1 };
+    static int track18[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, -1 };
+    static int zone2[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, -1 };
+    static int zone3[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, -1 };
+    static int zone4[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, -1 };
+    */
+    
+    // Interleave patterns (minics real VC1541 sector layout)
+    static int zone1[] = { 0, 10, 20, 9, 19, 8, 18, 7, 17, 6, 16, 5, 15, 4, 14, 3, 13, 2, 12, 1, 11, -1 };
+    static int track18[] = { 0, 3, 6, 9, 12, 15, 18, 2, 5, 8, 11, 14, 17, 1, 4, 7, 10, 13, 16, -1 };
+    static int zone2[] = { 0, 10, 1, 11, 2, 12, 3, 13, 4, 14, 5, 15, 6, 16, 7, 17, 8, 18, 9, -1 };
+    static int zone3[] = { 0, 10, 2, 12, 4, 14, 6, 16, 8, 1, 11, 3, 13, 5, 15, 7, 17, 9, -1 };
+    static int zone4[] = { 0, 10, 3, 13, 6, 16, 9, 2, 12, 5, 15, 8, 1, 11, 4, 14, 7, -1 };
+    
+    // Zone 1: Tracks 1 - 17 (21 sectors, tailgap 9/9 (even/odd sectors))
+    if (t <= 17)
+        return encodeTrack(a, t, zone1, 9, 9);
+    
+    // Zone 2: Tracks 18 - 24 (19 sectors, tailgap 9/19 (even/odd sectors))
+    if (t == 18)
+        return encodeTrack(a, t, track18, 9, 19); // Directory track
+    if (t <= 24)
+        return encodeTrack(a, t, zone2, 9, 19);
+    
+    // Zone 3: Tracks 25 - 30 (18 sectors, tailgap 9/13 (even/odd sectors))
+    if (t <= 30)
+        return encodeTrack(a, t, zone3, 9, 13);
+    
+    // Zone 4: Tracks 31 - 35..42 (17 sectors, tailgap 9/10 (even/odd sectors))
+    return encodeTrack(a, t, zone4, 9, 10);
 }
 
 unsigned
@@ -303,7 +812,7 @@ Disk525::encodeTrack(D64Archive *a, Track t, int *sectorList, uint8_t tailGapEve
     // Scan the interleave pattern and encode each sector
     for (unsigned i = 0; sectorList[i] != -1; i++) {
         
-        encodedBits = encodeSector(a, t, sectorList[i], data.track[t], totalEncodedBits, (i % 2) ? tailGapOdd : tailGapEven);
+        encodedBits = encodeSector(a, t, sectorList[i], data->track[t], totalEncodedBits, (i % 2) ? tailGapOdd : tailGapEven);
         // assert(encodedBits % 8 == 0);
         totalEncodedBits += encodedBits;
     }
@@ -317,7 +826,7 @@ Disk525::encodeTrack(D64Archive *a, Track t, int *sectorList, uint8_t tailGapEve
 unsigned
 Disk525::encodeSector(D64Archive *a, Track t, uint8_t sector, uint8_t *dest, unsigned bitoffset, int gap)
 {
-    uint8_t *source; // , *ptr = dest;
+    const uint8_t *source;
     unsigned bitptr = bitoffset;
     
     assert(isTrackNumber(t));
@@ -325,7 +834,7 @@ Disk525::encodeSector(D64Archive *a, Track t, uint8_t sector, uint8_t *dest, uns
     assert(dest != NULL);
     
     // Get source address from archive
-    if ((source = a->findSector(t, sector)) == 0) {
+    if ((source = a->readSector(t, sector)) == NULL) {
         warn("Can't find halftrack data in archive\n");
         return 0;
     }
@@ -441,95 +950,158 @@ Disk525::encodeGcr(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint8_t *dest
 
 unsigned
 Disk525::decodeDisk(uint8_t *dest, int *error)
+{
+    unsigned numBytes = 0;
+    
+    if (error) *error = 0; // We assume the best
+    
+    finishEncoding();
+    
+    // For each full track ...
+    for (Track t = 1; t <= numTracks; t++) {
+        numBytes += decodeTrack(t, dest ? dest + numBytes : NULL, error);
+    }
+    return numBytes;
+}
+
+unsigned
+Disk525::decodeTrack(Track t, uint8_t *dest, int *error)
 {
     uint8_t tmpbuf1[2 * 7928], tmpbuf2[2 * 7928];
     unsigned tmpbuf1length, tmpbuf2length;
-    unsigned r, w, copies, noOfOneBits, bitsOnTrack = 0, numBytes = 0;
+    unsigned r, w, count, noOfOneBits, bitsOnTrack = 0;
     int startOfFirstSyncMark = -1;
     
+    assert(isTrackNumber(t));
+    
     memset(tmpbuf1, 0, sizeof(tmpbuf1));
     memset(tmpbuf2, 0, sizeof(tmpbuf2));
     
-    if (error) *error = 0; // We assume the best
+    bitsOnTrack = length.track[t][0];
+    startOfFirstSyncMark = 0;
     
-    // For each full track ...
-    for (Track t = 1; t <= numTracks; t++) {
+    debug(3, "Decoding track %d (%d bits) %s\n", t, bitsOnTrack, dest == NULL ? "(test run)" : "");
     
-        bitsOnTrack = length.track[t][0];
-        startOfFirstSyncMark = 0;
+    // Step 1: Search for first SYNC mark (ten 1s in a row)
+    debug(3, "    Searching for first SYNC mark\n", startOfFirstSyncMark);
+    for (r = noOfOneBits = 0; r < bitsOnTrack; r++) {
         
-        debug(3, "Decoding track %d (%d bits) %s\n", t, bitsOnTrack, dest == NULL ? "(test run)" : "");
+        // Count '1' bits
+        if (readBit(data->track[t], r)) { noOfOneBits++; } else { noOfOneBits = 0; }
         
-        // Step 1: Search for first SYNC mark (ten 1s in a row)
-        debug(3, "    Searching for first SYNC mark\n", startOfFirstSyncMark);
-        for (r = noOfOneBits = 0; r < bitsOnTrack; r++) {
-            
-            // Count '1' bits
-            if (readBit(data.track[t], r)) { noOfOneBits++; } else { noOfOneBits = 0; }
-            
-            // Check if we have found the beginning of a SYNC mark (ten 1s in a row)
-            if (noOfOneBits == 10) { startOfFirstSyncMark = r - 9; break; }
-        }
+        // Check if we have found the beginning of a SYNC mark (ten 1s in a row)
+        if (noOfOneBits == 10) { startOfFirstSyncMark = r - 9; break; }
+    }
+    
+    if (startOfFirstSyncMark < 0) {
+        warn("Disk decoding aborted. No SYNC mark found on track %d\n", t);
+        if (error) *error = 1;
+        return 0;
+    }
+    
+
+    // Step 2: Copy track data into first temporary buffer starting at the first SYNC mark
+    // Track data is repeates twice, so we can read safely beyond the array bounds later
+    debug(3, "    Setting up temporary buffer (alignment offset = %d)\n", startOfFirstSyncMark);
+    for (w = 0, r = startOfFirstSyncMark; w < 2 * bitsOnTrack; w += count, r += count) {
+        uint64_t bits;
+        count = MIN(readBitsFromHalftrack(2 * t - 1, r % bitsOnTrack, &bits), 2 * bitsOnTrack - w);
+        assert((w + count - 1) / 8 < sizeof(tmpbuf1));
+        orBits(tmpbuf1, w, bits & ~(~0ULL >> 1 >> (count - 1)), count);
+    }
+
+    tmpbuf1length = w;
+    debug(3, "    Temporary buffer contains %d bits\n", tmpbuf1length);
+    assert(tmpbuf1length == 2 * bitsOnTrack);
+
+    
+    // Step 3: Write a byte aligned copy of the first temporary buffer into the second buffer.
+    debug(3, "    Aligning SYNC marks\n");
+    uint8_t bit;
+    for (r = w = noOfOneBits = 0; r < tmpbuf1length; r++) {
         
-        if (startOfFirstSyncMark < 0) {
-            warn("Disk decoding aborted. No SYNC mark found on track %d\n", t);
-            *error = 1;
-            return 0;
+        // Copy whole bytes as long as they can't contain the start of a SYNC mark
+        while (r % 8 == 0 && r + 8 <= tmpbuf1length) {
+            uint8_t byte = tmpbuf1[r / 8];
+            unsigned leading, trailing;
+            for (leading = 0; leading < 8 && (byte & (0x80 >> leading)); leading++);
+            for (trailing = 0; trailing < 8 && (byte & (0x01 << trailing)); trailing++);
+            if (noOfOneBits + leading >= 10)
+                break;
+            orBits(tmpbuf2, w, (uint64_t)byte << 56, 8);
+            noOfOneBits = (byte == 0xFF) ? noOfOneBits + 8 : trailing;
+            r += 8;
+            w += 8;
         }
+        if (r >= tmpbuf1length)
+            break;
         
-
-        // Step 2: Copy track data into first temporary buffer starting at the first SYNC mark
-        // Track data is repeates twice, so we can read safely beyond the array bounds later
-        debug(3, "    Setting up temporary buffer (alignment offset = %d)\n", startOfFirstSyncMark);
-        for (copies = w = 0; copies < 2; copies++) {
-            for (r = startOfFirstSyncMark; r < bitsOnTrack; r++) {
-                assert((w / 8) < sizeof(tmpbuf1) - 1);
-                writeBit(tmpbuf1, w++, readBit(data.track[t], r));
-            }
-            for (r = 0; r < startOfFirstSyncMark; r++) {
-                assert((w / 8) < sizeof(tmpbuf1) - 1);
-                writeBit(tmpbuf1, w++, readBit(data.track[t], r));
-            }
+        // Count '1' bits
+        if ((bit = readBit(tmpbuf1, r))) noOfOneBits++; else noOfOneBits = 0;
+        
+        // Copy bits if we are not inside a SYNC mark
+        if (noOfOneBits < 10) { writeBit(tmpbuf2, w++, bit); }
+        
+        // Check if we have found the beginning of a SYNC mark (ten 1s in a row)
+        if (noOfOneBits == 10) {
+            
+            // Write more 1s and make sure that data is byte aligned
+            for (unsigned i = 0; i < 8 || (w % 8) != 0; i++) writeBit(tmpbuf2, w++, 1);
         }
-        assert(w % 8 == 0);
+    }
+    tmpbuf2length = w;
+    debug(3, "    Buffer contains %d bits after alignment\n", tmpbuf2length);
 
-        tmpbuf1length = w;
-        debug(3, "    Temporary buffer contains %d bits\n", tmpbuf1length);
-        assert(tmpbuf1length == 2 * bitsOnTrack);
+    // Report sync marks that are not byte aligned (there shouldn't be any)
+    if (getDebugLevel() >= 3)
+        debugSyncMarks(tmpbuf2, tmpbuf2length);
+    
+    // Step 4: Decode track data
+    return decodeTrack(tmpbuf2, dest, error);
+}
 
+bool
+Disk525::decodeModifiedTracks(D64Archive *a, int *error)
+{
+    uint8_t buffer[21 * 256];
+    int err = 0;
+    
+    assert(a != NULL);
+    
+    if (error) *error = 0; // We assume the best
+    
+    finishEncoding();
+    
+    for (Track t = 1; t <= a->numberOfTracks(); t++) {
         
-        // Step 3: Write a byte aligned copy of the first temporary buffer into the second buffer.
-        debug(3, "    Aligning SYNC marks\n");
-        uint8_t bit;
-        for (r = w = noOfOneBits = 0; r < tmpbuf1length; r++) {
-            
-            // Count '1' bits
-            if ((bit = readBit(tmpbuf1, r))) noOfOneBits++; else noOfOneBits = 0;
-            
-            // Copy bits if we are not inside a SYNC mark
-            if (noOfOneBits < 10) { writeBit(tmpbuf2, w++, bit); }
+        if (!modifiedHalftracks[2 * t - 1])
+            continue;
+        
+        unsigned expected = D64Archive::numberOfSectors(2 * t - 1) * 256;
+        uint8_t *sector = a->findSector(t, 0);
+        assert(sector != NULL);
+        
+        if (t > numTracks) {
             
-            // Check if we have found the beginning of a SYNC mark (ten 1s in a row)
-            if (noOfOneBits == 10) {
-                
-                // Write more 1s and make sure that data is byte aligned
-                for (unsigned i = 0; i < 8 || (w % 8) != 0; i++) writeBit(tmpbuf2, w++, 1);
-            }
+            // Tracks beyond the end of the disk are not decoded
+            memset(sector, 0, expected);
+            modifiedHalftracks[2 * t - 1] = 0;
+            continue;
         }
-        tmpbuf2length = w;
-        debug(3, "    Buffer contains %d bits after alignment\n", tmpbuf2length);
-
-        // Report sync marks that are not byte aligned (there shouldn't be any)
-        debugSyncMarks(tmpbuf2, tmpbuf2length);
         
-        // Step 4: Decode track data
-        if (dest)
-            numBytes += decodeTrack(tmpbuf2, dest + numBytes, error);
-        else
-            numBytes += decodeTrack(tmpbuf2, NULL, error);
+        debug(2, "Writing back track %d\n", t);
         
+        // Only store the track if it holds the regular number of sectors
+        if (decodeTrack(t, buffer, &err) != expected || err) {
+            if (error) *error = err;
+            return false;
+        }
+        
+        memcpy(sector, buffer, expected);
+        modifiedHalftracks[2 * t - 1] = 0;
     }
-    return numBytes;
+    
+    return true;
 }
 
 unsigned
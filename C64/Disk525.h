@@ -77,6 +77,21 @@ const unsigned MAX_FILES_ON_DISK = 144;
 //                                               Disk525
 // -----------------------------------------------------------------------------------------------
 
+/*! @brief    Disk data
+ *  @details  Each tracks can store a maximum of 7928 bytes. The number varies depends on the track number
+ *            (inner tracks contain fewer bytes) and the actual write speed of a drive.
+ *            The first valid track and halftrack number is 1. Hence, the entries [0][x] are unused.
+ *            halftack[i] points to the first byte of halftrack i,
+ *            track[i] points to the first byte of track i
+ */
+typedef union {
+    struct {
+        uint8_t _pad[7928];
+        uint8_t halftrack[85][7928];
+    };
+    uint8_t track[43][2 * 7928];
+} DiskData;
+
 /*! @brief    A virtual 5,25" floppy disk
  */
 class Disk525 : public VirtualComponent {
@@ -89,6 +104,21 @@ public:
     //! @brief    Dump debug information
     void dumpState();
     
+    //! @brief    Loads the current state from a buffer
+    void loadFromBuffer(uint8_t **buffer);
+    
+    //! @brief    Saves the current state into a buffer
+    void saveToBuffer(uint8_t **buffer);
+    
+    //! @brief    Updates a previously saved state in a buffer
+    void saveDirtyToBuffer(uint8_t **buffer);
+    
+    //! @brief    Collects the hashes of all blobs referenced by the internal state
+    unsigned collectBlobs(uint64_t *hashes, unsigned max);
+    
+    //! @brief    Computes a hash over the internal state
+    uint64_t stateHash();
+    
     
 private:
     
@@ -115,19 +145,12 @@ private:
 public:
     
     /*! @brief    Disk data
-     *  @details  Each tracks can store a maximum of 7928 bytes. The number varies depends on the track number
-     *            (inner tracks contain fewer bytes) and the actual write speed of a drive.
-     *            The first valid track and halftrack number is 1. Hence, the entries [0][x] are unused.
-     *            data.halftack[i] points to the first byte of halftrack i,
-     *            data.track[i] points to the first byte of track i
+     *  @details  The storage is a private copy-on-write mapping of a shared blank disk. Hence,
+     *            physical memory is only allocated for the pages of the halftracks that have
+     *            been written. Unused drives and the unused halftracks of a disk cost nothing.
+     *  @see      allocateData
      */
-    union {
-        struct {
-            uint8_t _pad[7928];
-            uint8_t halftrack[85][7928];
-        };
-        uint8_t track[43][2 * 7928];
-    } data;
+    DiskData *data;
     
     /*! @brief    Length of each halftrack in bits
      *  @details  length.halftack[i] is length of halftrack i,
@@ -143,9 +166,10 @@ public:
     } length;
 
     /*! @brief    Textual representation of track data
-     *! @details  Used for pretty printing, only
+     *! @details  Used for pretty printing, only. The buffer is allocated on first use.
+     *  @see      dataAbs
      */
-    char text[(7928 * 8) + 1];
+    char *text;
         
     /*! @brief       Total number of tracks on this disk
      *  @deprecated  Add method bool emptyTrack(Track nr) as a replacement
@@ -168,6 +192,95 @@ private:
      */
     bool modified;
 
+    /*! @brief   Dirty flags of the halftracks
+     *  @details The flag of a halftrack is set whenever the halftrack is written. Entry ht + 1
+     *           belongs to halftrack ht, because the disk data starts with a padding area.
+     *  @see     VirtualComponent::saveDirtyToBuffer
+     */
+    uint8_t dirty[86];
+    
+    /*! @brief   Write-back flags of the halftracks
+     *  @details The flag of a halftrack is set whenever the halftrack is written and cleared
+     *           when the halftrack has been decoded by decodeModifiedTracks(). In contrast to
+     *           the dirty flags, these flags are not touched when a snapshot is taken.
+     */
+    uint8_t modifiedHalftracks[85];
+    
+    /*! @brief   Blob store hash of the disk data
+     *  @details As long as the inserted disk is unmodified, snapshots only contain this hash.
+     *           Empty drives refer to the blank disk, which is shared by all drives.
+     */
+    uint64_t blob;
+    
+    
+    // --------------------------------------------------------------------------------------------
+    //                                     Lazy track encoding
+    // --------------------------------------------------------------------------------------------
+    
+    /*! @brief   Encoding state of a single track
+     *  @see     trackState
+     */
+    enum {
+        TRACK_ENCODED  = 0, //! Track data is valid
+        TRACK_PENDING  = 1, //! Track has not been encoded yet
+        TRACK_ENCODING = 2  //! Track is being encoded right now
+    };
+    
+    /*! @brief   D64 archive that is currently being encoded
+     *  @details encodeArchive(D64Archive *) only encodes the tracks the drive head is
+     *           placed on. All other tracks are encoded by a background thread, starting
+     *           with the tracks next to the drive head. The archive is a private copy that
+     *           is deleted once all tracks have been encoded. NULL, if no tracks are pending.
+     *  @note    Pending tracks are encoded on demand, but everything else expects the disk
+     *           to be complete. Thus, all functions accessing the whole disk call
+     *           finishEncoding() first. Snapshots are an exception. They contain the tracks
+     *           encoded so far and restart the encoder for the pending ones when loaded.
+     *           The pointer is read without holding encodeLock (see isEncoding()), but it is
+     *           only changed and deleted with the lock held.
+     */
+    D64Archive *source;
+    
+    /*! @brief   Blob store hash of the D64 archive that is being encoded
+     *  @details Snapshots refer to the archive to encode the pending tracks after loading.
+     *           The disk holds a reference as long as it is encoding. 0, if it is not.
+     */
+    uint64_t sourceBlob;
+    
+    /*! @brief   Tracks that were pending when the state was saved the last time
+     *  @details Bit t is set if track t is still pending. Updated by lockEncoder().
+     */
+    uint64_t pendingTracks;
+    
+    //! @brief   Encoding state of each track (protected by encodeLock)
+    uint8_t trackState[43];
+    
+    //! @brief   Number of tracks that are pending or being encoded (protected by encodeLock)
+    unsigned numPendingTracks;
+    
+    /*! @brief   Track next to the drive head (protected by encodeLock)
+     *  @details The background thread encodes the pending tracks closest to this one first.
+     */
+    Track preferredTrack;
+    
+    /*! @brief   Asks the background thread to terminate (protected by encodeLock)
+     *  @details The thread setting this flag owns the teardown of the encoding state.
+     */
+    bool quitEncoder;
+    
+    //! @brief   Keeps the background thread from starting new tracks (protected by encodeLock)
+    bool encoderPaused;
+    
+    //! @brief   Background thread encoding the pending tracks
+    pthread_t encoder;
+    
+    //! @brief   Indicates whether the background thread has been started
+    bool encoderStarted;
+    
+    //! @brief   Protects the encoding state
+    pthread_mutex_t encodeLock;
+    
+    //! @brief   Signals encoded tracks
+    pthread_cond_t encodeCond;
     
 public:
     
@@ -209,7 +322,7 @@ public:
      */
     inline uint8_t readBitFromHalftrack(Halftrack ht, unsigned offset) {
         assert(isHalftrackNumber(ht));
-        return readBit(data.halftrack[ht], offset % length.halftrack[ht]);
+        return readBit(data->halftrack[ht], offset % length.halftrack[ht]);
     }
 
     /*! @brief   Reads a single byte from disk
@@ -236,6 +349,22 @@ public:
         return result;
     }
 
+    /*! @brief   Reads up to 64 consecutive bits from disk
+     *  @details Reading stops at the end of the halftrack. Hence, the caller has to deal
+     *           with the wrap-around only once per call.
+     *  @param   ht      Number of halftrack to read from
+     *  @param   offset  Position of first bit to read (first bit has offset 0)
+     *  @param   bits    Read bits, left-aligned (the first bit ends up in bit 63)
+     *  @result  Number of read bits
+     */
+    unsigned readBitsFromHalftrack(Halftrack ht, unsigned offset, uint64_t *bits);
+
+    /*! @brief   Checks if a halftrack holds any data
+     *  @details A halftrack is empty if it only contains gap bytes ($55), e.g., if nothing
+     *           has ever been written to it.
+     */
+    bool isEmptyHalftrack(Halftrack ht);
+
     
     //
     //! @functiongroup Writing data to disk
@@ -267,7 +396,9 @@ public:
      *  @param  bit    0 for a '0' bit, every other value for a '1' bit
      */
     inline void writeBitToHalftrack(Halftrack ht, unsigned offset, uint8_t bit) {
-        assert(isHalftrackNumber(ht)); writeBit(data.halftrack[ht], offset % length.halftrack[ht], bit); }
+        assert(isHalftrackNumber(ht)); if (blob) unshareBlob(&blob);
+        writeBit(data->halftrack[ht], offset % length.halftrack[ht], bit);
+        dirty[ht + 1] = 1; modifiedHalftracks[ht] = 1; }
  
     /*! @brief  Writes a single byte to disk
      *  @param  data   Pointer to the first data byte of a track
@@ -300,6 +431,29 @@ public:
     /*! @brief Zeros out a single halftrack
      */
     void clearHalftrack(Halftrack ht);
+    
+private:
+    
+    /*! @brief   Replaces the disk data by a blank disk
+     *  @details Maps a private copy of the blank disk into memory. The pages of the mapping
+     *           are only backed by physical memory once they are written. Existing data is
+     *           replaced in place, i.e., the data pointer doesn't change.
+     *  @return  false, if memory mapping is unavailable. In that case, the disk data has
+     *           been allocated on the heap and needs to be cleared by the caller.
+     */
+    bool mapBlankDisk();
+    
+    //! @brief   Indicates whether the disk data is a memory mapping
+    bool mapped;
+    
+public:
+    
+    /*! @brief Puts the disk data into the blob store
+     *  @details Call this function after a disk has been encoded. The data stays shared
+     *           until the first bit is written. If some tracks are still pending, the data
+     *           is shared when the last track has been encoded (see checkEncoding()).
+     */
+    void shareData() { if (!isEncoding()) shareBlob(&blob, data->track[0], sizeof(data->track)); }
 
     //
     //! @functiongroup Debugging disk data
@@ -340,12 +494,77 @@ public:
     void encodeArchive(NIBArchive *a);
 
     /*! @brief   Converts a D64 archive into a virtual floppy disk
-     *  @details The method creates sync marks, GRC encoded header and data blocks, checksums and gaps
+     *  @details The method creates sync marks, GRC encoded header and data blocks, checksums and gaps.
+     *           To keep disk insertion fast, the tracks are encoded lazily. The method returns
+     *           after the last track has been encoded. All other tracks are encoded on demand
+     *           or in the background.
+     *  @see     requestHalftrack
      */
     void encodeArchive(D64Archive *a);
 
+    /*! @brief   Makes sure that a halftrack has been encoded
+     *  @details Call this function whenever the drive head moves. If the halftrack is still
+     *           pending, it is encoded right away. Furthermore, the background thread
+     *           continues with the tracks next to it.
+     */
+    inline void requestHalftrack(Halftrack ht) { if (isEncoding()) waitForTrack((ht + 1) / 2); }
+    
+    //! @brief   Returns true if some tracks are still encoded lazily
+    inline bool isEncoding() { return __atomic_load_n(&source, __ATOMIC_ACQUIRE) != NULL; }
+    
+    //! @brief   Encodes all pending tracks and waits until the disk is complete
+    void finishEncoding();
+    
+    /*! @brief   Completes the disk once the background thread has encoded all tracks
+     *  @details Shares the disk data like finishEncoding(), but never waits for pending
+     *           tracks. Because the snapshot layout changes, this function must not be
+     *           called while a snapshot is taken.
+     */
+    void checkEncoding();
+    
 private:
     
+    /*! @brief   Starts the background thread
+     *  @param   archive  Private archive the tracks are encoded from. The disk takes ownership.
+     *  @param   tracks   Bit t is set if track t is pending
+     */
+    void startEncoding(D64Archive *archive, uint64_t tracks);
+    
+    /*! @brief   Stops the background thread from writing to the disk data
+     *  @details Waits until the track the thread is working on has been encoded and
+     *           determines the pending tracks. Tracks that have been encoded since the
+     *           last call are marked dirty.
+     *  @return  true, if encodeLock has been acquired and unlockEncoder() must be called.
+     */
+    bool lockEncoder();
+    
+    //! @brief   Lets the background thread continue
+    void unlockEncoder(bool locked);
+    
+    //! @brief   Implementation of requestHalftrack()
+    void waitForTrack(Track t);
+    
+    /*! @brief   Stops lazy encoding and discards all pending tracks
+     *  @details Can be called from multiple threads. If another thread is already
+     *           stopping the encoder, the function waits until it has finished.
+     *  @return  true, if this call has stopped the encoder.
+     */
+    bool cancelEncoding();
+    
+    //! @brief   Entry point of the background thread
+    static void *encoderMain(void *disk);
+    
+    /*! @brief   Encodes pending tracks until none is left or the encoder is asked to quit
+     *  @details Called by the background thread and by finishEncoding(). The lock must be held.
+     */
+    void encodePendingTracks();
+    
+    //! @brief   Returns the pending track closest to the preferred track (0 if there is none)
+    Track nextPendingTrack();
+    
+    //! @brief   Encodes a single track of a D64 archive with the proper interleave and gaps
+    unsigned encodeTrack(D64Archive *a, Track t);
+    
     /*! @brief   Encode a single track
      *  @details This function translates the logical byte sequence of a single track into the native VC1541
      *           byte representation. The native representation includes sync marks, GCR data etc.
@@ -393,8 +612,26 @@ public:
      */
     unsigned decodeDisk(uint8_t *dest, int *error = NULL);
     
+    /*! @brief   Writes back all tracks that have been modified since the previous call
+     *  @details The tracks are decoded into the D64 archive which is expected to hold the
+     *           contents of the disk as it was when this function was called before. Only tracks
+     *           that have been written since then are decoded. After a new disk has been
+     *           inserted or a snapshot has been loaded, all tracks are decoded.
+     *  @result  false, if a track could not be decoded or does not contain the regular
+     *           number of sectors. In that case, the disk has to be decoded as a whole.
+     */
+    bool decodeModifiedTracks(D64Archive *a, int *error = NULL);
+    
+    //! @brief   Marks all halftracks as modified
+    void setModifiedHalftracks() { memset(modifiedHalftracks, 1, sizeof(modifiedHalftracks)); }
+    
 private:
     
+    /*! @brief   Decodes all sectors of a single full track
+     *  @result  Number of bytes written into dest (if dest is NULL, a test run is performed)
+     */
+    unsigned decodeTrack(Track t, uint8_t *dest, int *error = NULL);
+    
     /*! @brief   Decodes all sectors of a single GCR encoded track
      */
     unsigned decodeTrack(uint8_t *source, uint8_t *dest, int *error = NULL);
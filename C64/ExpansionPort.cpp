@@ -106,6 +106,27 @@ ExpansionPort::saveToBuffer(uint8_t **buffer)
     assert(*buffer - old == stateSize());
 }
 
+uint64_t
+ExpansionPort::stateHash()
+{
+    uint8_t state[4] = { 0, 0, exromLine, gameLine };
+    uint64_t result;
+    
+    if (cartridge != NULL) {
+        state[0] = (uint8_t)(cartridge->getCartridgeType() >> 8);
+        state[1] = (uint8_t)cartridge->getCartridgeType();
+    }
+    result = hashBlock(state, sizeof(state), 0);
+    
+    // Hash cartridge data (if any)
+    if (cartridge != NULL) {
+        uint64_t hash = cartridge->stateHash();
+        result = hashBlock(&hash, sizeof(hash), result);
+    }
+    
+    return result;
+}
+
 void
 ExpansionPort::dumpState()
 {
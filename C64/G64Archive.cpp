@@ -17,6 +17,7 @@
  */
 
 #include "G64Archive.h"
+#include "Disk525.h"
 
 const uint8_t /* "GCR-1541" */
 G64Archive::magicBytes[] = { 0x47, 0x43, 0x52, 0x2D, 0x31, 0x35, 0x34, 0x31, 0x00 };
@@ -54,6 +55,59 @@ G64Archive::makeG64ArchiveWithFile(const char *filename)
     return archive;
 }
 
+G64Archive *
+G64Archive::makeG64ArchiveWithDisk(Disk525 *disk)
+{
+    assert(disk != NULL);
+    
+    // Determine file size
+    size_t length = 0x2AC;
+    for (Halftrack ht = 1; ht <= 84; ht++) {
+        if (!disk->isEmptyHalftrack(ht))
+            length += 2 + maxTrackSize;
+    }
+    
+    uint8_t *buffer = (uint8_t *)calloc(length, 1);
+    if (buffer == NULL)
+        return NULL;
+    
+    // Write header (signature, version, number of halftracks, maximum track size)
+    memcpy(buffer, magicBytes, 8);
+    buffer[0x09] = 84;
+    buffer[0x0A] = LO_BYTE(maxTrackSize);
+    buffer[0x0B] = HI_BYTE(maxTrackSize);
+    
+    // Write tracks
+    uint32_t offset = 0x2AC;
+    for (Halftrack ht = 1; ht <= 84; ht++) {
+        
+        unsigned item = ht - 1;
+        Track t = (ht + 1) / 2;
+        uint32_t zone = t < 18 ? 3 : t < 25 ? 2 : t < 31 ? 1 : 0;
+        
+        for (unsigned i = 0; i < 4; i++)
+            buffer[0x15C + 4 * item + i] = (uint8_t)(zone >> (8 * i));
+        
+        if (disk->isEmptyHalftrack(ht))
+            continue;
+        
+        uint16_t size = (disk->length.halftrack[ht] + 7) / 8;
+        for (unsigned i = 0; i < 4; i++)
+            buffer[0x00C + 4 * item + i] = (uint8_t)(offset >> (8 * i));
+        buffer[offset] = LO_BYTE(size);
+        buffer[offset + 1] = HI_BYTE(size);
+        memcpy(buffer + offset + 2, disk->data->halftrack[ht], size);
+        offset += 2 + maxTrackSize;
+    }
+    assert(offset == length);
+    
+    G64Archive *archive = new G64Archive();
+    archive->data = buffer;
+    archive->size = length;
+    
+    return archive;
+}
+
 G64Archive::~G64Archive()
 {
 	dealloc();
@@ -101,7 +155,7 @@ G64Archive::archiveFromG64File(const char *filename)
 
 void G64Archive::dealloc()
 {
-	if (data) free(data);
+	releaseBuffer(data);
 	data = NULL;
 	size = 0;
 	fp = -1;
@@ -117,10 +171,9 @@ G64Archive::hasSameType(const char *filename)
 bool 
 G64Archive::readFromBuffer(const uint8_t *buffer, size_t length)
 {	
-	if ((data = (uint8_t *)malloc(length)) == NULL)
+	if ((data = adoptBuffer(buffer, length)) == NULL)
 		return false;
 
-	memcpy(data, buffer, length);
 	size = length;
 
 	return true;
@@ -21,6 +21,9 @@
 
 #include "Archive.h"
 
+// Forward declarations
+class Disk525;
+
 /*! @class    G64Archive
  *  @brief    The G64Archive class declares the programmatic interface for a file in G64 format.
  */
@@ -31,6 +34,9 @@ private:
     //! @brief    Header signature
     static const uint8_t magicBytes[];
     
+    //! @brief    Maximum number of bytes stored per halftrack
+    static const uint16_t maxTrackSize = 7928;
+    
     //! @brief    The raw data of this archive.
     uint8_t *data;
 
@@ -61,6 +67,12 @@ public:
     
     //! @brief    Factory method
     static G64Archive *makeG64ArchiveWithFile(const char *path);
+    
+    /*! @brief    Factory method
+     *  @details  Stores all halftracks of a virtual floppy disk. Empty halftracks are
+     *            omitted. Track lengths are rounded up to full bytes.
+     */
+    static G64Archive *makeG64ArchiveWithDisk(Disk525 *disk);
 
     //! @brief    Standard destructor
     ~G64Archive();
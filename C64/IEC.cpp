@@ -17,6 +17,7 @@
  */
 
 #include "C64.h"
+#include <dirent.h>
 
 IEC::IEC()
 {
@@ -26,19 +27,19 @@ IEC::IEC()
     // Register snapshot items
     SnapshotItem items[] = {
         
-        { &driveConnected,      sizeof(driveConnected),         CLEAR_ON_RESET },
+        { driveConnected,       sizeof(driveConnected),         KEEP_ON_RESET },
         { &atnLine,             sizeof(atnLine),                CLEAR_ON_RESET },
         { &oldAtnLine,          sizeof(oldAtnLine),             CLEAR_ON_RESET },
         { &clockLine,           sizeof(clockLine),              CLEAR_ON_RESET },
         { &oldClockLine,        sizeof(oldClockLine),           CLEAR_ON_RESET },
         { &dataLine,            sizeof(dataLine),               CLEAR_ON_RESET },
         { &oldDataLine,         sizeof(oldDataLine),            CLEAR_ON_RESET },
-        { &deviceAtnPin,        sizeof(deviceAtnPin),           CLEAR_ON_RESET },
-        { &deviceAtnIsOutput,   sizeof(deviceAtnIsOutput),      CLEAR_ON_RESET },
-        { &deviceDataPin,       sizeof(deviceDataPin),          CLEAR_ON_RESET },
-        { &deviceDataIsOutput,  sizeof(deviceDataIsOutput),     CLEAR_ON_RESET },
-        { &deviceClockPin,      sizeof(deviceClockPin),         CLEAR_ON_RESET },
-        { &deviceClockIsOutput, sizeof(deviceClockIsOutput),    CLEAR_ON_RESET },
+        { deviceAtnPin,         sizeof(deviceAtnPin),           CLEAR_ON_RESET },
+        { deviceAtnIsOutput,    sizeof(deviceAtnIsOutput),      CLEAR_ON_RESET },
+        { deviceDataPin,        sizeof(deviceDataPin),          CLEAR_ON_RESET },
+        { deviceDataIsOutput,   sizeof(deviceDataIsOutput),     CLEAR_ON_RESET },
+        { deviceClockPin,       sizeof(deviceClockPin),         CLEAR_ON_RESET },
+        { deviceClockIsOutput,  sizeof(deviceClockIsOutput),    CLEAR_ON_RESET },
         { &ciaDataPin,          sizeof(ciaDataPin),             CLEAR_ON_RESET },
         { &ciaDataIsOutput,     sizeof(ciaDataIsOutput),        CLEAR_ON_RESET },
         { &ciaClockPin,         sizeof(ciaClockPin),            CLEAR_ON_RESET },
@@ -49,11 +50,33 @@ IEC::IEC()
         { NULL,                 0,                              0 }};
     
     registerSnapshotItems(items, sizeof(items));
+    
+    // Only drive 8 is connected by default
+    memset(drive, 0, sizeof(drive));
+    memset(driveConnected, 0, sizeof(driveConnected));
+    
+    // Host directory devices are not part of the emulator state
+    memset(hostDir, 0, sizeof(hostDir));
+    memset(channel, 0, sizeof(channel));
+    for (unsigned i = 0; i < numHostDevices; i++)
+        setStatus(i, 73, "CBM DOS V2.6 1541");
+    device = 0;
+    state = IEC_READY;
+    listening = false;
+    talking = false;
+    secondary = 0;
+    command = 0;
+    cmdLength = 0;
+    filename[0] = 0;
 }
 
 IEC::~IEC()
 {
 	debug(3, "  Releasing IEC bus...\n");
+    
+    closeAllChannels();
+    for (unsigned i = 0; i < numHostDevices; i++)
+        free(hostDir[i]);
 }
 
 void 
@@ -62,17 +85,20 @@ IEC::reset()
    VirtualComponent::reset();
     
     // Establish bindings
-    drive = &c64->floppy;
+    for (unsigned i = 0; i < numDrives; i++)
+        drive[i] = &c64->floppy[i];
     
-    driveConnected = 1;
+    driveConnected[0] = 1;
 	atnLine = 1;
 	oldAtnLine = 1;
 	clockLine = 1;
 	oldClockLine = 1;
 	dataLine = 1;
 	oldDataLine = 1;
-	deviceDataPin = 1;
-	deviceClockPin = 1;
+    for (unsigned i = 0; i < numDrives; i++) {
+        deviceDataPin[i] = 1;
+        deviceClockPin[i] = 1;
+    }
 	ciaDataPin = 1;
 	ciaDataIsOutput = 1;
 	ciaClockPin = 1;
@@ -80,15 +106,22 @@ IEC::reset()
 	ciaAtnPin = 1;
 	ciaAtnIsOutput = 1;
 	
-	setDeviceClockPin(1);
-	setDeviceDataPin(1);
+	_updateIecLines();
+    
+    // Reset host directory devices
+    closeAllChannels();
+    for (unsigned i = 0; i < numHostDevices; i++)
+        setStatus(i, 73, "CBM DOS V2.6 1541");
+    state = IEC_READY;
+    listening = false;
+    talking = false;
 }
 
 void
 IEC::ping()
 {
-    drive->c64->putMessage(driveConnected ? MSG_VC1541_ATTACHED : MSG_VC1541_DETACHED);
-    drive->c64->putMessage(busActivity > 0 ? MSG_VC1541_DATA_ON : MSG_VC1541_DATA_OFF );
+    c64->putMessage(driveConnected[0] ? MSG_VC1541_ATTACHED : MSG_VC1541_DETACHED);
+    c64->putMessage(busActivity > 0 ? MSG_VC1541_DATA_ON : MSG_VC1541_DATA_OFF );
     
 }
 
@@ -100,7 +133,8 @@ IEC::dumpState()
 	msg("\n");
 	dumpTrace();
 	msg("\n");
-	msg("Drive connected : %s\n", driveConnected ? "yes" : "no");
+	for (unsigned i = 0; i < numDrives; i++)
+		msg("       Drive %2d : %s\n", 8 + i, driveConnected[i] ? "connected" : "not connected");
 	msg("        old ATN : %d\n", oldAtnLine);
 	msg("        old CLK : %d\n", oldClockLine);
 	msg("       old DATA : %d\n", oldDataLine);
@@ -112,42 +146,74 @@ IEC::dumpTrace()
 {
 	debug(1, "ATN: %s[%s%s%s%s] CLK: %s[%s%s%s%s] DATA: %s[%s%s%s%s]\n", 
 		  atnLine ? "1 F" : "0 T", 
-		  deviceAtnPin ? "1" : "0",
-		  deviceAtnIsOutput ? "<-" : "->", 
+		  deviceAtnPin[0] ? "1" : "0",
+		  deviceAtnIsOutput[0] ? "<-" : "->", 
 		  ciaAtnPin ? "1" : "0",
 		  ciaAtnIsOutput ? "<-" : "->",
 		  clockLine ? "1 F" : "0 T", 
-		  deviceClockPin ? "1" : "0",
-		  deviceClockIsOutput ? "<-" : "->", 
+		  deviceClockPin[0] ? "1" : "0",
+		  deviceClockIsOutput[0] ? "<-" : "->", 
 		  ciaClockPin ? "1" : "0",
 		  ciaClockIsOutput ? "<-" : "->",
 		  dataLine ? "1 F" : "0 T",
-		  deviceDataPin ? "1" : "0",
-		  deviceDataIsOutput ? "<-" : "->",
+		  deviceDataPin[0] ? "1" : "0",
+		  deviceDataIsOutput[0] ? "<-" : "->",
 		  ciaDataPin ? "1" : "0",
 		  ciaDataIsOutput ? "<-" : "->"); 
 }
 
+void
+IEC::loadFromBuffer(uint8_t **buffer)
+{
+    bool connected[numDrives];
+    
+    memcpy(connected, driveConnected, sizeof(connected));
+    VirtualComponent::loadFromBuffer(buffer);
+    
+    // Snapshots don't contain disconnected drives. Switch them off like disconnectDrive().
+    for (unsigned i = 0; i < numDrives; i++) {
+        if (connected[i] && !driveConnected[i])
+            drive[i]->reset();
+    }
+    if (memcmp(connected, driveConnected, sizeof(connected)))
+        c64->markDirty();
+}
+
 void 
-IEC::connectDrive() 
+IEC::connectDrive(unsigned nr) 
 { 
-	driveConnected = true; 
-	drive->c64->putMessage(MSG_VC1541_ATTACHED);
-    if (drive->soundMessagesEnabled())
-        drive->c64->putMessage(MSG_VC1541_ATTACHED_SOUND);
+    assert(isDriveNumber(nr));
+    
+	driveConnected[nr - 8] = true; 
+    
+    // The drive is part of the snapshot layout from now on
+    c64->markDirty();
+    
+    // The GUI only displays the state of the first drive
+    if (nr == 8) {
+        c64->putMessage(MSG_VC1541_ATTACHED);
+        if (drive[0]->soundMessagesEnabled())
+            c64->putMessage(MSG_VC1541_ATTACHED_SOUND);
+    }
 }
 	
 void 
-IEC::disconnectDrive()
+IEC::disconnectDrive(unsigned nr)
 {
+    assert(isDriveNumber(nr));
+    VC1541 *d = drive[nr - 8];
+    
     // Disconnect drive from bus
-	driveConnected = false; 
-	drive->c64->putMessage(MSG_VC1541_DETACHED);
-    if (drive->soundMessagesEnabled())
-        drive->c64->putMessage(MSG_VC1541_DETACHED_SOUND);
+	driveConnected[nr - 8] = false; 
+    c64->markDirty();
+    if (nr == 8) {
+        c64->putMessage(MSG_VC1541_DETACHED);
+        if (d->soundMessagesEnabled())
+            c64->putMessage(MSG_VC1541_DETACHED_SOUND);
+    }
 
     // Switch drive off and on
-    drive->powerUp();
+    d->powerUp();
 }
 
 bool IEC::_updateIecLines(bool *atnedge)
@@ -163,18 +229,25 @@ bool IEC::_updateIecLines(bool *atnedge)
 
 	clockLine = 1;
 	if (ciaClockIsOutput) clockLine &= ciaClockPin;
-	if (driveConnected && deviceClockIsOutput) clockLine &= deviceClockPin;
 	
 	dataLine = 1;
 	if (ciaDataIsOutput) dataLine &= ciaDataPin;
-	if (driveConnected && deviceDataIsOutput) dataLine &= deviceDataPin;
-
-	// Note: The device atn pin is not connected to the ATN line.
-	// It implements an auto acknowledge feature. When set to 1, the ATN signal
-	// is automatically acknowledged by the drive. This feature allows the C64
-	// to detect a connected drive without any interaction by the drive itself.
-	if (driveConnected && deviceAtnPin == 1)
-		dataLine &= atnLine;
+
+    for (unsigned i = 0; i < numDrives; i++) {
+        
+        if (!driveConnected[i])
+            continue;
+        
+        if (deviceClockIsOutput[i]) clockLine &= deviceClockPin[i];
+        if (deviceDataIsOutput[i]) dataLine &= deviceDataPin[i];
+        
+        // Note: The device atn pin is not connected to the ATN line.
+        // It implements an auto acknowledge feature. When set to 1, the ATN signal
+        // is automatically acknowledged by the drive. This feature allows the C64
+        // to detect a connected drive without any interaction by the drive itself.
+        if (deviceAtnPin[i] == 1)
+            dataLine &= atnLine;
+    }
 	
 	// Check atn line for a negative edge
 	if (atnedge != NULL) 
@@ -194,14 +267,16 @@ void IEC::updateIecLines()
 
 	// Check if ATN edge occurred
 	if (atn_edge) {
-		drive->simulateAtnInterrupt();
+        for (unsigned i = 0; i < numDrives; i++)
+            if (driveConnected[i])
+                drive[i]->simulateAtnInterrupt();
 	}
 
 	if (signals_changed) {
 		if (busActivity == 0) {
 			// Bus activity detected
-			drive->c64->putMessage(MSG_VC1541_DATA_ON);
-			drive->c64->setWarp(drive->c64->getAlwaysWarp() || drive->c64->getWarpLoad());
+			c64->putMessage(MSG_VC1541_DATA_ON);
+			c64->setWarp(c64->getAlwaysWarp() || c64->getWarpLoad());
 		}
 		busActivity = 30;
 	}
@@ -226,17 +301,20 @@ void IEC::updateCiaPins(uint8_t cia_data, uint8_t cia_direction)
 	updateIecLines(); 
 }
 
-void IEC::updateDevicePins(uint8_t device_data, uint8_t device_direction)
+void IEC::updateDevicePins(unsigned nr, uint8_t device_data, uint8_t device_direction)
 {
 	// Note: On the pyhsical pins, 0 is dominant. 
 	// I.e., a single 0-source will bring the signal down to 0
 	
-	deviceAtnIsOutput = (device_direction & 0x10) ? 1 : 0;
-	deviceClockIsOutput = (device_direction & 0x08) ? 1 : 0;
-	deviceDataIsOutput = (device_direction & 0x02) ? 1 : 0;
-	deviceAtnPin = (device_data & 0x10) ? 0 : 1; // Pin and line are connected via an inverter
-	deviceClockPin = (device_data & 0x08) ? 0 : 1; // Pin and line are connected via an inverter
-	deviceDataPin = (device_data & 0x02) ? 0 : 1; // Pin and line are connected via an inverter
+    assert(isDriveNumber(nr));
+    unsigned i = nr - 8;
+    
+	deviceAtnIsOutput[i] = (device_direction & 0x10) ? 1 : 0;
+	deviceClockIsOutput[i] = (device_direction & 0x08) ? 1 : 0;
+	deviceDataIsOutput[i] = (device_direction & 0x02) ? 1 : 0;
+	deviceAtnPin[i] = (device_data & 0x10) ? 0 : 1; // Pin and line are connected via an inverter
+	deviceClockPin[i] = (device_data & 0x08) ? 0 : 1; // Pin and line are connected via an inverter
+	deviceDataPin[i] = (device_data & 0x02) ? 0 : 1; // Pin and line are connected via an inverter
 				
 	updateIecLines(); 
 }
@@ -248,19 +326,104 @@ void IEC::execute()
 		busActivity--;
 		if (busActivity == 0) {
 			// Bus is idle 
-			drive->c64->putMessage(MSG_VC1541_DATA_OFF);
-			drive->c64->setWarp(drive->c64->getAlwaysWarp());
+			c64->putMessage(MSG_VC1541_DATA_OFF);
+			c64->setWarp(c64->getAlwaysWarp());
 		}
 	}
 }
 
 // -------------------------------------------------------------------
-//                            Fast loader
+//                       Host directory devices
 // -------------------------------------------------------------------
 
-#if 0
+/*! @brief    Derives the CBM file name and type from a host file name
+ *  @details  The extensions .prg, .seq, and .usr determine the file type and are
+ *            stripped off. All other files are treated as PRG files.
+ *  @result   false, if the file is hidden.
+ */
+static bool
+hostToCBM(const char *host, char *name, char *type)
+{
+    if (host[0] == '.')
+        return false;
+
+    size_t length = strlen(host);
+    *type = 'P';
+
+    if (length > 4 && host[length - 4] == '.') {
+        if (strcasecmp(host + length - 3, "prg") == 0) { *type = 'P'; length -= 4; }
+        else if (strcasecmp(host + length - 3, "seq") == 0) { *type = 'S'; length -= 4; }
+        else if (strcasecmp(host + length - 3, "usr") == 0) { *type = 'U'; length -= 4; }
+    }
+
+    unsigned i;
+    for (i = 0; i < length && i < 16; i++)
+        name[i] = ascii2pet(host[i]);
+    name[i] = 0;
+    return true;
+}
+
+//! @brief    Composes the path of a file inside a directory and checks if it is a regular file
+static bool
+composePath(const char *dir, const char *file, char *path, size_t max)
+{
+    struct stat fileProperties;
+
+    if ((size_t)snprintf(path, max, "%s/%s", dir, file) >= max)
+        return false;
+
+    return stat(path, &fileProperties) == 0 && S_ISREG(fileProperties.st_mode);
+}
+
+bool
+IEC::attachDirectory(unsigned nr, const char *path)
+{
+    if (nr < firstHostDevice || nr >= firstHostDevice + numHostDevices)
+        return false;
+
+    unsigned dev = nr - firstHostDevice;
+
+    for (unsigned sa = 0; sa < 16; sa++)
+        closeChannel(dev, sa);
+    free(hostDir[dev]);
+    hostDir[dev] = NULL;
+
+    if (path != NULL) {
+
+        DIR *dir = opendir(path);
+        if (dir == NULL) {
+            warn("Cannot open directory %s\n", path);
+            return false;
+        }
+        closedir(dir);
+        hostDir[dev] = strdup(path);
+        debug(1, "Device %d is backed by directory %s\n", nr, path);
+    }
+
+    setStatus(dev, 73, "CBM DOS V2.6 1541");
+    return true;
+}
+
+const char *
+IEC::getDirectory(unsigned nr)
+{
+    if (nr < firstHostDevice || nr >= firstHostDevice + numHostDevices)
+        return NULL;
+
+    return hostDir[nr - firstHostDevice];
+}
+
+bool
+IEC::hasHostDevices()
+{
+    for (unsigned i = 0; i < numHostDevices; i++)
+        if (hostDir[i] != NULL) return true;
+    
+    return false;
+}
 
-uint8_t IEC::IECOutATN(uint8_t byte)
+uint8_t
+IEC::IECOutATN(uint8_t byte)
 {
     // The upper four bits contain the command
     // -01- : LISTEN
@@ -268,127 +431,506 @@ uint8_t IEC::IECOutATN(uint8_t byte)
     // ---0 : on
     // ---1 : off
     // The lower four bits contain the device number
-    
+
     switch (byte >> 4) {
-            
+
         case 2: /* LISTEN */
+        case 4: /* TALK */
+
+            listening = false;
+            talking = false;
+            state = IEC_READY;
 
-            debug(2, "Device %d is now listening\n", byte & 0x0F);
-            if ((byte & 0x0F) == 8) { // We only support device number 8
-                listening = true;
-                filename[0] = 0;
-                return IEC_OK;
-            } else {
-                listening = false;
+            if (!isHostDevice(byte & 0x0F)) {
                 return IEC_NOTPRESENT;
             }
-            
+
+            debug(2, "Device %d is now %s\n", byte & 0x0F, (byte >> 4) == 2 ? "listening" : "talking");
+            device = (byte & 0x0F) - firstHostDevice;
+            listening = (byte >> 4) == 2;
+            talking = (byte >> 4) == 4;
+            state = IEC_ATTENTION;
+            return IEC_OK;
+
         case 3: /* UNLISTEN */
 
             debug(2, "No longer listening\n");
+            if (listening && command == IEC_CMD_OPEN) {
+                openChannel(device, secondary);
+            } else if (listening && command == IEC_CMD_DATA && secondary == 15) {
+                executeCommand(device);
+            }
             listening = false;
+            state = IEC_READY;
             return IEC_OK;
-            
-        case 4: /* TALK */
-
-            debug(2, "Device %d is now listening\n", byte & 0x0F);
-            if ((byte & 0x0F) == 8) { // We only support device number 8
-                talking = true;
-                return IEC_OK;
-            } else {
-                talking = false;
-                return IEC_NOTPRESENT;
-            }
 
         case 5: /* UNTALK */
-            
+
             debug(2, "No longer talking\n");
             talking = false;
+            state = IEC_READY;
             return IEC_OK;
     }
-    
+
     return IEC_TIMEOUT;
 }
 
-uint8_t IEC::IECOutSec(uint8_t byte)
+uint8_t
+IEC::IECOutSec(uint8_t byte)
 {
     // byte: xxxx---- : Command to execute
     //       ----xxxx : Secondary address
-    
+
+    if (state != IEC_ATTENTION) {
+        return IEC_TIMEOUT;
+    }
+    state = IEC_READY;
+
     if (listening) {
         return IECOutSecWhileListening(byte);
     }
-    
+
     if (talking) {
         return IECOutSecWhileTalking(byte);
     }
-    
+
     return IEC_TIMEOUT;
 }
 
-uint8_t IEC::IECOutSecWhileListening(uint8_t byte)
+uint8_t
+IEC::IECOutSecWhileListening(uint8_t byte)
 {
     command = (byte >> 4);
     secondary = (byte & 0xF);
-    
+    cmdLength = 0;
+
     switch (command) {
         case IEC_CMD_OPEN:
-            debug(2, "Received command: OPEN\n");
+            debug(2, "Received command: OPEN %d\n", secondary);
             return IEC_OK;
         case IEC_CMD_CLOSE:
-            debug(2, "Received command: CLOSE\n");
-            // Turn on LED
+            debug(2, "Received command: CLOSE %d\n", secondary);
+            closeChannel(device, secondary);
             return IEC_OK;
     }
     return IEC_OK;
 }
 
-uint8_t IEC::IECOutSecWhileTalking(uint8_t byte)
+uint8_t
+IEC::IECOutSecWhileTalking(uint8_t byte)
 {
     command = (byte >> 4);
     secondary = (byte & 0xF);
-    return IEC_OK;
 
+    // Talking on the command channel reads the error channel
+    if (secondary == 15) {
+
+        HostChannel *c = &channel[device][15];
+        if (c->data == NULL || c->pos >= c->size) {
+            closeChannel(device, 15);
+            c->size = strlen(status[device]);
+            c->data = new uint8_t[c->size];
+            memcpy(c->data, status[device], c->size);
+            setStatus(device, 0, " OK");
+        }
+    }
+    return IEC_OK;
 }
 
-uint8_t IEC::IECOut(uint8_t byte, bool eoi)
+uint8_t
+IEC::IECOut(uint8_t byte, bool eoi)
 {
-    char tmp[2] = { byte, 0 };
-    strncat(filename, tmp, 16);
-    
-    if (eoi) {
-        printf("Filename: ");
-        for (unsigned i = 0; i < strlen(filename); i++)
-            printf("%c", pet2ascii(filename[i]));
-        printf("\n");
+    if (!listening) {
+        return IEC_TIMEOUT;
+    }
+
+    if (command == IEC_CMD_OPEN || (command == IEC_CMD_DATA && secondary == 15)) {
+
+        // Collect file name or DOS command
+        if (cmdLength < sizeof(cmdBuffer))
+            cmdBuffer[cmdLength++] = byte;
+
+    } else if (command == IEC_CMD_DATA) {
+
+        FILE *file = channel[device][secondary].file;
+        if (file != NULL && fputc(byte, file) == EOF) {
+            setStatus(device, 25, "WRITE ERROR");
+        }
     }
 
     return IEC_OK;
 }
 
-uint8_t IEC::IECIn(uint8_t *byte)
+uint8_t
+IEC::IECIn(uint8_t *byte)
 {
-    *byte = 42;
-    return IEC_OK;
+    if (!talking) {
+        return IEC_TIMEOUT;
+    }
+
+    HostChannel *c = &channel[device][secondary];
+    if (c->data == NULL || c->pos >= c->size) {
+        *byte = 0x0D;
+        return IEC_READ_TIMEOUT;
+    }
+
+    *byte = c->data[c->pos++];
+    return c->pos == c->size ? IEC_EOF : IEC_OK;
 }
 
-void IEC::IECSetATN()
+void
+IEC::closeAllChannels()
 {
-    
+    for (unsigned dev = 0; dev < numHostDevices; dev++)
+        for (unsigned sa = 0; sa < 16; sa++)
+            closeChannel(dev, sa);
 }
 
-void IEC::IECRelATN()
+void
+IEC::closeChannel(unsigned dev, unsigned sa)
 {
-    
+    assert(dev < numHostDevices && sa < 16);
+
+    HostChannel *c = &channel[dev][sa];
+
+    delete[] c->data;
+    if (c->file != NULL)
+        fclose(c->file);
+
+    c->data = NULL;
+    c->size = 0;
+    c->pos = 0;
+    c->file = NULL;
 }
 
-void IEC::IECTurnaround()
+void
+IEC::openChannel(unsigned dev, unsigned sa)
 {
-    
+    // The command channel executes the file name as a DOS command
+    if (sa == 15) {
+        executeCommand(dev);
+        return;
+    }
+
+    closeChannel(dev, sa);
+
+    // Directory listing ("$" or "$0:pattern")
+    if (cmdLength > 0 && cmdBuffer[0] == '$') {
+
+        uint8_t *colon = (uint8_t *)memchr(cmdBuffer, ':', cmdLength);
+        unsigned i = colon ? (unsigned)(colon - cmdBuffer) + 1 : cmdLength;
+        unsigned length = 0;
+
+        while (i < cmdLength && length < 16) filename[length++] = cmdBuffer[i++];
+        if (length == 0) filename[length++] = '*';
+        filename[length] = 0;
+
+        makeDirectoryListing(dev, sa);
+        setStatus(dev, 0, " OK");
+        return;
+    }
+
+    // File name syntax: [@][drive:]name[,type[,mode]]
+    unsigned i = 0, length = 0;
+    bool overwrite = false;
+    char type = 0, mode = 'R';
+
+    if (i < cmdLength && cmdBuffer[i] == '@') {
+        overwrite = true;
+        i++;
+    }
+    uint8_t *colon = (uint8_t *)memchr(cmdBuffer + i, ':', cmdLength - i);
+    if (colon != NULL) {
+        i = (unsigned)(colon - cmdBuffer) + 1;
+    }
+    while (i < cmdLength && cmdBuffer[i] != ',') {
+        if (length < 16) filename[length++] = cmdBuffer[i];
+        i++;
+    }
+    filename[length] = 0;
+
+    while (i < cmdLength) {
+
+        // Skip comma and evaluate the first character of the option
+        if (++i < cmdLength) {
+            switch (cmdBuffer[i]) {
+                case 'P': case 'S': case 'U': type = cmdBuffer[i]; break;
+                case 'R': case 'W': case 'A': mode = cmdBuffer[i]; break;
+            }
+        }
+        while (i < cmdLength && cmdBuffer[i] != ',') i++;
+    }
+
+    // Secondary addresses 0 and 1 are reserved for LOAD and SAVE
+    if (sa == 0) { mode = 'R'; }
+    if (sa == 1) { mode = 'W'; type = 'P'; }
+
+    if (length == 0) {
+        setStatus(dev, 34, "SYNTAX ERROR");
+        return;
+    }
+
+    char path[MAXPATHLEN];
+    bool found = findHostFile(dev, mode == 'W' ? 0 : type, path, sizeof(path));
+    HostChannel *c = &channel[dev][sa];
+
+    switch (mode) {
+
+        case 'R':
+        {
+            if (!found) {
+                setStatus(dev, 62, "FILE NOT FOUND");
+                return;
+            }
+
+            long size = getSizeOfFile(path);
+            FILE *file = fopen(path, "r");
+            if (size < 0 || file == NULL) {
+                if (file) fclose(file);
+                setStatus(dev, 62, "FILE NOT FOUND");
+                return;
+            }
+
+            c->data = new uint8_t[size > 0 ? size : 1];
+            c->size = fread(c->data, 1, size, file);
+            fclose(file);
+            debug(2, "Reading %s (%zu bytes)\n", path, c->size);
+            break;
+        }
+        case 'A':
+
+            if (!found) {
+                setStatus(dev, 62, "FILE NOT FOUND");
+                return;
+            }
+            c->file = fopen(path, "a");
+            break;
+
+        case 'W':
+        {
+            if (strchr(filename, '*') || strchr(filename, '?')) {
+                setStatus(dev, 33, "SYNTAX ERROR");
+                return;
+            }
+            if (found && !overwrite) {
+                setStatus(dev, 63, "FILE EXISTS");
+                return;
+            }
+
+            // Create a new host file unless an existing one is replaced
+            if (!found) {
+
+                char name[17 + 4];
+                for (i = 0; i < length; i++) {
+                    uint8_t ch = (uint8_t)filename[i];
+                    name[i] = (ch >= 'A' && ch <= 'Z') ? tolower(ch) :
+                    (ch < 0x20 || ch > 0x7E || ch == '/') ? '_' : ch;
+                }
+                strcpy(name + length, type == 'S' ? ".seq" : type == 'U' ? ".usr" : ".prg");
+                snprintf(path, sizeof(path), "%s/%s", hostDir[dev], name);
+            }
+
+            c->file = fopen(path, "w");
+            debug(2, "Writing %s\n", path);
+            break;
+        }
+    }
+
+    if (mode != 'R' && c->file == NULL) {
+        setStatus(dev, 26, "WRITE PROTECT ON");
+        return;
+    }
+
+    setStatus(dev, 0, " OK");
 }
 
-void IEC::IECRelease()
+void
+IEC::executeCommand(unsigned dev)
 {
-    
+    // Strip trailing carriage returns
+    while (cmdLength > 0 && cmdBuffer[cmdLength - 1] == 0x0D)
+        cmdLength--;
+
+    if (cmdLength == 0)
+        return;
+
+    debug(2, "Executing DOS command %.*s\n", cmdLength, cmdBuffer);
+
+    switch (cmdBuffer[0]) {
+
+        case 'I': /* INITIALIZE */
+
+            setStatus(dev, 0, " OK");
+            return;
+
+        case 'U': /* UJ (reset) */
+
+            if (cmdLength > 1 && (cmdBuffer[1] == 'J' || cmdBuffer[1] == ':')) {
+                for (unsigned sa = 0; sa < 16; sa++)
+                    closeChannel(dev, sa);
+                setStatus(dev, 73, "CBM DOS V2.6 1541");
+                return;
+            }
+            break;
+
+        case 'S': /* SCRATCH */
+        {
+            uint8_t *colon = (uint8_t *)memchr(cmdBuffer, ':', cmdLength);
+            if (colon == NULL)
+                break;
+
+            unsigned i = (unsigned)(colon - cmdBuffer) + 1, length = 0;
+            while (i < cmdLength && length < 16) filename[length++] = cmdBuffer[i++];
+            filename[length] = 0;
+
+            char path[MAXPATHLEN];
+            unsigned count = 0;
+            while (length > 0 && findHostFile(dev, 0, path, sizeof(path)) && unlink(path) == 0)
+                count++;
+
+            setStatus(dev, 1, " FILES SCRATCHED", count);
+            return;
+        }
+    }
+
+    setStatus(dev, 31, "SYNTAX ERROR");
+}
+
+void
+IEC::setStatus(unsigned dev, unsigned code, const char *text, unsigned arg)
+{
+    assert(dev < numHostDevices);
+    snprintf(status[dev], sizeof(status[dev]), "%02u,%s,%02u,00\r", code, text, arg);
+}
+
+bool
+IEC::findHostFile(unsigned dev, char type, char *path, size_t max)
+{
+    assert(hostDir[dev] != NULL);
+
+    DIR *dir = opendir(hostDir[dev]);
+    if (dir == NULL)
+        return false;
+
+    // If multiple files match, take the first one in alphabetical order
+    char best[MAXPATHLEN] = "";
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+
+        char name[17], t;
+        if (!hostToCBM(entry->d_name, name, &t) || (type != 0 && type != t))
+            continue;
+        if (!matchFilename((uint8_t *)filename, (unsigned)strlen(filename), name))
+            continue;
+        if (best[0] != 0 && strcmp(entry->d_name, best) >= 0)
+            continue;
+        if (composePath(hostDir[dev], entry->d_name, path, max))
+            strncpy(best, entry->d_name, sizeof(best) - 1);
+    }
+    closedir(dir);
+
+    return best[0] != 0 && composePath(hostDir[dev], best, path, max);
+}
+
+//! @brief    Directory entry of a host directory device
+typedef struct {
+    char host[MAXPATHLEN];
+    char name[17];
+    char type;
+    unsigned blocks;
+} HostFile;
+
+static int
+compareHostFiles(const void *a, const void *b)
+{
+    return strcmp(((const HostFile *)a)->host, ((const HostFile *)b)->host);
+}
+
+//! @brief    Appends a line to a BASIC program
+static void
+appendLine(uint8_t *program, size_t *size, uint16_t number, const char *text)
+{
+    size_t start = *size, length = strlen(text);
+    uint16_t next = 0x0401 + (uint16_t)(start - 2 + 4 + length + 1);
+
+    program[(*size)++] = LO_BYTE(next);
+    program[(*size)++] = HI_BYTE(next);
+    program[(*size)++] = LO_BYTE(number);
+    program[(*size)++] = HI_BYTE(number);
+    memcpy(program + *size, text, length + 1);
+    *size += length + 1;
+}
+
+void
+IEC::makeDirectoryListing(unsigned dev, unsigned sa)
+{
+    DIR *dir = opendir(hostDir[dev]);
+    HostFile *files = NULL;
+    unsigned count = 0, capacity = 0, used = 0;
+    char path[MAXPATHLEN];
+
+    // Collect all matching files
+    struct dirent *entry;
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+
+        HostFile file;
+        if (!hostToCBM(entry->d_name, file.name, &file.type))
+            continue;
+        if (!matchFilename((uint8_t *)filename, (unsigned)strlen(filename), file.name))
+            continue;
+        if (!composePath(hostDir[dev], entry->d_name, path, sizeof(path)))
+            continue;
+
+        if (count == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            files = (HostFile *)realloc(files, capacity * sizeof(HostFile));
+        }
+        strncpy(file.host, entry->d_name, sizeof(file.host) - 1);
+        file.host[sizeof(file.host) - 1] = 0;
+        file.blocks = (unsigned)((getSizeOfFile(path) + 253) / 254);
+        files[count++] = file;
+        used += file.blocks;
+    }
+    if (dir != NULL)
+        closedir(dir);
+    qsort(files, count, sizeof(HostFile), compareHostFiles);
+
+    // Each line takes at most 36 bytes
+    HostChannel *c = &channel[dev][sa];
+    uint8_t *program = new uint8_t[2 + 36 * (count + 2) + 2];
+    size_t size = 0;
+    char text[32], name[17], quoted[18];
+
+    program[size++] = 0x01;
+    program[size++] = 0x04;
+
+    // Header with the name of the host directory
+    char *title = ExtractFilename(hostDir[dev]);
+    unsigned i;
+    for (i = 0; i < 16 && title[i]; i++) name[i] = ascii2pet(title[i]);
+    name[i] = 0;
+    free(title);
+    snprintf(text, sizeof(text), "\x12\"%-16s\" 00 2A", name);
+    appendLine(program, &size, 0, text);
+
+    // Directory entries
+    for (unsigned j = 0; j < count; j++) {
+
+        HostFile *f = &files[j];
+        const char *type = f->type == 'S' ? "SEQ" : f->type == 'U' ? "USR" : "PRG";
+        int indent = f->blocks < 10 ? 3 : f->blocks < 100 ? 2 : f->blocks < 1000 ? 1 : 0;
+
+        snprintf(quoted, sizeof(quoted), "%s\"", f->name);
+        snprintf(text, sizeof(text), "%*s\"%-17s %s", indent, "", quoted, type);
+        appendLine(program, &size, (uint16_t)MIN(f->blocks, 0xFFFF), text);
+    }
+
+    appendLine(program, &size, (uint16_t)(used < 664 ? 664 - used : 0), "BLOCKS FREE.");
+    program[size++] = 0x00;
+    program[size++] = 0x00;
+    free(files);
+
+    c->data = program;
+    c->size = size;
 }
-#endif
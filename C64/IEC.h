@@ -46,13 +46,16 @@ class IEC : public VirtualComponent {
 
 public:
 	
-	//! Reference to the virtual disk drive
-	VC1541 *drive;
+	//! Number of disk drives on the bus (device numbers 8 to 11)
+	static const unsigned numDrives = 4;
+
+	//! References to the virtual disk drives (drive[0] has device number 8)
+	VC1541 *drive[numDrives];
 
 private:
 
-	//! True, iff drive is connected to the IEC bus
-	bool driveConnected;
+	//! True, iff a drive is connected to the IEC bus
+	bool driveConnected[numDrives];
 	
 	//! Current value of the IEC bus atn line	
 	bool atnLine;
@@ -72,23 +75,23 @@ private:
 	//! Previous value of the IEC bus data line
 	bool oldDataLine;
 	 	
-	//! Current value of the atn pin of the connected external device
-	bool deviceAtnPin;
+	//! Current value of the atn pin of each drive
+	bool deviceAtnPin[numDrives];
 
 	//! True, iff the device atn pin is configured as output
-	bool deviceAtnIsOutput;
+	bool deviceAtnIsOutput[numDrives];
 
-	//! Current value of the data pin of the connected external device
-	bool deviceDataPin;
+	//! Current value of the data pin of each drive
+	bool deviceDataPin[numDrives];
 
 	//! True, iff the device data pin is configured as output
-	bool deviceDataIsOutput;
+	bool deviceDataIsOutput[numDrives];
 		
-	//! Current value of the clock pin of the connected external device
-	bool deviceClockPin;
+	//! Current value of the clock pin of each drive
+	bool deviceClockPin[numDrives];
 
 	//! True, iff the device clock pin is configured as output
-	bool deviceClockIsOutput;
+	bool deviceClockIsOutput[numDrives];
 	
 	//! Current value of the data pin of the connected CIA chip
 	bool ciaDataPin;
@@ -124,6 +127,9 @@ public:
 			
 	//! Bring the component back to its initial state
 	void reset();
+    
+    //! Loads the current state from a buffer
+    void loadFromBuffer(uint8_t **buffer);
 
     //! Dump current configuration into message queue
     void ping();
@@ -134,17 +140,18 @@ public:
 	//! Write trace output to console
 	void dumpTrace();
 	
-	//! Connect the virtual diesc drive to the IEC bus
-	void setDrive(VC1541 *d) { assert(drive == NULL); drive = d; }
+	//! Returns true, iff nr is the device number of a disk drive
+	static bool isDriveNumber(unsigned nr) { return nr >= 8 && nr < 8 + numDrives; }
 	
 	//! Connect drive to the IEC bus
-	void connectDrive();
+	void connectDrive(unsigned nr = 8);
 	
 	//! Disconnect the drive from the IEC bus
-	void disconnectDrive();
+	void disconnectDrive(unsigned nr = 8);
 
 	//! Returns true, iff a virtual disk drive is connected
-	bool driveIsConnected() { return driveConnected; }
+	bool driveIsConnected(unsigned nr = 8) {
+        assert(isDriveNumber(nr)); return driveConnected[nr - 8]; }
 		
 	//! Change/Update the value of all three bus lines 
 	void updateIecLines();
@@ -153,13 +160,9 @@ public:
 	//* This function is to be invoked by the cia chip, only.
 	void updateCiaPins(uint8_t cia_data, uint8_t cia_direction);	
 
-    //! Updates the values of the device pin variables
+    //! Updates the values of the device pin variables of a drive
 	//* This function is to be invoked by the VC1541 drive, only.
-	void updateDevicePins(uint8_t device_data, uint8_t device_direction);	
-	
-	// Deprecated (won't drive them manually when the drive is constantly connected)
-	void setDeviceClockPin(bool value) { deviceClockPin = value; _updateIecLines(); } 
-	void setDeviceDataPin(bool value) { deviceDataPin = value; _updateIecLines(); }
+	void updateDevicePins(unsigned nr, uint8_t device_data, uint8_t device_direction);	
 			
 	bool getAtnLine() { return atnLine; }
 	bool getClockLine() { return clockLine; }
@@ -176,11 +179,57 @@ public:
 	void execute();
     
     // -------------------------------------------------------------------
-    //                     Frodo-style fast loader
+    //                     Host directory devices
     // -------------------------------------------------------------------
    
+public:
+    
+    //! Number of the first device that can be backed by a host directory
+    static const unsigned firstHostDevice = 8;
+
+    //! Number of devices that can be backed by a host directory (8 to 11)
+    static const unsigned numHostDevices = 4;
+
 private:
     
+    /*! @brief   Channel of a host directory device
+     *  @details A channel either holds the complete contents of the file being read or
+     *           the host file being written.
+     */
+    typedef struct {
+        
+        //! Data sent to the computer (NULL if nothing to read)
+        uint8_t *data;
+        
+        //! Number of bytes in data
+        size_t size;
+        
+        //! Read position
+        size_t pos;
+        
+        //! Host file receiving the data sent by the computer (NULL if not writing)
+        FILE *file;
+        
+    } HostChannel;
+    
+    //! Host directories backing devices 8 to 11 (NULL if no directory is attached)
+    char *hostDir[numHostDevices];
+    
+    //! Open channels of all host directory devices
+    HostChannel channel[numHostDevices][16];
+    
+    //! Contents of the error channels
+    char status[numHostDevices][40];
+    
+    //! Host directory device addressed by the most recent LISTEN or TALK command
+    uint8_t device;
+    
+    /*! @brief   Bus state
+     *  @details IEC_ATTENTION between a LISTEN or TALK command and the secondary address,
+     *           IEC_READY otherwise.
+     */
+    uint8_t state;
+    
     //! Indicates if the simulated drive is currently listening
     bool listening;
 
@@ -193,6 +242,12 @@ private:
     //! Received command
     uint8_t command;
     
+    //! Bytes received after an OPEN command or on the command channel
+    uint8_t cmdBuffer[42];
+    
+    //! Number of bytes in cmdBuffer
+    unsigned cmdLength;
+    
     //! Filename storage
     char filename[17]; 
 
@@ -211,8 +266,35 @@ public:
         IEC_CMD_CLOSE = 0x0E,       // Close channel
         IEC_CMD_OPEN = 0x0F         // Open channel
     };
-#if 0
-    //! Sends the attention signal to all connected devices
+
+    /*! @brief   Backs a device with a directory on the host file system
+     *  @details PRG, SEQ, and USR files are recognized by their file name extension. All
+     *           other files are served as PRG files under their full name. The device
+     *           shadows a VC1541 with the same device number. Pass NULL to detach the
+     *           directory.
+     *  @result  false, if the device number is out of range or the directory can't be read.
+     */
+    bool attachDirectory(unsigned nr, const char *path);
+    
+    //! Returns the directory backing a device or NULL
+    const char *getDirectory(unsigned nr);
+    
+    //! Returns true, iff the device is backed by a host directory
+    bool isHostDevice(unsigned nr) { return getDirectory(nr) != NULL; }
+    
+    //! Returns true, iff at least one device is backed by a host directory
+    bool hasHostDevices();
+    
+    //! Returns true, iff a host directory device is currently listening
+    bool isListening() { return listening; }
+
+    //! Returns true, iff a host directory device is currently talking
+    bool isTalking() { return talking; }
+    
+    /*! @brief   Sends a byte with ATN asserted
+     *  @details Handles the LISTEN, UNLISTEN, TALK, and UNTALK commands.
+     *  @result  IEC_NOTPRESENT, if a device is addressed that is not backed by a directory.
+     */
     uint8_t IECOutATN(uint8_t byte);
 
     //! Puts the secondary address on the bus
@@ -226,12 +308,34 @@ public:
 
     //! Read a data byte from the bus
     uint8_t IECIn(uint8_t *byte);
-#endif 
     
-    void IECSetATN();
-    void IECRelATN();
-    void IECTurnaround();
-    void IECRelease();
+private:
+    
+    //! Closes all channels of all host directory devices
+    void closeAllChannels();
+    
+    //! Closes a single channel
+    void closeChannel(unsigned dev, unsigned sa);
+    
+    //! Opens a channel with the file name stored in the command buffer
+    void openChannel(unsigned dev, unsigned sa);
+    
+    //! Executes the DOS command stored in the command buffer
+    void executeCommand(unsigned dev);
+    
+    //! Writes a message into the error channel
+    void setStatus(unsigned dev, unsigned code, const char *text, unsigned arg = 0);
+    
+    /*! @brief   Searches the host directory for a file
+     *  @details The search pattern is taken from filename. Wildcards are supported.
+     *  @param   type  File type ('P', 'S', 'U') or 0 to accept any type
+     *  @param   path  Receives the path of the file
+     *  @result  false, if no matching file has been found.
+     */
+    bool findHostFile(unsigned dev, char type, char *path, size_t max);
+    
+    //! Stores a BASIC program with the directory listing in a channel
+    void makeDirectoryListing(unsigned dev, unsigned sa);
 };
 	
 #endif
@@ -0,0 +1,389 @@
+/*!
+ * @header      Inflater.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "Inflater.h"
+
+//! @brief    Maximum length of a Huffman code
+static const unsigned maxCodeLength = 15;
+
+//! @brief    Base values and extra bits of the length symbols 257 to 285
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+//! @brief    Base values and extra bits of the distance symbols
+static const uint16_t distBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//! @brief    Order in which the code length code lengths are stored
+static const uint8_t codeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+//! @brief    Reads a DEFLATE stream bit by bit (least significant bit first)
+typedef struct {
+
+    const uint8_t *src;
+    const uint8_t *end;
+
+    //! @brief    Bits read ahead
+    uint64_t bits;
+    unsigned count;
+
+    //! @brief    Number of zero bytes appended behind the end of the stream
+    unsigned padding;
+
+} BitReader;
+
+static inline void
+refill(BitReader *in)
+{
+    while (in->count <= 56) {
+        if (in->src < in->end) {
+            in->bits |= (uint64_t)*in->src++ << in->count;
+        } else {
+            in->padding++;
+        }
+        in->count += 8;
+    }
+}
+
+static inline unsigned
+getBits(BitReader *in, unsigned n)
+{
+    if (in->count < n)
+        refill(in);
+
+    unsigned result = (unsigned)(in->bits & ((1ULL << n) - 1));
+    in->bits >>= n;
+    in->count -= n;
+    return result;
+}
+
+//! @brief    Returns true if bits behind the end of the stream have been consumed
+static inline bool
+overrun(BitReader *in)
+{
+    return 8 * in->padding > in->count;
+}
+
+/*! @brief    Lookup table for decoding a Huffman code
+ *  @details  The table is indexed by the next 'bits' bits of the stream. Each entry
+ *            stores the symbol in the upper 12 bits and the code length in the lower
+ *            4 bits. A code length of 0 marks an unused code.
+ */
+typedef struct {
+
+    uint16_t entry[1 << maxCodeLength];
+    unsigned bits;
+
+} Huffman;
+
+//! @brief    Sets up a Huffman table from a list of code lengths
+static bool
+buildHuffman(Huffman *h, const uint8_t *lengths, unsigned n)
+{
+    uint16_t count[maxCodeLength + 1], next[maxCodeLength + 1];
+
+    memset(count, 0, sizeof(count));
+    for (unsigned i = 0; i < n; i++)
+        count[lengths[i]]++;
+    count[0] = 0;
+
+    // Determine the table size and reject over-subscribed codes
+    int left = 1;
+    h->bits = 1;
+    for (unsigned len = 1; len <= maxCodeLength; len++) {
+        left = 2 * left - count[len];
+        if (left < 0)
+            return false;
+        if (count[len])
+            h->bits = len;
+    }
+
+    // Compute the first canonical code of each length
+    next[1] = 0;
+    for (unsigned len = 1; len < maxCodeLength; len++)
+        next[len + 1] = (next[len] + count[len]) << 1;
+
+    // Fill in all table entries starting with the (bit reversed) code
+    unsigned size = 1 << h->bits;
+    memset(h->entry, 0, size * sizeof(uint16_t));
+    for (unsigned symbol = 0; symbol < n; symbol++) {
+
+        unsigned len = lengths[symbol];
+        if (len == 0)
+            continue;
+
+        unsigned code = next[len]++, reversed = 0;
+        for (unsigned i = 0; i < len; i++, code >>= 1)
+            reversed = (reversed << 1) | (code & 1);
+
+        for (unsigned i = reversed; i < size; i += 1 << len)
+            h->entry[i] = (uint16_t)(symbol << 4 | len);
+    }
+    return true;
+}
+
+//! @brief    Decodes a single symbol (returns -1 for an unused code)
+static inline int
+decodeSymbol(BitReader *in, const Huffman *h)
+{
+    if (in->count < h->bits)
+        refill(in);
+
+    uint16_t entry = h->entry[in->bits & ((1 << h->bits) - 1)];
+    unsigned len = entry & 0xF;
+    if (len == 0)
+        return -1;
+
+    in->bits >>= len;
+    in->count -= len;
+    return entry >> 4;
+}
+
+//! @brief    Reads the code tables of a block with dynamic Huffman codes
+static bool
+readDynamicTables(BitReader *in, Huffman *lit, Huffman *dist)
+{
+    uint8_t lengths[286 + 30];
+    Huffman *codes = lit; // Used temporarily for the code length code
+
+    unsigned nlen = getBits(in, 5) + 257;
+    unsigned ndist = getBits(in, 5) + 1;
+    unsigned ncode = getBits(in, 4) + 4;
+    if (nlen > 286 || ndist > 30)
+        return false;
+
+    memset(lengths, 0, 19);
+    for (unsigned i = 0; i < ncode; i++)
+        lengths[codeLengthOrder[i]] = getBits(in, 3);
+    if (!buildHuffman(codes, lengths, 19))
+        return false;
+
+    // Read the code lengths of both alphabets
+    for (unsigned i = 0; i < nlen + ndist; ) {
+
+        int symbol = decodeSymbol(in, codes);
+        unsigned value = 0, repeat;
+
+        if (symbol < 0) {
+            return false;
+        } else if (symbol < 16) {
+            lengths[i++] = symbol;
+            continue;
+        } else if (symbol == 16) {
+            if (i == 0)
+                return false;
+            value = lengths[i - 1];
+            repeat = 3 + getBits(in, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + getBits(in, 3);
+        } else {
+            repeat = 11 + getBits(in, 7);
+        }
+
+        if (i + repeat > nlen + ndist)
+            return false;
+        while (repeat--)
+            lengths[i++] = value;
+    }
+
+    // The end-of-block symbol must be present
+    if (lengths[256] == 0)
+        return false;
+
+    return buildHuffman(lit, lengths, nlen) && buildHuffman(dist, lengths + nlen, ndist);
+}
+
+//! @brief    Sets up the code tables of a block with fixed Huffman codes
+static void
+makeFixedTables(Huffman *lit, Huffman *dist)
+{
+    uint8_t lengths[288];
+    unsigned i = 0;
+
+    while (i < 144) lengths[i++] = 8;
+    while (i < 256) lengths[i++] = 9;
+    while (i < 280) lengths[i++] = 7;
+    while (i < 288) lengths[i++] = 8;
+    buildHuffman(lit, lengths, 288);
+
+    memset(lengths, 5, 30);
+    buildHuffman(dist, lengths, 30);
+}
+
+bool
+Inflater::inflate(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize, size_t *written)
+{
+    BitReader in = { src, src + srcSize, 0, 0, 0 };
+    uint8_t *out = dst, *end = dst + dstSize;
+    bool final = false, success = true;
+
+    Huffman *lit = new Huffman, *dist = new Huffman;
+
+    while (success && !final && out < end) {
+
+        final = getBits(&in, 1);
+        unsigned type = getBits(&in, 2);
+
+        if (type == 0) {
+
+            // Stored block: Discard the remaining bits of the current byte and rewind
+            // the input to the first byte that hasn't been consumed yet
+            if (overrun(&in)) {
+                success = false;
+                break;
+            }
+            in.bits = 0;
+            in.src -= in.count / 8 - in.padding;
+            in.count = in.padding = 0;
+
+            if (in.end - in.src < 4) {
+                success = false;
+                break;
+            }
+            unsigned len = in.src[0] | in.src[1] << 8;
+            unsigned nlen = in.src[2] | in.src[3] << 8;
+            in.src += 4;
+
+            if ((len ^ 0xFFFF) != nlen || (size_t)(in.end - in.src) < len) {
+                success = false;
+                break;
+            }
+            if (len > (size_t)(end - out))
+                len = (unsigned)(end - out);
+
+            memcpy(out, in.src, len);
+            in.src += len;
+            out += len;
+            continue;
+        }
+
+        if (type == 1) {
+            makeFixedTables(lit, dist);
+        } else if (type != 2 || !readDynamicTables(&in, lit, dist)) {
+            success = false;
+            break;
+        }
+
+        // Decode literals and matches until the end of the block is reached
+        while (out < end) {
+
+            int symbol = decodeSymbol(&in, lit);
+
+            if (symbol < 256) {
+                if (symbol < 0) {
+                    success = false;
+                    break;
+                }
+                *out++ = (uint8_t)symbol;
+                continue;
+            }
+            if (symbol == 256)
+                break;
+
+            symbol -= 257;
+            if (symbol >= 29) {
+                success = false;
+                break;
+            }
+            size_t length = lengthBase[symbol] + getBits(&in, lengthExtra[symbol]);
+
+            symbol = decodeSymbol(&in, dist);
+            if (symbol < 0 || symbol >= 30) {
+                success = false;
+                break;
+            }
+            size_t distance = distBase[symbol] + getBits(&in, distExtra[symbol]);
+
+            if (distance > (size_t)(out - dst)) {
+                success = false;
+                break;
+            }
+            if (length > (size_t)(end - out))
+                length = end - out;
+
+            // Copy the match (source and destination may overlap)
+            const uint8_t *from = out - distance;
+            if (distance >= 8) {
+                while (length >= 8) {
+                    memcpy(out, from, 8);
+                    out += 8;
+                    from += 8;
+                    length -= 8;
+                }
+            }
+            while (length--)
+                *out++ = *from++;
+        }
+
+        if (overrun(&in))
+            success = false;
+    }
+
+    delete lit;
+    delete dist;
+
+    if (written)
+        *written = out - dst;
+
+    return success;
+}
+
+
+//
+// CRC-32
+//
+
+static uint32_t crcTable[256];
+
+static bool
+initCrcTable()
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (unsigned k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        crcTable[i] = c;
+    }
+    return true;
+}
+
+static bool crcTableInitialized = initCrcTable();
+
+uint32_t
+Inflater::crc32(const uint8_t *data, size_t size, uint32_t crc)
+{
+    assert(crcTableInitialized);
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
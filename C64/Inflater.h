@@ -0,0 +1,50 @@
+/*!
+ * @header      Inflater.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _INFLATER_INC
+#define _INFLATER_INC
+
+#include "basic.h"
+
+/*! @class    Inflater
+ *  @brief    Built-in decoder for the DEFLATE format (RFC 1951)
+ *  @details  DEFLATE is the compression format used inside gzip and zip files.
+ *            The decoder writes directly into the destination buffer, which also serves
+ *            as the sliding window. Hence, no memory is allocated apart from the two
+ *            Huffman lookup tables.
+ */
+class Inflater {
+
+public:
+
+    /*! @brief    Decompresses a raw DEFLATE stream
+     *  @details  Decompression stops at the end of the stream or when the destination
+     *            buffer is full. Hence, the first bytes of a stream can be inspected by
+     *            passing a small buffer. All accesses are bounds checked.
+     *  @param    written  Number of bytes written into dst (optional)
+     *  @return   false, if the stream is corrupted.
+     */
+    static bool inflate(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize, size_t *written = NULL);
+
+    //! @brief    Computes the CRC-32 checksum used by gzip and zip
+    static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+};
+
+#endif
@@ -497,15 +497,20 @@ CPU::executeMicroInstruction()
                 trace("%s\n", instr.formatted);
             }
             
-            // Check breakpoint tag
+            // Check breakpoint tag (breakpoints set by the user take precedence over traps)
             if (breakpoint[PC_at_cycle_0] != NO_BREAKPOINT) {
+                if (breakpoint[PC_at_cycle_0] == EMULATOR_TRAP && c64->executeTrap(PC_at_cycle_0)) {
+                    next = fetch; // The emulator has taken care of the routine
+                    return;
+                }
                 if (breakpoint[PC_at_cycle_0] & SOFT_BREAKPOINT) {
                     breakpoint[PC_at_cycle_0] &= ~SOFT_BREAKPOINT; // Soft breakpoints get deleted when reached
                     setErrorState(CPU_SOFT_BREAKPOINT_REACHED);
-                } else {
+                    debug(1, "Breakpoint reached\n");
+                } else if (breakpoint[PC_at_cycle_0] & HARD_BREAKPOINT) {
                     setErrorState(CPU_HARD_BREAKPOINT_REACHED);
+                    debug(1, "Breakpoint reached\n");
                 }
-                debug(1, "Breakpoint reached\n");
             }
             return;
             
@@ -1521,10 +1526,10 @@ CPU::executeMicroInstruction()
             READ_IMMEDIATE
             POLL_INT
             
-            if (chipModel == MOS_6502 /* Drive CPU */ && !c64->floppy.getBitAccuracy()) {
+            if (chipModel == MOS_6502 /* Drive CPU */ && !floppy->getBitAccuracy()) {
                 
                 // Special handling for the VC1541 CPU. Taken from Frodo
-                if (!((c64->floppy.via2.io[12] & 0x0E) == 0x0E || getV())) {
+                if (!((floppy->via2.io[12] & 0x0E) == 0x0E || getV())) {
                     CONTINUE
                 } else {
                     DONE
@@ -1567,10 +1572,10 @@ CPU::executeMicroInstruction()
             READ_IMMEDIATE
             POLL_INT
             
-            if (chipModel == MOS_6502 /* Drive CPU */ && !c64->floppy.getBitAccuracy()) {
+            if (chipModel == MOS_6502 /* Drive CPU */ && !floppy->getBitAccuracy()) {
                 
                 // Special handling for the VC1541 CPU. Taken from Frodo
-                if ((c64->floppy.via2.io[12] & 0x0E) == 0x0E || getV()) {
+                if ((floppy->via2.io[12] & 0x0E) == 0x0E || getV()) {
                     CONTINUE
                 } else {
                     DONE
@@ -22,6 +22,9 @@ const uint8_t
 NIBArchive::magicBytes[] = { /* "MNIB-1541-RAW" */
     0x4d, 0x4e, 0x49, 0x42, 0x2d, 0x31, 0x35, 0x34, 0x31, 0x2d, 0x52, 0x41, 0x57, 0x00 };
 
+unsigned
+NIBArchive::scanThreads = 0;
+
 NIBArchive::NIBArchive()
 {
     setDescription("NIBArchive");
@@ -116,125 +119,328 @@ NIBArchive::archiveFromNIBFile(const char *filename)
 }
 */
 
-bool
-NIBArchive::scan()
+// ---------------------------------------------------------------------------------------------
+//                                  Packed bit streams
+// ---------------------------------------------------------------------------------------------
+
+//! @brief    Number of bits in a raw NIB track
+static const unsigned rawTrackBits = 8 * 0x2000;
+
+//! @brief    Number of 64 bit words holding a raw NIB track, including the padding word
+static const unsigned rawTrackWords = rawTrackBits / 64 + 1;
+
+//! @brief    Number of 64 bit words holding two copies of a track, including the padding word
+static const unsigned doubleTrackWords = 2 * 8 * MAX_TRACK_LENGTH / 64 + 2;
+
+//! @brief    Reads 64 bits starting at an arbitrary bit offset
+static inline uint64_t
+readWord(const uint64_t *bits, unsigned offset)
 {
-    uint8_t bits[8 * 0x2000];
-    int start, end, gap;
+    unsigned shift = offset % 64;
+    const uint64_t *ptr = bits + offset / 64;
     
-    // Iterate through all header entries
-    unsigned i, item;
-    for (i = 0x10, item = 0; i < 0x100; i += 2, item++) {
+    return shift ? (ptr[0] << shift) | (ptr[1] >> (64 - shift)) : ptr[0];
+}
+
+/*! @brief    Appends the n most significant bits of a word to a bit stream
+ *  @details  The remaining bits of the word must be 0. The bit stream must be zeroed out.
+ */
+static inline void
+appendBits(uint64_t *bits, unsigned *pos, uint64_t word, unsigned n)
+{
+    unsigned shift = *pos % 64;
+    uint64_t *ptr = bits + *pos / 64;
+    
+    ptr[0] |= word >> shift;
+    if (shift + n > 64) ptr[1] |= word << (64 - shift);
+    *pos += n;
+}
+
+//! @brief    Returns a mask selecting the n most significant bits of a word
+static inline uint64_t
+leadingMask(unsigned n)
+{
+    return n ? ~0ULL << (64 - n) : 0;
+}
+
+//! @brief    Checks if two sections of a bit stream are equal
+static bool
+compareBits(const uint64_t *bits, unsigned pos1, unsigned pos2, unsigned n)
+{
+    unsigned i;
+    for (i = 0; i + 64 <= n; i += 64) {
+        if (readWord(bits, pos1 + i) != readWord(bits, pos2 + i))
+            return false;
+    }
+    return ((readWord(bits, pos1 + i) ^ readWord(bits, pos2 + i)) & leadingMask(n - i)) == 0;
+}
+
+//! @brief    Returns the number of consecutive '1's at the beginning of a word
+static inline unsigned
+leadingOnes(uint64_t word)
+{
+    unsigned n;
+    for (n = 0; n < 64 && (word & (0x8000000000000000ULL >> n)); n++);
+    return n;
+}
+
+//! @brief    Checks if a word contains a sequence of n consecutive '1's
+static inline bool
+containsOnes(uint64_t word, unsigned n)
+{
+    uint64_t result = word;
+    for (unsigned i = 1; i < n; i++)
+        result &= word << i;
+    return result != 0;
+}
+
+//! @brief    Returns the number of consecutive '1's at the end of a word
+static inline unsigned
+trailingOnes(uint64_t word)
+{
+    unsigned n;
+    for (n = 0; n < 64 && (word & (1ULL << n)); n++);
+    return n;
+}
+
+/*! @brief    Searches 64 positions of a bit stream for a bit pattern at once
+ *  @details  Bit i of the result is set iff the n most significant bits of the pattern
+ *            show up at position offset + i. The pattern may continue into the next word.
+ */
+static inline uint64_t
+findPattern(const uint64_t *bits, unsigned offset, uint64_t pattern, unsigned n)
+{
+    uint64_t result = ~0ULL;
+    for (unsigned i = 0; i < n; i++) {
+        uint64_t word = readWord(bits, offset + i);
+        result &= (pattern & (0x8000000000000000ULL >> i)) ? word : ~word;
+    }
+    return result;
+}
+
+/*! @brief    Shortens all SYNC sequences of a raw track to 10 bits
+ *  @details  Beware that the length of the SYNC sequences may differ in the repeated bit sequence.
+ *            Therefore, the loop is searched for in a stripped version of the bit stream where
+ *            all SYNC sequences are of the same size. Words without SYNC sequences are copied
+ *            as a whole.
+ *  @param    raw       The raw track data
+ *  @param    stripped  The stripped bit stream (NULL if the bits are only counted)
+ *  @param    limit     Stops after this number of bits has been written into stripped
+ *  @param    count     Number of bits written into stripped
+ *  @return   Number of processed bits of the raw track.
+ */
+static unsigned
+stripSyncMarks(const uint64_t *raw, uint64_t *stripped, unsigned limit, unsigned *count)
+{
+    unsigned pos = 0, written = 0, ones = 0;
+    
+    while (pos < rawTrackBits && written < limit) {
         
-        // Does item no 'item' exist in NIB file? 
-        if (data[i] < 2 || data[i] > 83)
+        uint64_t word = raw[pos / 64];
+        unsigned lead = leadingOnes(word);
+        
+        // Fast path: No part of the word belongs to a SYNC sequence
+        if (written + 64 <= limit && (lead == 0 || ones + lead <= 10) && !containsOnes(word, 11)) {
+            
+            if (stripped) appendBits(stripped, &written, word, 64); else written += 64;
+            ones = trailingOnes(word);
+            pos += 64;
             continue;
-        unsigned ht = data[i] + 1;
+        }
         
-        // Convert byte stream into a bit stream
-        unsigned j, startOfTrack = 0x100 + item * 0x2000;
-        for (j = 0; j < sizeof(bits); j++) {
-            bits[j] = (data[startOfTrack + j/8] << (j%8)) & 0x80 ? 1 : 0;
+        // Slow path: Process the word bit by bit
+        for (unsigned i = 0; i < 64 && written < limit; i++, pos++) {
+            
+            uint64_t bit = (word >> (63 - i)) & 1;
+            ones = bit ? ones + 1 : 0;
+            if (ones <= 10) {
+                if (stripped) appendBits(stripped, &written, bit << 63, 1); else written++;
+            }
         }
+    }
+    
+    *count = written;
+    return pos;
+}
+
+//! @brief    Work shared by the worker threads of NIBArchive::scan()
+typedef struct {
+    
+    NIBArchive *archive;
+    
+    //! @brief    Halftracks to scan and the location of their raw data
+    unsigned halftracks[85];
+    const uint8_t *raw[85];
+    unsigned count;
+    
+    //! @brief    Index of the next halftrack to scan
+    unsigned next;
+    pthread_mutex_t lock;
+    
+} ScanJob;
+
+//! @brief    Worker thread of NIBArchive::scan()
+static void *
+scanWorker(void *arg)
+{
+    ScanJob *job = (ScanJob *)arg;
+    
+    while (true) {
         
-        // Determine track bounds and alignment offset
-        if (!scanTrack(ht, bits, &start, &end, &gap))
-            continue;
+        pthread_mutex_lock(&job->lock);
+        unsigned index = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        
+        if (index >= job->count)
+            break;
+        
+        job->archive->scanTrack(job->halftracks[index], job->raw[index]);
+    }
+    
+    return NULL;
+}
+
+bool
+NIBArchive::scan(unsigned threads)
+{
+    ScanJob job;
+    int item[85];
+    
+    // Iterate through all header entries. If a halftrack shows up twice, the last entry wins.
+    for (unsigned ht = 0; ht < 85; ht++)
+        item[ht] = -1;
+    for (unsigned i = 0x10, nr = 0; i < 0x100; i += 2, nr++) {
         
-        // Copy track data into destination buffer
-        printf("Halftrack: %d Start: %d End: %d Length: %x Gap: %x\n",
-                   ht, start, end, (end - start) / 8, gap / 8);
-        length[ht] = end - start;
-        size_t len1 = length[ht] - gap;
-        size_t len2 = gap;
-        memcpy(halftrack[ht], bits + start + gap, len1);
-        memcpy(halftrack[ht] + len1, bits + start, len2);
+        // Does item no 'nr' exist in NIB file?
+        if (data[i] < 2 || data[i] > 83)
+            continue;
+        if (0x100 + (nr + 1) * 0x2000 > size) {
+            warn("Halftrack %d is missing in NIB file.\n", data[i] + 1);
+            continue;
+        }
+        item[data[i] + 1] = nr;
     }
     
+    job.archive = this;
+    job.count = 0;
+    job.next = 0;
     for (unsigned ht = 1; ht <= 84; ht++) {
-        printf("Halftrack %02d: ", ht);
-        for (unsigned b = 0; b < 64; b++) printf("%d", halftrack[ht][b]);
-        printf(" Length: %d\n", length[ht]);
+        if (item[ht] >= 0) {
+            job.halftracks[job.count] = ht;
+            job.raw[job.count] = data + 0x100 + item[ht] * 0x2000;
+            job.count++;
+        }
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (unsigned)cores : 1;
+    }
+    if (threads > job.count) {
+        threads = job.count;
     }
     
+    // The calling thread is one of the workers
+    pthread_t *workers = new pthread_t[threads];
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, scanWorker, &job) == 0)
+            started++;
+    }
+    scanWorker(&job);
+    
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    
+    delete[] workers;
+    pthread_mutex_destroy(&job.lock);
     return true;
 }
 
 bool
-NIBArchive::scanTrack(unsigned ht, uint8_t *bits, int *start, int *end, int *gap)
+NIBArchive::scanTrack(unsigned ht, const uint8_t *raw)
 {
+    uint64_t bits[rawTrackWords], doubled[doubleTrackWords];
+    unsigned end, gap, pos;
+    
+    assert(ht >= 1 && ht <= 84);
+    
+    // Pack the raw track into 64 bit words
+    for (unsigned i = 0; i < rawTrackWords - 1; i++) {
+        bits[i] = 0;
+        for (unsigned j = 0; j < 8; j++)
+            bits[i] = (bits[i] << 8) | raw[8 * i + j];
+    }
+    bits[rawTrackWords - 1] = 0;
+    
     // Find loop
-    if (!scanForLoop(bits, sizeof(bits), start, end)) {
-        printf("Halftrack: %d LOOP DETECTION FAILED.\n", ht);
+    if (!scanForLoop(bits, &end)) {
+        warn("Halftrack: %d LOOP DETECTION FAILED.\n", ht);
         return false;
     }
     
     // Find gap (for track alignment)
-    return scanForGap(bits + *start, *end - *start, gap);
+    memset(doubled, 0, sizeof(doubled));
+    for (pos = 0; pos < 2 * end; ) {
+        unsigned offset = pos % end, n = MIN(64, end - offset);
+        appendBits(doubled, &pos, readWord(bits, offset) & leadingMask(n), n);
+    }
+    gap = scanForGap(doubled, end);
+    
+    // Copy track data into destination buffer, starting at the gap
+    debug(2, "Halftrack: %d Start: 0 End: %d Length: %x Gap: %x\n", ht, end, end / 8, gap / 8);
+    length[ht] = end;
+    memset(halftrack[ht], 0, sizeof(halftrack[ht]));
+    for (unsigned i = 0; i < end; i += 8) {
+        halftrack[ht][i / 8] = (uint8_t)((readWord(doubled, gap + i) & leadingMask(MIN(8, end - i))) >> 56);
+    }
+    
+    return true;
 }
 
 bool
-NIBArchive::scanForLoop(uint8_t *bits, int length, int *start, int *end)
-{
-    uint8_t stripped[8 * 0x2000];  // Bit stream with shortened SYNC sequences
-    int index[8 * 0x2000];         // Index mapping from stripped bits to unstripped bits
-    int length_stripped;           // Number of bits in shortened sequence
-
-    // Beware that the length of the SYNC sequences may differ in the repeated bit sequence.
-    // Therefore, we perform the matching operation with a copy of the original bit stream.
-    // The copy is a stripped version where all SYNC sequences are of the same size.
-    //
-    // The code below creates the following data structures:
-    //
-    // i:           0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25
-    // bits[i]:     0  0  1  0  1  1  1  1  1  1  1  1  1  1  1  1  1  1  1  1  0  0  1  0  1  1
-    // stripped[i]: 0  0  1  0  1  1  1  1  1  1  1  1  1  1  1  1  1  1  0  0  1  0  1  1  ?  ?
-    // index:       0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 16 17 20 21 22 23 24 25 ?? ??
-    // length:     24
-
-    int idx, onecnt; uint8_t bit;
-    for (length_stripped = idx = onecnt = 0; idx < 8 * 0x2000; idx++) {
-        
-        // Read bit from raw data stream and count consecutive '1's
-        bit = bits[idx];
-        onecnt = bit ? onecnt + 1 : 0;
-        if (onecnt <= 10) {
-            stripped[length_stripped] = bit;
-            index[length_stripped] = idx;
-            length_stripped++;
-        }
-    }
-
-    // Now we are ready to search for the loop
+NIBArchive::scanForLoop(const uint64_t *bits, unsigned *end)
+{
+    uint64_t stripped[rawTrackWords];
+    unsigned length;
+    
+    // Shorten all SYNC sequences to the same size
+    memset(stripped, 0, sizeof(stripped));
+    stripSyncMarks(bits, stripped, rawTrackBits, &length);
     
-    int pos1, pos2, tracklength;
-    for (pos1 = 0, pos2 = 1; pos2 < length_stripped - 1024 /* minimum matching size */; pos2++) {
-        if (memcmp(stripped+pos1, stripped+pos2, length_stripped-pos2) == 0) {
+    // Now we are ready to search for the loop. Candidates are determined for 64 positions
+    // at once by searching for the first 16 bits. Most of them are sorted out by comparing
+    // the first 64 bits, before the remaining bits are compared.
+    uint64_t first = stripped[0];
+    for (unsigned block = 0; block < length; block += 64) {
+        
+        uint64_t candidates = findPattern(stripped, block, first, 16);
+        if (block == 0) candidates &= ~0x8000000000000000ULL;
+        
+        for (unsigned pos = block; candidates; pos++, candidates <<= 1) {
             
-            *start = index[pos1];
-            *end = index[pos2];
-            tracklength = *end - *start;
+            if (pos + 1024 /* minimum matching size */ >= length)
+                return false;
+            if (!(candidates & 0x8000000000000000ULL))
+                continue;
+            if (readWord(stripped, pos) != first || !compareBits(stripped, 0, pos, length - pos))
+                continue;
             
-            /*
-            printf("Match found at (%d,%d)\n", pos1, pos2);
-            for (unsigned k = 0; k < 30; k++)
-                printf("%d", bits[pos1+k]);
-            printf("\n");
-            for (unsigned k = 0; k < 30; k++)
-                printf("%d", bits[pos2+k]);
-            printf("\n");
-            */
+            // Map the stripped position back to the raw bit stream
+            unsigned count;
+            *end = stripSyncMarks(bits, NULL, pos + 1, &count) - 1;
             
             // Check loop bounds
-            if (tracklength < 8 * MIN_TRACK_LENGTH) {
-                printf("Warning: Track is too short (%d bits). Discarding.\n", tracklength);
+            if (*end < 8 * MIN_TRACK_LENGTH) {
+                warn("Track is too short (%d bits). Discarding.\n", *end);
                 return false;
             }
-            if (tracklength > 8 * MAX_TRACK_LENGTH) {
-                printf("Halftrack: Track is too long (%d bits). Discarding.\n", tracklength);
+            if (*end > 8 * MAX_TRACK_LENGTH) {
+                warn("Halftrack: Track is too long (%d bits). Discarding.\n", *end);
                 return false;
             }
-
+            
             return true;
         }
     }
@@ -242,56 +448,60 @@ NIBArchive::scanForLoop(uint8_t *bits, int length, int *start, int *end)
     return false;
 }
 
-bool
-NIBArchive::scanForGap(uint8_t *bits, int length, int *gap)
-{
-    uint8_t tmpbuf[2 * 8 * 0x2000];
-    int nonsync[2 * 8 * 0x2000];
-    int i, onecnt, gapsize;
-    
-    // Setup double buffer
-    assert(2 * length <= sizeof(tmpbuf));
-    memcpy(tmpbuf, bits, length);
-    memcpy(tmpbuf + length, bits, length);
-    
-    // Count number of bits after SYNC sequences
-    // i:           0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25
-    // tmpbuf[i]:   0  0  1  0  1  1  1  1  1  1  1  1  1  1  1  1  1  1  1  1  0  0  1  0  1  1
-    // nonsync[i]: 77 78 79 80  0  0  0  0  0  0  0  0  0  0  0  0  0  0  0  0  1  2  3  4  5  6
-    for (nonsync[0] = onecnt = 0, i = 1; i < 2 * length; i++) {
-
-        onecnt = tmpbuf[i] ? onecnt + 1 : 0;
-        if (onecnt >= 10) {
-            for (unsigned j = 0; j < 10; j++) nonsync[i - j] = 0;
-        } else {
-            nonsync[i] = nonsync[i - 1] + 1;
+unsigned
+NIBArchive::scanForGap(const uint64_t *bits, unsigned length)
+{
+    unsigned gap = 0, gapsize = 0;
+    
+    // The gap is placed behind the longest sequence of bits between two SYNC sequences.
+    // Each SYNC sequence is a run of at least 10 '1's. The sequence [syncStart; syncEnd]
+    // is extended as long as new runs of 10 '1's start inside or right behind it.
+    bool inSync = false;
+    unsigned syncEnd = 0, lastSyncEnd = 0;
+    
+    for (unsigned w = 0; w < (2 * length + 63) / 64; w++) {
+        
+        uint64_t starts = findPattern(bits, 64 * w, ~0ULL, 10);
+        
+        // As in the original bit-wise scan, the first bit never starts a SYNC sequence
+        if (w == 0) starts &= ~0x8000000000000000ULL;
+        
+        for (unsigned b = 0; starts; b++, starts <<= 1) {
+            
+            if (!(starts & 0x8000000000000000ULL))
+                continue;
+            
+            unsigned pos = 64 * w + b;
+            if (inSync && pos <= syncEnd + 1) {
+                syncEnd = pos + 9;
+                continue;
+            }
+            if (inSync)
+                lastSyncEnd = syncEnd;
+            
+            // The area in front of the new SYNC sequence ends at pos - 1
+            if (pos > 0 && pos - 1 - lastSyncEnd > gapsize) {
+                gapsize = pos - 1 - lastSyncEnd;
+                gap = (pos - 1) % length + 1;
+            }
+            inSync = true;
+            syncEnd = pos + 9;
         }
     }
-    /*
-    for (unsigned k = 135; k < 190; k++) {
-        printf("%2d ", bits[k]);
-    }
-    printf("\n");
-    for (unsigned k = 135; k < 190; k++) {
-        printf("%2d ", nonsync[k] % 99);
-    }
-    printf("\n");
-    */
-    
-    // Search for biggest gap
-    for (i = gapsize = 0; i < 2 * length; i++) {
-        if (gapsize < nonsync[i]) {
-            *gap = (i % length) + 1;
-            gapsize = nonsync[i];
-        }
+    if (inSync)
+        lastSyncEnd = syncEnd;
+    
+    // The area behind the last SYNC sequence ends with the stream
+    if (2 * length - 1 > lastSyncEnd && 2 * length - 1 - lastSyncEnd > gapsize) {
+        gap = (2 * length - 1) % length + 1;
     }
-
-    return true;
+    
+    return gap;
 }
 
 void NIBArchive::dealloc()
 {
-	if (data) free(data);
+	releaseBuffer(data);
 	data = NULL;
 	size = 0;
 	fp = -1;
@@ -306,14 +516,13 @@ NIBArchive::hasSameType(const char *filename)
 bool 
 NIBArchive::readFromBuffer(const uint8_t *buffer, size_t length)
 {	
-	if ((data = (uint8_t *)malloc(length)) == NULL)
+	if ((data = adoptBuffer(buffer, length)) == NULL)
 		return false;
 
-	memcpy(data, buffer, length);
 	size = length;
 
     // Scan raw data for tracks
-    scan();
+    scan(scanThreads);
     
 	return true;
 }
@@ -406,14 +615,10 @@ NIBArchive::getByte()
 	if (fp < 0)
 		return -1;
 		
-	int result = (halftrack[selectedtrack][fp++] << 7);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 6);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 5);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 4);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 3);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 2);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 1);
-    if (fp < length[selectedtrack]) result |= (halftrack[selectedtrack][fp++] << 0); else fp = -1;
+	// Bits beyond the end of the track are 0
+	int result = halftrack[selectedtrack][fp / 8];
+    fp += 8;
+    if (fp >= length[selectedtrack]) fp = -1;
     
 	return result;
 }
@@ -34,14 +34,19 @@ private:
     //! @brief    Header signature
     static const uint8_t magicBytes[];
     
+    /*! @brief    Number of worker threads scanning the tracks of a newly read archive
+     *  @see      setScanThreads
+     */
+    static unsigned scanThreads;
+    
     //! @brief    Raw data of this archive
     uint8_t *data;
 
     //! @brief    Size of NIB file
     size_t size;
 
-    //! @brief    Decoded track data
-    uint8_t halftrack[85][8 * MAX_TRACK_LENGTH];
+    //! @brief    Decoded track data (8 bits per byte, most significant bit first)
+    uint8_t halftrack[85][MAX_TRACK_LENGTH];
 
     /*! @brief    Decoded track length in bits
      *  @details  Equals 0 if halftrack is not contained in archive */
@@ -83,44 +88,51 @@ public:
     // static NIBArchive *archiveFromNIBFile(const char *filename);
     
     /*! @brief    Scans all tracks in archive
+     *  @details  The tracks are scanned in parallel.
+     *  @param    threads  Number of worker threads (0 = one per CPU core)
      *  @return   true, if the scan was successful, false, if archive data is corrupt
      *  @seealso  scanTrack
      */
-    bool scan();
+    bool scan(unsigned threads = 0);
+    
+    /*! @brief    Sets the number of worker threads used when an archive is read
+     *  @details  0 = one per CPU core (default). Applications reading many archives in
+     *            parallel should pass 1 to avoid spawning threads for each archive.
+     */
+    static void setScanThreads(unsigned threads) { scanThreads = threads; }
+
+    //! @brief    Returns the number of worker threads used when an archive is read
+    static unsigned getScanThreads() { return scanThreads; }
 
     /*! @brief    Scans a single track in archive
-     *  @details  For eack track, the number of bits is determined and stored in array numBits.
-     *            Furthermore, the total number of tracks is stored in variable numTracks.
+     *  @details  Determines the track bounds and the alignment offset and stores the aligned
+     *            track in halftrack[ht] and its length in bits in length[ht].
      *  @param    ht       Halftrack number
-     *  @param    bits     The raw bit stream
-     *  @param    start    Offset the the first bit of the loop
-     *  @param    end      Offset the last bit belonging to the loop + 1
-     *  @param    gap      Offset to the gap position
+     *  @param    raw      The raw track data as stored in the NIB file (0x2000 bytes)
      *  @return   true, if the scan was successful, false, if archive data is corrupt 
      */
-    bool scanTrack(unsigned ht, uint8_t *bits, int *start, int *end, int *gap);
+    bool scanTrack(unsigned ht, const uint8_t *raw);
     
     /*! @brief    Looks for a loop in the provided bit stream
      *  @details  A NIB file consists of 0x2000 bytes a nibbled data. As the nibbler cannot determine
      *            when the drive head has completed a full rotation, the bit stream data overlaps.
-     *            This method searches for the overlap. If the repeating code sequence has been found,
-     *            the start and the end position are stored in startBit and endBit, respectively.
+     *            This method searches for the overlap. The loop always starts at the first bit.
+     *            The bit stream is packed into 64 bit words, most significant bit first, and
+     *            followed by a zero padding word.
      *  @param    bits     The raw bit stream.
-     *  @param    length   Length of the provided bit stream
-     *  @param    start    Offset the the first bit of the loop
      *  @param    end      Offset the last bit belonging to the loop + 1
      *  @return   true if the repetition has been found.
      */
-    bool scanForLoop(uint8_t *bits, int length, int *start, int *end);
+    bool scanForLoop(const uint64_t *bits, unsigned *end);
 
     /*! @brief    Looks for the longest area between two SYNC marks
      *  @details  The computed offset is used to properly align the tracks next to each other.
-     *  @param    bits     The raw bit stream as stored in the NIB file.
-     *  @param    length   Length of the provided bit stream
-     *  @param    gap      Offset to the gap position
-     *  @return   true if a gap has been found, false otherwise. 
+     *  @param    bits     The track data, repeated twice and packed into 64 bit words,
+     *                     followed by a zero padding word.
+     *  @param    length   Length of the track in bits
+     *  @return   Offset to the gap position
      */
-    bool scanForGap(uint8_t *bits, int length, int *gap);
+    static unsigned scanForGap(const uint64_t *bits, unsigned length);
 
     
     //
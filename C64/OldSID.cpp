@@ -167,6 +167,12 @@ OldSID::saveToBuffer(uint8_t **buffer)
 		write8(buffer, iomem[i]);
 }
 
+uint64_t
+OldSID::stateHash()
+{
+	return hashBlock(iomem, sizeof(iomem), 0);
+}
+
 uint8_t 
 OldSID::peek(uint16_t addr)
 {	
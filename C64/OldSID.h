@@ -227,6 +227,9 @@ public:
 	//! Save state
 	void saveToBuffer(uint8_t **buffer);	
 	
+	//! Compute hash over state
+	uint64_t stateHash();
+	
 	//! Dump internal state to console
 	void dumpState();
 	
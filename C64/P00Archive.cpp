@@ -127,7 +127,7 @@ P00Archive::isP00File(const char *filename)
 void 
 P00Archive::dealloc()
 {
-	if (data) free(data);
+	releaseBuffer(data);
 	data = NULL;
 	size = 0;
 	fp = -1;
@@ -154,10 +154,9 @@ P00Archive::hasSameType(const char *filename)
 bool 
 P00Archive::readFromBuffer(const uint8_t *buffer, size_t length)
 {
-	if ((data = (uint8_t *)malloc(length)) == NULL)
+	if ((data = adoptBuffer(buffer, length)) == NULL)
 		return false;
-		
-	memcpy(data, buffer, length);
+
 	size = length;
 	
 	return true;
@@ -111,7 +111,7 @@ PRGArchive::isPRGFile(const char *filename)
 void 
 PRGArchive::dealloc()
 {
-	if (data) free(data);
+	releaseBuffer(data);
 	data = NULL;
 	size = 0;
 	fp = -1;
@@ -126,10 +126,9 @@ PRGArchive::hasSameType(const char *filename)
 bool 
 PRGArchive::readFromBuffer(const uint8_t *buffer, size_t length)
 {	
-	if ((data = (uint8_t *)malloc(length)) == NULL)
+	if ((data = adoptBuffer(buffer, length)) == NULL)
 		return false;
 
-	memcpy(data, buffer, length);
 	size = length;
 	    
 	return true;
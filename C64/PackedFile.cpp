@@ -0,0 +1,381 @@
+/*!
+ * @header      PackedFile.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "PackedFile.h"
+#include "Inflater.h"
+
+static inline uint16_t
+read16(const uint8_t *ptr)
+{
+    return ptr[0] | ptr[1] << 8;
+}
+
+static inline uint32_t
+read32(const uint8_t *ptr)
+{
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+}
+
+//! @brief    Returns the position of the '#' separating a zip archive from a member (or NULL)
+static const char *
+findMemberSeparator(const char *path)
+{
+    for (const char *pos = strchr(path, '#'); pos; pos = strchr(pos + 1, '#')) {
+        if (pos - path >= 4 && strncasecmp(pos - 4, ".zip", 4) == 0)
+            return pos;
+    }
+    return NULL;
+}
+
+static bool
+hasSuffix(const char *path, const char *suffix)
+{
+    size_t len = strlen(path), suffixLen = strlen(suffix);
+    return len > suffixLen && strcasecmp(path + len - suffixLen, suffix) == 0;
+}
+
+PackedFile::PackedFile()
+{
+    setDescription("PackedFile");
+
+    data = NULL;
+    size = 0;
+    gzip = false;
+    members = NULL;
+    numMembers = 0;
+    selected = -1;
+}
+
+PackedFile::~PackedFile()
+{
+    for (unsigned i = 0; i < numMembers; i++)
+        free(members[i].name);
+    free(members);
+
+    if (data)
+        munmap(data, size);
+}
+
+bool
+PackedFile::isPackedPath(const char *path)
+{
+    assert(path != NULL);
+
+    return hasSuffix(path, ".gz") || findMemberSeparator(path) != NULL;
+}
+
+bool
+PackedFile::isZipPath(const char *path)
+{
+    assert(path != NULL);
+
+    return hasSuffix(path, ".zip") && findMemberSeparator(path) == NULL;
+}
+
+char *
+PackedFile::getUnpackedPath(const char *path)
+{
+    assert(path != NULL);
+
+    const char *separator = findMemberSeparator(path);
+
+    if (separator)
+        return strdup(separator + 1);
+    if (hasSuffix(path, ".gz"))
+        return strndup(path, strlen(path) - 3);
+
+    return strdup(path);
+}
+
+char *
+PackedFile::getFilePath(const char *path)
+{
+    assert(path != NULL);
+
+    const char *separator = findMemberSeparator(path);
+    return separator ? strndup(path, separator - path) : strdup(path);
+}
+
+char *
+PackedFile::makeMemberPath(const char *path, const char *member)
+{
+    assert(path != NULL);
+    assert(member != NULL);
+
+    char *result = (char *)malloc(strlen(path) + strlen(member) + 2);
+    sprintf(result, "%s#%s", path, member);
+    return result;
+}
+
+PackedFile *
+PackedFile::makePackedFileWithPath(const char *path)
+{
+    assert(path != NULL);
+
+    PackedFile *packed = new PackedFile();
+    const char *separator = findMemberSeparator(path);
+    char *filename = getFilePath(path);
+    struct stat fileProperties;
+    bool success = false;
+    int fd;
+
+    // Map the file into memory
+    if ((fd = open(filename, O_RDONLY)) >= 0) {
+
+        if (fstat(fd, &fileProperties) == 0 && fileProperties.st_size > 0) {
+
+            void *buffer = mmap(NULL, fileProperties.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (buffer != MAP_FAILED) {
+                packed->data = (uint8_t *)buffer;
+                packed->size = fileProperties.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    if (packed->data == NULL) {
+        // File does not exist
+    } else if (packed->size >= 18 && packed->data[0] == 0x1F && packed->data[1] == 0x8B) {
+        packed->gzip = true;
+        packed->selected = 0;
+        success = !separator && packed->parseGzip(filename);
+    } else if (packed->parseZip()) {
+        packed->selected = separator ? packed->findMember(separator + 1) : -1;
+        success = !separator || packed->selected >= 0;
+    }
+
+    free(filename);
+
+    if (!success) {
+        delete packed;
+        return NULL;
+    }
+    return packed;
+}
+
+void
+PackedFile::addMember(const char *name, size_t nameLength, size_t offset, size_t compressedSize,
+                      size_t size, uint16_t method, uint32_t crc)
+{
+    if ((numMembers & (numMembers - 1)) == 0) {
+        members = (Member *)realloc(members, sizeof(Member) * (numMembers ? 2 * numMembers : 1));
+    }
+
+    Member *member = &members[numMembers++];
+    member->name = strndup(name, nameLength);
+    member->offset = offset;
+    member->compressedSize = compressedSize;
+    member->size = size;
+    member->method = method;
+    member->crc = crc;
+}
+
+bool
+PackedFile::parseGzip(const char *path)
+{
+    uint8_t flags = data[3];
+    size_t pos = 10;
+
+    if (data[2] != 8 /* deflated */) {
+        warn("Unsupported gzip compression method %d\n", data[2]);
+        return false;
+    }
+
+    // Skip the optional header fields
+    if (flags & 0x04) { // FEXTRA
+        pos += 2 + (pos + 2 <= size ? read16(data + pos) : 0);
+    }
+    if (flags & 0x08) { // FNAME
+        while (pos < size && data[pos]) pos++;
+        pos++;
+    }
+    if (flags & 0x10) { // FCOMMENT
+        while (pos < size && data[pos]) pos++;
+        pos++;
+    }
+    if (flags & 0x02) { // FHCRC
+        pos += 2;
+    }
+    if (pos + 8 > size) {
+        warn("Corrupted gzip file\n");
+        return false;
+    }
+
+    // The trailer stores the checksum and the size of the decompressed data
+    char *unpacked = getUnpackedPath(path);
+    char *name = ExtractFilename(unpacked);
+    addMember(name, strlen(name), pos, size - 8 - pos, read32(data + size - 4), 8, read32(data + size - 8));
+    free(name);
+    free(unpacked);
+
+    return true;
+}
+
+bool
+PackedFile::parseZip()
+{
+    const uint8_t *eocd = NULL;
+
+    // Locate the end of central directory record (followed by a comment of up to 64 KB)
+    if (size < 22)
+        return false;
+    for (size_t pos = size - 22; ; pos--) {
+        if (read32(data + pos) == 0x06054B50) {
+            eocd = data + pos;
+            break;
+        }
+        if (pos == 0 || size - pos >= 22 + 0xFFFF)
+            break;
+    }
+    if (eocd == NULL)
+        return false;
+
+    unsigned entries = read16(eocd + 10);
+    size_t pos = read32(eocd + 16);
+
+    for (unsigned i = 0; i < entries; i++) {
+
+        if (pos + 46 > size || read32(data + pos) != 0x02014B50) {
+            warn("Corrupted zip file\n");
+            return false;
+        }
+
+        const uint8_t *entry = data + pos;
+        uint16_t flags = read16(entry + 8);
+        uint16_t method = read16(entry + 10);
+        uint32_t crc = read32(entry + 16);
+        uint32_t compressedSize = read32(entry + 20);
+        uint32_t uncompressedSize = read32(entry + 24);
+        uint16_t nameLength = read16(entry + 28);
+        size_t next = pos + 46 + nameLength + read16(entry + 30) + read16(entry + 32);
+        const char *name = (const char *)entry + 46;
+
+        if (next > size) {
+            warn("Corrupted zip file\n");
+            return false;
+        }
+
+        // Skip directories and members that cannot be decompressed
+        if (nameLength == 0 || name[nameLength - 1] == '/') {
+            // Directory
+        } else if ((flags & 0x01) || (method != 0 && method != 8) || uncompressedSize == 0xFFFFFFFF) {
+            debug(2, "Skipping zip member %.*s (encrypted, ZIP64, or unsupported method)\n", nameLength, name);
+        } else {
+            addMember(name, nameLength, read32(entry + 42), compressedSize, uncompressedSize, method, crc);
+        }
+        pos = next;
+    }
+
+    return true;
+}
+
+int
+PackedFile::findMember(const char *name)
+{
+    assert(name != NULL);
+
+    for (unsigned i = 0; i < numMembers; i++) {
+        if (strcmp(members[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const uint8_t *
+PackedFile::getCompressedData(unsigned n)
+{
+    if (n >= numMembers)
+        return NULL;
+
+    Member *member = &members[n];
+    size_t pos = member->offset;
+
+    // Skip the local file header of a zip member
+    if (!gzip) {
+        if (pos + 30 > size || read32(data + pos) != 0x04034B50)
+            return NULL;
+        pos += 30 + read16(data + pos + 26) + read16(data + pos + 28);
+    }
+
+    if (pos > size || member->compressedSize > size - pos)
+        return NULL;
+
+    return data + pos;
+}
+
+bool
+PackedFile::extractMember(unsigned n, uint8_t *buffer, size_t length)
+{
+    assert(buffer != NULL);
+
+    const uint8_t *src = getCompressedData(n);
+    size_t written = 0;
+
+    if (src == NULL) {
+        warn("Cannot extract %s\n", getNameOfMember(n));
+        return false;
+    }
+    if (length > members[n].size) {
+        return false;
+    }
+
+    Member *member = &members[n];
+    if (member->method == 0) {
+        if (member->compressedSize < length)
+            return false;
+        memcpy(buffer, src, length);
+        written = length;
+    } else if (!Inflater::inflate(src, member->compressedSize, buffer, length, &written)) {
+        warn("Corrupted compressed data in %s\n", member->name);
+        return false;
+    }
+
+    if (written != length)
+        return false;
+
+    // Verify the checksum if the whole member has been decompressed
+    if (length == member->size && Inflater::crc32(buffer, length) != member->crc) {
+        warn("Checksum error in %s\n", member->name);
+        return false;
+    }
+    return true;
+}
+
+uint8_t *
+PackedFile::mapMember(unsigned n, size_t *length)
+{
+    assert(length != NULL);
+
+    if (n >= numMembers || members[n].size == 0)
+        return NULL;
+
+    size_t memberSize = members[n].size;
+    void *buffer = mmap(NULL, memberSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (buffer == MAP_FAILED)
+        return NULL;
+
+    if (!extractMember(n, (uint8_t *)buffer, memberSize)) {
+        munmap(buffer, memberSize);
+        return NULL;
+    }
+
+    *length = memberSize;
+    return (uint8_t *)buffer;
+}
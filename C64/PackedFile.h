@@ -0,0 +1,174 @@
+/*!
+ * @header      PackedFile.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _PACKEDFILE_INC
+#define _PACKEDFILE_INC
+
+#include "VC64Object.h"
+
+/*! @class    PackedFile
+ *  @brief    Read access to gzip files and zip archives
+ *  @details  A packed file is memory-mapped and consists of one or more members. A gzip
+ *            file has a single member. A zip archive has a member for each file stored
+ *            inside. Members are decompressed on demand, either completely or partially.
+ *            Only the central directory is read when a zip archive is opened.
+ *
+ *            Packed files are addressed by paths, so that they can be used wherever an
+ *            ordinary file is expected:
+ *
+ *            "game.d64.gz" refers to the (only) member of a gzip file.
+ *            "games.zip#disks/game.d64" refers to a member of a zip archive.
+ *
+ *            The helper functions in basic.h and Container::readFromFile() resolve these
+ *            paths. Hence, all container types can be read from packed files without
+ *            any further changes.
+ */
+class PackedFile : public VC64Object {
+
+private:
+
+    //! @brief    A compressed file stored inside a packed file
+    typedef struct {
+
+        //! @brief    Name of the member (including the directory inside a zip archive)
+        char *name;
+
+        //! @brief    Offset of the local file header (zip) or the compressed data (gzip)
+        size_t offset;
+
+        //! @brief    Size of the compressed data
+        size_t compressedSize;
+
+        //! @brief    Size of the decompressed data
+        size_t size;
+
+        //! @brief    Compression method (0 = stored, 8 = deflated)
+        uint16_t method;
+
+        //! @brief    CRC-32 checksum of the decompressed data
+        uint32_t crc;
+
+    } Member;
+
+    //! @brief    Memory-mapped file contents
+    uint8_t *data;
+
+    //! @brief    Size of the file in bytes
+    size_t size;
+
+    //! @brief    Indicates whether the file is a gzip file (otherwise, it is a zip archive)
+    bool gzip;
+
+    //! @brief    List of all members
+    Member *members;
+    unsigned numMembers;
+
+    //! @brief    Member the path refers to (-1 if the path refers to a zip archive as a whole)
+    int selected;
+
+    //! @brief    Adds a member to the list of all members
+    void addMember(const char *name, size_t nameLength, size_t offset, size_t compressedSize,
+                   size_t size, uint16_t method, uint32_t crc);
+
+    //! @brief    Reads the header and trailer of a gzip file
+    bool parseGzip(const char *path);
+
+    //! @brief    Reads the central directory of a zip archive
+    bool parseZip();
+
+    //! @brief    Returns the location of the compressed data of a member (NULL if invalid)
+    const uint8_t *getCompressedData(unsigned n);
+
+public:
+
+    //! @brief    Constructor
+    PackedFile();
+
+    //! @brief    Destructor
+    ~PackedFile();
+
+    /*! @brief    Returns true iff the path refers to a gzip file or a member of a zip archive
+     *  @details  Only the path is checked. The file is not accessed.
+     */
+    static bool isPackedPath(const char *path);
+
+    //! @brief    Returns true iff the path refers to a zip archive as a whole
+    static bool isZipPath(const char *path);
+
+    /*! @brief    Returns the path of the decompressed file
+     *  @details  "game.d64.gz" is mapped to "game.d64" and "games.zip#disks/game.d64"
+     *            is mapped to "disks/game.d64". Other paths are returned unchanged.
+     *  @return   A newly allocated string. Free it with free().
+     */
+    static char *getUnpackedPath(const char *path);
+
+    /*! @brief    Returns the path of the file containing the data
+     *  @details  "games.zip#disks/game.d64" is mapped to "games.zip". Other paths are
+     *            returned unchanged.
+     *  @return   A newly allocated string. Free it with free().
+     */
+    static char *getFilePath(const char *path);
+
+    /*! @brief    Returns the path of a member of a zip archive
+     *  @return   A newly allocated string. Free it with free().
+     */
+    static char *makeMemberPath(const char *path, const char *member);
+
+    /*! @brief    Opens a gzip file, a zip archive, or a member of a zip archive
+     *  @return   NULL, if the file doesn't exist or is not a gzip or zip file.
+     */
+    static PackedFile *makePackedFileWithPath(const char *path);
+
+
+    //
+    //! @functiongroup Accessing members
+    //
+
+    //! @brief    Returns the number of members
+    unsigned getNumberOfMembers() { return numMembers; }
+
+    //! @brief    Returns the member the path refers to (-1 if it refers to a zip archive)
+    int getSelectedMember() { return selected; }
+
+    //! @brief    Returns the number of a member or -1 if no member has the given name
+    int findMember(const char *name);
+
+    //! @brief    Returns the name of a member
+    const char *getNameOfMember(unsigned n) { return n < numMembers ? members[n].name : NULL; }
+
+    //! @brief    Returns the size of a member after decompression
+    size_t getSizeOfMember(unsigned n) { return n < numMembers ? members[n].size : 0; }
+
+    /*! @brief    Decompresses a member
+     *  @details  If the buffer is smaller than the member, only the first bytes are
+     *            decompressed. Otherwise, the checksum is verified.
+     *  @return   true, if length bytes have been written into buffer.
+     */
+    bool extractMember(unsigned n, uint8_t *buffer, size_t length);
+
+    /*! @brief    Decompresses a member into an anonymous memory mapping
+     *  @details  The result can be used like a memory-mapped file. Hence, a container
+     *            can adopt the data without copying it. Free it with munmap().
+     *  @return   NULL, if the member cannot be decompressed.
+     */
+    uint8_t *mapMember(unsigned n, size_t *length);
+};
+
+#endif
@@ -29,6 +29,7 @@ PixelEngine::PixelEngine()
     currentScreenBuffer = screenBuffer1[0];
     pixelBuffer = currentScreenBuffer;
     bufferoffset = 0;
+    hideFrame = false;
 
     // Register snapshot items
     SnapshotItem items[] = {
@@ -144,9 +145,10 @@ PixelEngine::endRasterline()
 void
 PixelEngine::endFrame()
 {
-    // Switch active screen buffer
-    currentScreenBuffer = (currentScreenBuffer == screenBuffer1[0]) ? screenBuffer2[0] : screenBuffer1[0];
-    pixelBuffer = currentScreenBuffer;    
+    // Switch active screen buffer (hidden frames are overwritten by the next frame)
+    if (!hideFrame)
+        currentScreenBuffer = (currentScreenBuffer == screenBuffer1[0]) ? screenBuffer2[0] : screenBuffer1[0];
+    pixelBuffer = currentScreenBuffer;
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -187,6 +187,13 @@ public:
         return (currentScreenBuffer == screenBuffer1[0]) ? screenBuffer2[0] : screenBuffer1[0];
     }
 
+    /*! @brief    Indicates whether the current frame is hidden
+     *  @details  A hidden frame is drawn as usual, because sprite collisions are detected
+     *            while drawing. However, the screen buffers are not switched at the end of
+     *            the frame. Hence, the frame never shows up on the screen.
+     */
+    bool hideFrame;
+
     
     // ------------------------------------------------------------------------------------------
     //                                  Rastercycle information
@@ -93,7 +93,7 @@ ProcessorPort::write(uint8_t value)
     }
     
     // When writing to the port register, the last VIC byte appears in 0x0001
-    c64->mem.ram[0x0001] = c64->vic.prevDataBus;
+    c64->mem.pokeRam(0x0001, c64->vic.prevDataBus);
     
     // Switch memory banks
     c64->mem.updatePeekPokeLookupTables();
@@ -120,7 +120,7 @@ ProcessorPort::writeDirection(uint8_t value)
     direction = value;
     
     // When writing to the direction register, the last VIC byte appears in 0x0000
-    c64->mem.ram[0x0000] = c64->vic.prevDataBus;
+    c64->mem.pokeRam(0x0000, c64->vic.prevDataBus);
     
     // Switch memory banks
     c64->mem.updatePeekPokeLookupTables();
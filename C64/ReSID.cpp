@@ -85,6 +85,13 @@ ReSID::ReSID()
     setAudioFilter(false);
     setExternalAudioFilter(false);
     
+    silent = false;
+    executedSilently = false;
+    
+    sinkCallback = NULL;
+    sinkListener = NULL;
+    sinkFd = -1;
+    
     volume = 100000;
     targetVolume = 100000;
 }
@@ -167,6 +174,42 @@ ReSID::setClockFrequency(uint32_t frequency)
     sid->set_sampling_parameters(cpuFrequency, samplingMethod, sampleRate);
 }
 
+void
+ReSID::setSilent(bool enable)
+{
+    if (enable)
+        debug(2, "Switching sound synthesis off\n");
+    else
+        debug(2, "Switching sound synthesis on\n");
+    
+    silent = enable;
+}
+
+void
+ReSID::setSampleSink(const void *sender, void(*func)(const void *, const short *, size_t))
+{
+    if (func)
+        debug(2, "Attaching sample sink callback\n");
+    else
+        debug(2, "Detaching sample sink\n");
+    
+    sinkListener = sender;
+    sinkCallback = func;
+    sinkFd = -1;
+}
+
+void
+ReSID::setSampleSink(int fd)
+{
+    if (fd >= 0)
+        debug(2, "Attaching sample sink (file descriptor %d)\n", fd);
+    else
+        debug(2, "Detaching sample sink\n");
+    
+    sinkListener = NULL;
+    sinkCallback = NULL;
+    sinkFd = fd;
+}
 
 void
 ReSID::loadFromBuffer(uint8_t **buffer)
@@ -184,6 +227,13 @@ ReSID::saveToBuffer(uint8_t **buffer)
     VirtualComponent::saveToBuffer(buffer);
 }
 
+uint64_t
+ReSID::stateHash()
+{
+    st = sid->read_state();
+    return VirtualComponent::stateHash();
+}
+
 uint8_t
 ReSID::peek(uint16_t addr)
 {	
@@ -199,26 +249,63 @@ ReSID::poke(uint16_t addr, uint8_t value)
 
 void
 ReSID::execute(uint64_t elapsedCycles)
+{
+    execute(elapsedCycles, NULL, 0);
+}
+
+void
+ReSID::execute(uint64_t elapsedCycles, SIDWrite *writes, unsigned count)
 {
     short buf[2049];
     int buflength = 2048;
-    cycle_count delta_t = (cycle_count)elapsedCycles;
     int bufindex = 0;
+    uint64_t executedCycles = 0;
+    
+    // Skip sound synthesis if nobody is listening or if the samples would be discarded anyway
+    bool runningAhead = c64->isRunningAhead();
+    bool skipSynthesis = runningAhead || (!hasSampleSink() && (silent || c64->getWarp()));
     
-    // Let reSID compute some sound samples
-    while (delta_t) {
-        bufindex += sid->clock(delta_t, buf + bufindex, buflength - bufindex);
+    // Catch up the skipped state and discard outdated samples
+    if (executedSilently && !skipSynthesis) {
+        sid->synchronize_silent();
+        clearRingbuffer();
     }
     
-    // Write samples into ringbuffer
-    if (bufindex) {
-        writeData(buf, bufindex);
+    // When running ahead, the state is restored afterwards. Nothing has to be caught up.
+    if (!runningAhead)
+        executedSilently = skipSynthesis;
+    
+    for (unsigned i = 0; i <= count; i++) {
+        
+        // Run up to the next register write or up to the last cycle
+        uint64_t targetCycle = (i < count) ? writes[i].cycle : elapsedCycles;
+        assert(targetCycle >= executedCycles && targetCycle <= elapsedCycles);
+        cycle_count delta_t = (cycle_count)(targetCycle - executedCycles);
+        executedCycles = targetCycle;
+        
+        if (skipSynthesis) {
+            sid->clock_silent(delta_t);
+        } else {
+            
+            // Let reSID compute some sound samples
+            while (delta_t) {
+                bufindex += sid->clock(delta_t, buf + bufindex, buflength - bufindex);
+                if (bufindex == buflength) {
+                    deliverSamples(buf, bufindex);
+                    bufindex = 0;
+                }
+            }
+        }
+        
+        // Apply the register write exactly at its cycle
+        if (i < count) {
+            sid->write(writes[i].addr, writes[i].value);
+        }
     }
-    /*
-    for (int i = 0; i < bufindex; i++) {
-        writeData((float)buf[i]);
+    
+    if (bufindex) {
+        deliverSamples(buf, bufindex);
     }
-    */
 }
 
 void 
@@ -356,6 +443,41 @@ ReSID::writeData(float data)
 }
 */
 
+void
+ReSID::deliverSamples(short *data, size_t count)
+{
+    if (hasSampleSink()) {
+        writeToSink(data, count);
+    } else {
+        writeData(data, count);
+    }
+}
+
+void
+ReSID::writeToSink(short *data, size_t count)
+{
+    if (sinkCallback) {
+        sinkCallback(sinkListener, data, count);
+        return;
+    }
+    
+    // Write raw samples, taking care of partial writes
+    uint8_t *ptr = (uint8_t *)data;
+    size_t remaining = count * sizeof(short);
+    while (remaining) {
+        ssize_t written = write(sinkFd, ptr, remaining);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            warn("Failed to write to sample sink (%s). Detaching sink.\n", strerror(errno));
+            sinkFd = -1;
+            return;
+        }
+        ptr += written;
+        remaining -= written;
+    }
+}
+
 void
 ReSID::handleBufferOverflow()
 {
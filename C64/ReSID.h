@@ -27,6 +27,23 @@
 #include "VirtualComponent.h"
 #include "sid.h"
 
+/*! @brief   Time stamped write access to a SID register
+ *  @details Used to apply register writes at their exact cycles while executing
+ *           reSID in larger chunks.
+ */
+typedef struct {
+    
+    //! @brief   Cycle of the write access, relative to the first executed cycle
+    uint64_t cycle;
+    
+    //! @brief   Written register
+    uint8_t addr;
+    
+    //! @brief   Written value
+    uint8_t value;
+    
+} SIDWrite;
+
 class ReSID : public VirtualComponent {
 
 private:
@@ -83,6 +100,33 @@ private:
     //! ReSID state
     SID::State st;
     
+    /*! @brief   Indicates whether sound synthesis is switched off
+     *  @details In silent mode, reSID only keeps track of the state that is visible
+     *           to the CPU. No sound samples are produced.
+     */
+    bool silent;
+    
+    /*! @brief   Indicates whether the previous call to execute() ran silently
+     *  @details Silent execution takes place in silent mode and in warp mode.
+     *           When sound synthesis resumes, the skipped state is caught up.
+     */
+    bool executedSilently;
+    
+    /*! @brief   Sample sink callback function
+     *  @details If set, all sound samples are passed to this function instead of being
+     *           written into the ringbuffer.
+     */
+    void(*sinkCallback)(const void *, const short *, size_t);
+    
+    //! @brief   Registered sample sink listener (passed back into the callback function)
+    const void *sinkListener;
+    
+    /*! @brief   Sample sink file descriptor
+     *  @details If non-negative, all sound samples are written to this file as raw 16 bit
+     *           PCM data in native byte order instead of being written into the ringbuffer.
+     */
+    int sinkFd;
+    
 public:
     /*! @brief   Ring buffer read pointer
      */
@@ -133,6 +177,9 @@ public:
     //! Save state
     void saveToBuffer(uint8_t **buffer);
 
+    //! Compute hash over state
+    uint64_t stateHash();
+
 	//! Dump internal state to console
 	void dumpState();
 	
@@ -147,6 +194,12 @@ public:
      *           the generated sound samples into the internal ring buffer. 
      */
     void execute(uint64_t cycles);
+    
+	/*! @brief   Execute SID and apply register writes on the fly
+     *  @details Runs reSID for the specified amount of CPU cycles. Each register write is
+     *           applied exactly at its cycle. The writes must be sorted by cycle.
+     */
+    void execute(uint64_t cycles, SIDWrite *writes, unsigned count);
 	
     //! Notifies the SID chip that the emulator has started
     void run();
@@ -211,6 +264,28 @@ public:
 	//! Set clock frequency
     void setClockFrequency(uint32_t f);
 
+    //! Returns true iff sound synthesis is switched off
+    inline bool getSilent() { return silent; }
+    
+    //! Switches sound synthesis off or on
+    void setSilent(bool enable);
+
+    //! Returns true iff a sample sink is attached
+    inline bool hasSampleSink() { return sinkCallback != NULL || sinkFd >= 0; }
+    
+    /*! @brief   Attaches a callback function as sample sink
+     *  @details The function is invoked from the execution thread with every block of
+     *           samples produced by reSID. No sample is dropped or duplicated.
+     *           Pass NULL to detach the sink.
+     */
+    void setSampleSink(const void *sender, void(*func)(const void *, const short *, size_t));
+    
+    /*! @brief   Attaches a file descriptor as sample sink
+     *  @details Samples are written as raw 16 bit PCM data in native byte order.
+     *           Pass -1 to detach the sink. The descriptor is not closed by the emulator.
+     */
+    void setSampleSink(int fd);
+
     /*! @brief Sets the current volume
      */
     void setVolume(int32_t vol) { volume = vol; }
@@ -238,6 +313,14 @@ private:
      */
     void writeData(short *data, size_t count);
     
+    /*! @brief  Passes a certain number of audio samples to the sample sink or the ringbuffer
+     */
+    void deliverSamples(short *data, size_t count);
+    
+    /*! @brief  Passes a certain number of audio samples to the sample sink
+     */
+    void writeToSink(short *data, size_t count);
+    
     /*! @brief   Handles a buffer underflow condition
      *  @details A buffer underflow occurs when the computer's audio device
      *           needs sound samples than SID hasn't produced, yet!
@@ -0,0 +1,380 @@
+/*!
+ * @header      RewindBuffer.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "RewindBuffer.h"
+
+//! @brief    Writes a variable length integer (7 bits per byte, LSB first)
+static inline void
+writeVarint(uint8_t **ptr, size_t value)
+{
+    while (value >= 0x80) {
+        *(*ptr)++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *(*ptr)++ = (uint8_t)value;
+}
+
+//! @brief    Reads a variable length integer
+static inline size_t
+readVarint(const uint8_t **ptr)
+{
+    size_t value = 0;
+    unsigned shift = 0;
+
+    while (**ptr & 0x80) {
+        value |= (size_t)(*(*ptr)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (size_t)(*(*ptr)++) << shift;
+    return value;
+}
+
+RewindBuffer::RewindBuffer()
+{
+    setDescription("RewindBuffer");
+    debug(3, "  Creating rewind buffer at address %p...\n", this);
+
+    arena = NULL;
+    arenaSize = 0;
+    deltas = NULL;
+    maxFrames = 0;
+    keyframe = NULL;
+    state = NULL;
+    encoded = NULL;
+    stateSize = 0;
+    frame = 0;
+    numBlobs = 0;
+    clear();
+}
+
+RewindBuffer::~RewindBuffer()
+{
+    dealloc();
+}
+
+void
+RewindBuffer::dealloc()
+{
+    delete[] arena;
+    delete[] deltas;
+    delete[] keyframe;
+    delete[] state;
+    delete[] encoded;
+
+    arena = NULL;
+    arenaSize = 0;
+    deltas = NULL;
+    maxFrames = 0;
+    keyframe = NULL;
+    state = NULL;
+    encoded = NULL;
+    stateSize = 0;
+    releaseBlobs();
+    clear();
+}
+
+void
+RewindBuffer::configure(size_t budget, unsigned frames)
+{
+    dealloc();
+
+    if (budget == 0 || frames == 0) {
+        debug(2, "Rewind buffer disabled\n");
+        return;
+    }
+
+    arena = new uint8_t[budget];
+    arenaSize = budget;
+    deltas = new DeltaInfo[frames];
+    maxFrames = frames;
+
+    debug(2, "Rewind buffer enabled (%zu bytes, %u frames)\n", budget, frames);
+}
+
+void
+RewindBuffer::clear()
+{
+    writePos = 0;
+    first = 0;
+    count = 0;
+}
+
+void
+RewindBuffer::evictOldest()
+{
+    assert(count > 0);
+
+    first = (first + 1) % maxFrames;
+    count--;
+    releaseUnusedBlobs();
+}
+
+void
+RewindBuffer::retainBlobs(VirtualComponent *c)
+{
+    uint64_t hashes[maxBlobs];
+    unsigned n = c->collectBlobs(hashes, maxBlobs);
+    unsigned i, j;
+    
+    // Mark the blobs that are already retained as used
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < numBlobs && blobs[j] != hashes[i]; j++);
+        if (j < numBlobs)
+            lastUse[j] = frame;
+    }
+    releaseUnusedBlobs();
+    
+    // Retain the new ones
+    for (i = 0; i < n; i++) {
+        
+        for (j = 0; j < numBlobs && blobs[j] != hashes[i]; j++);
+        if (j < numBlobs)
+            continue;
+        
+        if (numBlobs == maxBlobs) {
+            debug(2, "Too many blobs. Discarding %u frames.\n", count);
+            while (numBlobs == maxBlobs && count > 0)
+                evictOldest();
+        }
+        if (numBlobs == maxBlobs) {
+            warn("Cannot retain blob %016llX\n", hashes[i]);
+            continue;
+        }
+        if (BlobStore::retain(hashes[i])) {
+            blobs[numBlobs] = hashes[i];
+            lastUse[numBlobs++] = frame;
+        }
+    }
+}
+
+void
+RewindBuffer::releaseUnusedBlobs()
+{
+    uint64_t oldest = frame - count;
+    
+    for (unsigned i = 0; i < numBlobs; ) {
+        if (lastUse[i] < oldest) {
+            BlobStore::release(blobs[i]);
+            numBlobs--;
+            blobs[i] = blobs[numBlobs];
+            lastUse[i] = lastUse[numBlobs];
+        } else {
+            i++;
+        }
+    }
+}
+
+void
+RewindBuffer::releaseBlobs()
+{
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::release(blobs[i]);
+    
+    numBlobs = 0;
+}
+
+bool
+RewindBuffer::allocate(size_t length, size_t *offset)
+{
+    if (length > arenaSize)
+        return false;
+
+    while (count > 0) {
+
+        size_t tail = deltas[first].offset;
+
+        if (writePos > tail) {
+
+            // Deltas occupy [tail; writePos)
+            if (arenaSize - writePos >= length) {
+                *offset = writePos;
+                return true;
+            }
+            if (tail >= length) {
+                *offset = 0;
+                return true;
+            }
+
+        } else {
+
+            // Deltas occupy [tail; arenaSize) and [0; writePos)
+            if (tail - writePos >= length) {
+                *offset = writePos;
+                return true;
+            }
+        }
+
+        evictOldest();
+    }
+
+    *offset = 0;
+    return true;
+}
+
+void
+RewindBuffer::record(VirtualComponent *c)
+{
+    if (!isEnabled())
+        return;
+
+    size_t size = c->stateSize();
+
+    // Start over with a new keyframe if the state size has changed
+    if (size != stateSize) {
+
+        debug(2, "Recording keyframe (%zu bytes)\n", size);
+
+        delete[] keyframe;
+        delete[] state;
+        delete[] encoded;
+        keyframe = new uint8_t[size];
+        state = new uint8_t[size];
+        encoded = new uint8_t[maxEncodedSize(size)];
+        stateSize = size;
+        clear();
+        releaseBlobs();
+        frame = 0;
+        retainBlobs(c);
+
+        uint8_t *ptr = state;
+        c->markDirty();
+        c->setNativeFormat(true);
+        c->saveDirtyToBuffer(&ptr);
+        c->setNativeFormat(false);
+        memcpy(keyframe, state, size);
+        return;
+    }
+
+    // The scratch buffer still holds the previous state. Only update what has changed.
+    uint8_t *ptr = state;
+    c->setNativeFormat(true);
+    c->saveDirtyToBuffer(&ptr);
+    c->setNativeFormat(false);
+
+    // Encode delta and turn the current state into the new keyframe
+    size_t length = encode(keyframe, state, size, encoded);
+
+    // Make room for the delta
+    size_t offset;
+    if (count == maxFrames) {
+        evictOldest();
+    }
+    if (!allocate(length, &offset)) {
+
+        // The delta doesn't fit at all. The remaining deltas are useless now.
+        debug(2, "Delta exceeds rewind buffer (%zu bytes)\n", length);
+        clear();
+        frame++;
+        retainBlobs(c);
+        return;
+    }
+
+    // Store delta
+    memcpy(arena + offset, encoded, length);
+    unsigned last = (first + count) % maxFrames;
+    deltas[last].offset = offset;
+    deltas[last].length = length;
+    writePos = offset + length;
+    count++;
+    frame++;
+    retainBlobs(c);
+}
+
+unsigned
+RewindBuffer::restore(VirtualComponent *c, unsigned frames)
+{
+    if (keyframe == NULL)
+        return 0;
+
+    if (frames > count)
+        frames = count;
+
+    // Walk back in time
+    for (unsigned i = 0; i < frames; i++) {
+
+        unsigned last = (first + count - 1) % maxFrames;
+        decode(arena + deltas[last].offset, keyframe, stateSize);
+        writePos = deltas[last].offset;
+        count--;
+        frame--;
+    }
+    
+    // Blobs only the rewound frames referred to are kept until the restored frame is discarded
+    for (unsigned i = 0; i < numBlobs; i++) {
+        if (lastUse[i] > frame)
+            lastUse[i] = frame;
+    }
+
+    debug(2, "Rewinding %u frames (%u frames left)\n", frames, count);
+
+    uint8_t *ptr = keyframe;
+    c->setNativeFormat(true);
+    c->loadFromBuffer(&ptr);
+    c->setNativeFormat(false);
+    return frames;
+}
+
+size_t
+RewindBuffer::encode(uint8_t *ref, const uint8_t *current, size_t size, uint8_t *dst)
+{
+    uint8_t *ptr = dst;
+    size_t i = 0;
+
+    while (i < size) {
+
+        // Skip over unchanged bytes
+        size_t start = i;
+        while (i + 8 <= size && memcmp(ref + i, current + i, 8) == 0) i += 8;
+        while (i < size && ref[i] == current[i]) i++;
+        size_t skip = i - start;
+
+        // Collect changed bytes until a long enough run of unchanged bytes shows up
+        size_t literal = i, same = 0;
+        while (i < size && same < minSkip) {
+            if (ref[i] == current[i]) same++; else same = 0;
+            i++;
+        }
+        if (same == minSkip) i -= same;
+
+        writeVarint(&ptr, skip);
+        writeVarint(&ptr, i - literal);
+        for (size_t j = literal; j < i; j++) {
+            *ptr++ = ref[j] ^ current[j];
+            ref[j] = current[j];
+        }
+    }
+
+    return ptr - dst;
+}
+
+void
+RewindBuffer::decode(const uint8_t *src, uint8_t *ref, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size) {
+
+        i += readVarint(&src);
+        size_t literal = readVarint(&src);
+        for (size_t j = 0; j < literal; j++) {
+            ref[i++] ^= *src++;
+        }
+    }
+}
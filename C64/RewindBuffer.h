@@ -0,0 +1,201 @@
+/*!
+ * @header      RewindBuffer.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _REWINDBUFFER_INC
+#define _REWINDBUFFER_INC
+
+#include "VirtualComponent.h"
+
+/*! @class    RewindBuffer
+ *  @brief    Records the emulator state frame by frame.
+ *  @details  The buffer keeps the most recently recorded state (the keyframe) in
+ *            serialized form. For each recorded frame, the difference to the previous
+ *            frame is stored as an XOR delta that is run-length encoded. Because XOR is
+ *            its own inverse, the deltas walk the keyframe back in time one frame after
+ *            another. All deltas live in a fixed-size arena. If the arena runs out of
+ *            space, the oldest deltas are discarded.
+ */
+class RewindBuffer : public VC64Object {
+
+private:
+
+    //! @brief    Location of a single encoded delta inside the arena
+    typedef struct {
+
+        //! @brief    Start offset in bytes
+        size_t offset;
+
+        //! @brief    Length in bytes
+        size_t length;
+
+    } DeltaInfo;
+
+    /*! @brief    Minimum number of unchanged bytes that terminate a literal run
+     *  @details  Shorter runs of unchanged bytes are stored inside the literal run,
+     *            because encoding them separately would cost more than it saves.
+     */
+    static const size_t minSkip = 16;
+
+    //! @brief    Storage for the encoded deltas
+    uint8_t *arena;
+
+    //! @brief    Size of the arena in bytes
+    size_t arenaSize;
+
+    //! @brief    Write position inside the arena
+    size_t writePos;
+
+    //! @brief    Ringbuffer holding the locations of all stored deltas
+    DeltaInfo *deltas;
+
+    //! @brief    Capacity of the delta ringbuffer
+    unsigned maxFrames;
+
+    //! @brief    Index of the oldest delta in the ringbuffer
+    unsigned first;
+
+    //! @brief    Number of stored deltas
+    unsigned count;
+
+    /*! @brief    Number of the most recently recorded frame
+     *  @details  The stored deltas lead back to frames frame - count to frame - 1.
+     */
+    uint64_t frame;
+
+    /*! @brief    Most recently recorded state
+     *  @details  When rewinding, the deltas are applied to this buffer. All states are
+     *            serialized in native format, because they never leave the process.
+     */
+    uint8_t *keyframe;
+
+    //! @brief    Size of a serialized state in bytes
+    size_t stateSize;
+
+    /*! @brief    Serialized current state
+     *  @details  The buffer is kept up to date with VirtualComponent::saveDirtyToBuffer().
+     *            Hence, only the memory pages written since the previous frame are copied.
+     */
+    uint8_t *state;
+
+    //! @brief    Scratch buffer for encoding a delta
+    uint8_t *encoded;
+    
+    //! @brief    Maximum number of blobs the recorded frames may refer to
+    static const unsigned maxBlobs = 32;
+    
+    /*! @brief    Hashes of all blobs the recorded frames refer to
+     *  @details  The rewind buffer holds a reference to each of them. Otherwise, a blob
+     *            might be freed, e.g., when a disk is ejected, and could not be restored.
+     */
+    uint64_t blobs[maxBlobs];
+    
+    /*! @brief    Most recent frame referring to each retained blob
+     *  @details  A blob is released as soon as this frame has been discarded.
+     */
+    uint64_t lastUse[maxBlobs];
+    
+    //! @brief    Number of retained blobs
+    unsigned numBlobs;
+
+public:
+
+    //! @brief    Constructor
+    RewindBuffer();
+
+    //! @brief    Destructor
+    ~RewindBuffer();
+
+    /*! @brief    Sets the memory budget and the maximum number of recorded frames
+     *  @details  The budget limits the size of the arena storing the deltas. In addition,
+     *            three buffers of the size of a serialized state are allocated when the
+     *            first frame is recorded. A budget of 0 disables the rewind buffer.
+     */
+    void configure(size_t budget, unsigned frames);
+
+    //! @brief    Returns true iff the rewind buffer is enabled
+    bool isEnabled() { return arena != NULL; }
+
+    //! @brief    Returns the memory budget
+    size_t getBudget() { return arenaSize; }
+
+    //! @brief    Returns the maximum number of frames that can be rewound
+    unsigned getMaxFrames() { return maxFrames; }
+
+    //! @brief    Returns the number of frames that can currently be rewound
+    unsigned numFrames() { return count; }
+
+    //! @brief    Deletes all recorded frames
+    void clear();
+
+    /*! @brief    Records the state of a component
+     *  @details  The first call stores a keyframe. Each subsequent call adds a delta.
+     *            If the state size changes, e.g., because a cartridge has been attached,
+     *            all recorded frames are discarded and a new keyframe is stored.
+     */
+    void record(VirtualComponent *c);
+
+    /*! @brief    Restores the state of a component
+     *  @details  Steps back the specified number of frames and loads the resulting state
+     *            into the component. The rewound frames are removed from the buffer.
+     *  @return   The number of rewound frames.
+     */
+    unsigned restore(VirtualComponent *c, unsigned frames);
+
+private:
+
+    //! @brief    Frees all allocated memory
+    void dealloc();
+
+    //! @brief    Discards the oldest delta
+    void evictOldest();
+    
+    /*! @brief    Retains all blobs the state of a component refers to
+     *  @details  The state is assumed to be the most recently recorded frame. If there are
+     *            too many blobs to keep track of, old deltas are discarded until the blobs
+     *            only they refer to have been released.
+     */
+    void retainBlobs(VirtualComponent *c);
+    
+    //! @brief    Releases all blobs no recorded frame refers to anymore
+    void releaseUnusedBlobs();
+    
+    //! @brief    Releases all retained blobs
+    void releaseBlobs();
+
+    /*! @brief    Reserves space for a delta in the arena
+     *  @details  Discards old deltas as long as there is not enough free space.
+     *  @return   false, if the delta is larger than the whole arena.
+     */
+    bool allocate(size_t length, size_t *offset);
+
+    /*! @brief    Encodes the difference between two states
+     *  @details  After encoding, ref has been overwritten with the contents of current.
+     *  @return   The number of bytes written into dst.
+     */
+    static size_t encode(uint8_t *ref, const uint8_t *current, size_t size, uint8_t *dst);
+
+    //! @brief    Applies an encoded delta to a state
+    static void decode(const uint8_t *src, uint8_t *ref, size_t size);
+
+    //! @brief    Returns the maximum size of an encoded delta
+    static size_t maxEncodedSize(size_t size) { return size + 10 * (size / (minSkip + 1) + 2); }
+};
+
+#endif
@@ -42,6 +42,7 @@ SIDWrapper::SIDWrapper()
     registerSnapshotItems(items, sizeof(items));
     
     useReSID = true;
+    numPendingWrites = 0;
 }
 
 SIDWrapper::~SIDWrapper()
@@ -50,6 +51,35 @@ SIDWrapper::~SIDWrapper()
     delete resid;
 }
 
+void
+SIDWrapper::reset()
+{
+    VirtualComponent::reset();
+    numPendingWrites = 0;
+}
+
+void
+SIDWrapper::loadFromBuffer(uint8_t **buffer)
+{
+    VirtualComponent::loadFromBuffer(buffer);
+    numPendingWrites = 0;
+}
+
+void
+SIDWrapper::saveToBuffer(uint8_t **buffer)
+{
+    // Buffered writes are not part of the snapshot
+    executeUntil(c64->getCycles());
+    VirtualComponent::saveToBuffer(buffer);
+}
+
+uint64_t
+SIDWrapper::stateHash()
+{
+    executeUntil(c64->getCycles());
+    return VirtualComponent::stateHash();
+}
+
 void 
 SIDWrapper::setReSID(bool enable)
 {
@@ -58,6 +88,7 @@ SIDWrapper::setReSID(bool enable)
     else
         debug(2, "Using old SID implementation\n");
     
+    flushPendingWrites();
     useReSID = enable;
 }
 
@@ -89,8 +120,10 @@ SIDWrapper::peek(uint16_t addr)
 {
     assert(addr <= 0x1F);
 
-    // Get SID up to date
-    executeUntil(c64->getCycles());
+    // Get SID up to date if the value depends on the oscillator state
+    if (addr == 0x1B || addr == 0x1C) {
+        executeUntil(c64->getCycles());
+    }
     
     // Take care of possible side effects, but discard value
     if (useReSID)
@@ -105,7 +138,7 @@ SIDWrapper::peek(uint16_t addr)
     
     if (addr == 0x1B || addr == 0x1C) {
         latchedDataBus = 0;
-        return rand();
+        return c64->randomNumber();
     }
     
     return latchedDataBus;
@@ -121,7 +154,7 @@ SIDWrapper::read(uint16_t addr)
     }
     
     if (addr == 0x1B || addr == 0x1C) {
-        return rand();
+        return c64->readRandomNumber();
     }
     
     return latchedDataBus;
@@ -130,32 +163,58 @@ SIDWrapper::read(uint16_t addr)
 void 
 SIDWrapper::poke(uint16_t addr, uint8_t value)
 {
-    // Get SID up to date
-    executeUntil(c64->getCycles());
-
     latchedDataBus = value;
-    oldsid->poke(addr, value);
-    resid->poke(addr, value);
+
+    // Make room if the write buffer is full
+    if (numPendingWrites == maxPendingWrites) {
+        executeUntil(c64->getCycles());
+    }
+    
+    // Record the write. It is applied when SID is executed the next time
+    SIDWrite *write = &pendingWrites[numPendingWrites++];
+    write->cycle = c64->getCycles() - cycles;
+    write->addr = (uint8_t)addr;
+    write->value = value;
 }
 
 void
 SIDWrapper::executeUntil(uint64_t targetCycle)
 {
-    execute(targetCycle - cycles);
+    uint64_t numCycles = targetCycle - cycles;
+    
+    if (useReSID) {
+        
+        // ReSID applies the writes on the fly
+        resid->execute(numCycles, pendingWrites, numPendingWrites);
+        for (unsigned i = 0; i < numPendingWrites; i++)
+            oldsid->poke(pendingWrites[i].addr, pendingWrites[i].value);
+        
+    } else {
+        
+        // Split execution at the cycles of the register writes
+        uint64_t executedCycles = 0;
+        for (unsigned i = 0; i < numPendingWrites; i++) {
+            if (pendingWrites[i].cycle > executedCycles) {
+                oldsid->execute(pendingWrites[i].cycle - executedCycles);
+                executedCycles = pendingWrites[i].cycle;
+            }
+            oldsid->poke(pendingWrites[i].addr, pendingWrites[i].value);
+            resid->poke(pendingWrites[i].addr, pendingWrites[i].value);
+        }
+        if (numCycles > executedCycles) {
+            oldsid->execute(numCycles - executedCycles);
+        }
+    }
+    
+    numPendingWrites = 0;
     cycles = targetCycle;
 }
 
-inline void
-SIDWrapper::execute(uint64_t numCycles)
+void
+SIDWrapper::flushPendingWrites()
 {
-    // printf("Execute SID for %lld cycles", numCycles);
-    if (numCycles == 0)
-        return;
-    
-    if (useReSID)
-        resid->execute(numCycles);
-    else
-        oldsid->execute(numCycles);
+    if (c64 != NULL)
+        executeUntil(c64->getCycles());
 }
 
 void 
@@ -216,6 +275,7 @@ SIDWrapper::setAudioFilter(bool enable)
     else
         debug(2, "Disabling audio filters\n");
 
+    flushPendingWrites();
     oldsid->setAudioFilter(enable);
     // resid->setAudioFilter(enable);
     resid->setExternalAudioFilter(enable); 
@@ -224,12 +284,14 @@ SIDWrapper::setAudioFilter(bool enable)
 void
 SIDWrapper::setSamplingMethod(sampling_method value)
 {
-     resid->setSamplingMethod(value);
+    flushPendingWrites();
+    resid->setSamplingMethod(value);
 }
 
 void 
 SIDWrapper::setChipModel(chip_model value)
 {
+    flushPendingWrites();
     resid->setChipModel(value);
 }
 
@@ -249,6 +311,7 @@ SIDWrapper::getClockFrequency()
 void 
 SIDWrapper::setClockFrequency(uint32_t frequency)
 {
+    flushPendingWrites();
     oldsid->setClockFrequency(frequency);
     resid->setClockFrequency(frequency);
 }
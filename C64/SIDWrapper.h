@@ -114,6 +114,30 @@ public:
 	//! @brief    Sets the clock frequency.
 	void setClockFrequency(uint32_t frequency);	
 
+    //! @brief    Returns true iff sound synthesis is switched off.
+    inline bool getSilent() { return resid->getSilent(); }
+    
+    /*! @brief    Switches sound synthesis off or on (ReSID only).
+     *  @details  Use silent mode when nobody consumes the audio stream, e.g., in headless runs.
+     *            The registers readable by the CPU keep their exact values.
+     */
+    void setSilent(bool enable) { resid->setSilent(enable); }
+    
+    /*! @brief    Attaches a callback function as sample sink (ReSID only).
+     *  @details  All samples produced by reSID are delivered to the sink instead of the
+     *            audio ringbuffer, also in warp mode. Pass NULL to detach the sink.
+     *  @note     Only call this function while the emulator is halted.
+     */
+    void setSampleSink(const void *sender, void(*func)(const void *, const short *, size_t)) {
+        resid->setSampleSink(sender, func); }
+    
+    /*! @brief    Attaches a file descriptor as sample sink (ReSID only).
+     *  @details  Samples are written as raw 16 bit PCM data in native byte order.
+     *            Pass -1 to detach the sink.
+     *  @note     Only call this function while the emulator is halted.
+     */
+    void setSampleSink(int fd) { resid->setSampleSink(fd); }
+
     //! @brief    Sets the current volume
     void setVolume(int32_t v) { resid->setVolume(v); }
     
@@ -138,17 +162,49 @@ private:
     //! @brief    Current clock cycle since power up
     uint64_t cycles;
 
+    //! @brief    Maximum number of buffered register writes
+    static const unsigned maxPendingWrites = 256;
+    
+    /*! @brief    Buffered register writes
+     *  @details  Register writes are not applied immediately. Instead, they are recorded
+     *            together with their cycle (relative to the last executed cycle) and applied
+     *            exactly at this cycle when SID is executed the next time. This lets SID run
+     *            in larger chunks, e.g., during digi playback.
+     */
+    SIDWrite pendingWrites[maxPendingWrites];
+    
+    //! @brief    Number of buffered register writes
+    unsigned numPendingWrites;
+    
 public:
     
+    //! @brief    Resets the SID chip and discards all buffered register writes
+    void reset();
+    
+    //! @brief    Loads state and discards all buffered register writes
+    void loadFromBuffer(uint8_t **buffer);
+    
+    //! @brief    Applies all buffered register writes and saves state
+    void saveToBuffer(uint8_t **buffer);
+    
+    //! @brief    Applies all buffered register writes and computes a hash over the state
+    uint64_t stateHash();
+    
     /*! @brief    Executes SID until a certain cycle is reached
+     *  @details  All buffered register writes are applied on the way.
      *  @param    cycle The target cycle
      */
     void executeUntil(uint64_t targetCycle);
 
-    /*! @brief    Executes SID for a certain number of cycles
-     *  @param    cycles Number of cycles to execute
+private:
+
+    /*! @brief    Applies all buffered register writes with the current settings
+     *  @details  Called before the SID implementation or one of its settings is changed.
+     *            Otherwise, writes recorded earlier would be applied with the new settings.
      */
-	void execute(uint64_t numCycles);
+    void flushPendingWrites();
+
+public:
 
     //! @brief    Notifies the SID chip that the emulator has started
     void run();
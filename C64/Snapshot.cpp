@@ -17,13 +17,41 @@
  */
 
 #include "C64.h"
+#include "Compressor.h"
 
 const uint8_t Snapshot::magicBytes[] = { 'V', 'C', '6', '4', 0x00 };
 
+//! @brief    Writes an unsigned integer in big endian format (does nothing if *ptr is NULL)
+static void
+writeBigEndian(uint8_t **ptr, uint64_t value, unsigned bytes)
+{
+    if (*ptr == NULL)
+        return;
+    
+    for (unsigned i = bytes; i > 0; i--)
+        *(*ptr)++ = (uint8_t)(value >> (8 * (i - 1)));
+}
+
+//! @brief    Reads an unsigned integer in big endian format
+static uint64_t
+readBigEndian(const uint8_t **ptr, unsigned bytes)
+{
+    uint64_t value = 0;
+    
+    for (unsigned i = 0; i < bytes; i++)
+        value = (value << 8) | *(*ptr)++;
+    
+    return value;
+}
+
 Snapshot::Snapshot()
 {
     state = NULL;
     capacity = 0;
+    blobs = NULL;
+    numBlobs = 0;
+    image = NULL;
+    imageRGBA = NULL;
 }
 
 Snapshot *
@@ -61,10 +89,51 @@ void
 Snapshot::dealloc()
 {
     if (state != NULL) {
-        free(state);
+        releaseBuffer(state);
         state = NULL;
         capacity = 0;
     }
+    releaseBlobs();
+    releaseImage();
+}
+
+void
+Snapshot::releaseImage()
+{
+    delete[] image;
+    delete[] imageRGBA;
+    image = NULL;
+    imageRGBA = NULL;
+}
+
+void
+Snapshot::setBlobs(const uint64_t *hashes, unsigned count)
+{
+    releaseBlobs();
+    
+    blobs = new uint64_t[count];
+    for (unsigned i = 0; i < count; i++) {
+        
+        // Multiple drives usually share the same ROM
+        unsigned j;
+        for (j = 0; j < numBlobs && blobs[j] != hashes[i]; j++);
+        if (j < numBlobs)
+            continue;
+        
+        if (BlobStore::retain(hashes[i]))
+            blobs[numBlobs++] = hashes[i];
+    }
+}
+
+void
+Snapshot::releaseBlobs()
+{
+    for (unsigned i = 0; i < numBlobs; i++)
+        BlobStore::release(blobs[i]);
+    
+    delete[] blobs;
+    blobs = NULL;
+    numBlobs = 0;
 }
 
 bool
@@ -85,7 +154,11 @@ Snapshot::setCapacity(size_t size)
     header()->major = V_MAJOR;
     header()->minor = V_MINOR;
     header()->subminor = V_SUBMINOR;
+    header()->flags = 0;
+    header()->screenshot.width = 0;
+    header()->screenshot.height = 0;
     header()->timestamp = (time_t)0;
+    header()->stateSize = size;
     
     return true;
 }
@@ -177,19 +250,77 @@ bool
 Snapshot::readFromBuffer(const uint8_t *buffer, size_t length)
 {
     assert(buffer != NULL);
-    assert(length > sizeof(SnapshotHeader));
+    assert(length >= 16);
 
-    size_t stateSize = length - sizeof(SnapshotHeader);
+    // Decompress compressed snapshots first
+    if (((SnapshotHeader *)buffer)->flags & SNAPSHOT_COMPRESSED) {
+        
+        const uint8_t *ptr = buffer + 8;
+        size_t size = (size_t)readBigEndian(&ptr, 8);
+        if (size <= sizeof(SnapshotHeader) || size > Compressor::maxDecompressedSize(length - 16))
+            return false;
+        
+        uint8_t *data = (uint8_t *)malloc(size);
+        if (data == NULL)
+            return false;
+        
+        bool success =
+        Compressor::decompress(ptr, length - 16, data, size) &&
+        !(((SnapshotHeader *)data)->flags & SNAPSHOT_COMPRESSED) &&
+        readFromBuffer(data, size);
+        
+        free(data);
+        return success;
+    }
     
-    // Allocate memory
-    if (!setCapacity(stateSize))
-        return false; 
+    if (length <= sizeof(SnapshotHeader))
+        return false;
+    
+    size_t stateSize = ((SnapshotHeader *)buffer)->stateSize;
+    if (stateSize > length - sizeof(SnapshotHeader))
+        return false;
+    
+    // Take over header and state data (no copy is made for memory-mapped files)
+    dealloc();
+    if ((state = adoptBuffer(buffer, sizeof(SnapshotHeader) + stateSize)) == NULL)
+        return false;
+    capacity = stateSize;
+    
+    // Put all blobs into the blob store
+    const uint8_t *ptr = buffer + sizeof(SnapshotHeader) + stateSize;
+    const uint8_t *end = buffer + length;
+    
+    releaseBlobs();
+    if (end - ptr < 4)
+        return false;
+    unsigned count = (unsigned)readBigEndian(&ptr, 4);
     
-    // Copy header
-    memcpy((void *)header(), buffer, sizeof(SnapshotHeader));
+    // Each blob takes at least 12 bytes (hash and size)
+    if (count > (size_t)(end - ptr) / 12)
+        return false;
+    blobs = new uint64_t[count];
     
-    // Copy state data
-    memcpy(getData(), buffer + sizeof(SnapshotHeader), length - sizeof(SnapshotHeader));
+    for (unsigned i = 0; i < count; i++) {
+        
+        if (end - ptr < 12)
+            return false;
+        uint64_t hash = readBigEndian(&ptr, 8);
+        size_t size = (size_t)readBigEndian(&ptr, 4);
+        if ((size_t)(end - ptr) < size || !BlobStore::insert(hash, ptr, size)) {
+            warn("Blob %016llX is corrupted\n", hash);
+            return false;
+        }
+        blobs[numBlobs++] = hash;
+        ptr += size;
+    }
+    
+    // Read screenshot
+    size_t imageSize = header()->screenshot.width * header()->screenshot.height;
+    if ((size_t)(end - ptr) < imageSize)
+        return false;
+    releaseImage();
+    image = new uint8_t[imageSize];
+    memcpy(image, ptr, imageSize);
     
 	return true;
 }
@@ -204,31 +335,142 @@ Snapshot::writeToBuffer(uint8_t *buffer)
     if (buffer)
         memcpy(buffer, state, length);
     
+    // Append blob section
+    uint8_t *ptr = buffer ? buffer + length : NULL;
+    writeBigEndian(&ptr, numBlobs, 4);
+    length += 4;
+    
+    for (unsigned i = 0; i < numBlobs; i++) {
+        
+        size_t size = BlobStore::size(blobs[i]);
+        writeBigEndian(&ptr, blobs[i], 8);
+        writeBigEndian(&ptr, size, 4);
+        if (ptr) {
+            BlobStore::copy(blobs[i], ptr, size);
+            ptr += size;
+        }
+        length += 12 + size;
+    }
+    
+    // Append screenshot
+    size_t imageSize = header()->screenshot.width * header()->screenshot.height;
+    if (ptr)
+        memcpy(ptr, image, imageSize);
+    length += imageSize;
+    
     return length;
 }
 
+uint8_t *
+Snapshot::compress(const uint8_t *buffer, size_t length, size_t *result)
+{
+    assert(length > sizeof(SnapshotHeader));
+    
+    uint8_t *data = new uint8_t[16 + Compressor::maxCompressedSize(length)];
+    uint8_t *ptr = data + 8;
+    
+    // Header prefix (magic bytes, version number, flags)
+    memcpy(data, buffer, 7);
+    data[7] = SNAPSHOT_COMPRESSED;
+    
+    // Uncompressed size, followed by the compressed snapshot
+    writeBigEndian(&ptr, length, 8);
+    *result = 16 + Compressor::compress(buffer, length, ptr);
+    
+    return data;
+}
+
+uint8_t
+Snapshot::colorIndex(uint32_t rgba, const uint32_t *palette)
+{
+    unsigned result = 0;
+    int best = INT_MAX;
+    
+    for (unsigned i = 0; i < 16; i++) {
+        
+        if (palette[i] == rgba)
+            return i;
+        
+        // Squared distance in RGB space
+        int dist = 0;
+        for (unsigned shift = 0; shift < 24; shift += 8) {
+            int d = (int)((rgba >> shift) & 0xFF) - (int)((palette[i] >> shift) & 0xFF);
+            dist += d * d;
+        }
+        if (dist < best) {
+            best = dist;
+            result = i;
+        }
+    }
+    
+    return (uint8_t)result;
+}
+
 void
-Snapshot::takeScreenshot(uint32_t *buf, bool pal)
+Snapshot::takeScreenshot(uint32_t *buf, bool pal, const uint32_t *palette, unsigned scale)
 {
-    unsigned x_start, y_start;
-       
+    unsigned x_start, y_start, width, height;
+    
+    assert(scale > 0);
+    
     if (pal) {
         x_start = PAL_LEFT_BORDER_WIDTH - 36;
         y_start = PAL_UPPER_BORDER_HEIGHT - 34;
-        header()->screenshot.width = 36 + PAL_CANVAS_WIDTH + 36;
-        header()->screenshot.height = 34 + PAL_CANVAS_HEIGHT + 34;
+        width = 36 + PAL_CANVAS_WIDTH + 36;
+        height = 34 + PAL_CANVAS_HEIGHT + 34;
     } else {
         x_start = NTSC_LEFT_BORDER_WIDTH - 42;
         y_start = NTSC_UPPER_BORDER_HEIGHT - 9;
-        header()->screenshot.width = 36 + PAL_CANVAS_WIDTH + 36;
-        header()->screenshot.height = 9 + PAL_CANVAS_HEIGHT + 9;
+        width = 36 + PAL_CANVAS_WIDTH + 36;
+        height = 9 + PAL_CANVAS_HEIGHT + 9;
     }
+    width /= scale;
+    height /= scale;
     
-    uint32_t *target = header()->screenshot.screen;
+    // Allocate memory
+    if (image == NULL || header()->screenshot.width * header()->screenshot.height != width * height) {
+        releaseImage();
+        image = new uint8_t[width * height];
+    }
+    delete[] imageRGBA;
+    imageRGBA = NULL;
+    
+    header()->screenshot.width = width;
+    header()->screenshot.height = height;
+    memcpy(header()->screenshot.palette, palette, sizeof(header()->screenshot.palette));
+    
+    // Sample every scale-th pixel in every scale-th line
+    uint8_t *target = image;
+    uint32_t color = palette[0];
+    uint8_t index = 0;
     buf += x_start + y_start * NTSC_PIXELS;
-    for (unsigned i = 0; i < header()->screenshot.height; i++) {
-        memcpy(target, buf, header()->screenshot.width * 4);
-        target += header()->screenshot.width;
-        buf += NTSC_PIXELS;
+    
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x++) {
+            
+            // Neighboring pixels mostly share the same color
+            if (buf[x * scale] != color) {
+                color = buf[x * scale];
+                index = colorIndex(color, palette);
+            }
+            *target++ = index;
+        }
+        buf += scale * NTSC_PIXELS;
+    }
+}
+
+unsigned char *
+Snapshot::getImageData()
+{
+    if (imageRGBA == NULL) {
+        
+        size_t imageSize = header()->screenshot.width * header()->screenshot.height;
+        imageRGBA = new uint32_t[imageSize > 0 ? imageSize : 1];
+        imageRGBA[0] = 0;
+        
+        for (size_t i = 0; i < imageSize; i++)
+            imageRGBA[i] = header()->screenshot.palette[image[i] & 0x0F];
     }
+    
+    return (unsigned char *)imageRGBA;
 }
@@ -37,22 +37,42 @@ typedef struct {
     uint8_t minor;
     uint8_t subminor;
     
-    //! @brief    Screenshot
+    /*! @brief    Snapshot flags
+     *  @details  If SNAPSHOT_COMPRESSED is set, the 8 byte header prefix is followed by the
+     *            size of the uncompressed snapshot (64 bit, big endian) and the compressed
+     *            snapshot, which starts with an uncompressed header again.
+     */
+    uint8_t flags;
+    
+    /*! @brief    Screenshot
+     *  @details  The image is stored palette-indexed with one byte per pixel. In snapshot
+     *            files, the pixel data follows the blob section.
+     */
     struct {
         
         //! @brief    Image width and height
         uint16_t width, height;
         
-        //! @brief    Screen buffer data
-        uint32_t screen[PAL_RASTERLINES * NTSC_PIXELS];
+        //! @brief    Colors referenced by the pixel data (RGBA)
+        uint32_t palette[16];
         
     } screenshot;
     
     //! @brief    Date and time of snapshot creation
     time_t timestamp;
     
+    /*! @brief    Size of the internal state in bytes
+     *  @details  In snapshot files, the state is followed by the blob section.
+     */
+    uint64_t stateSize;
+    
 } SnapshotHeader;
 
+//! @brief    Snapshot header flags
+enum {
+    SNAPSHOT_COMPRESSED = 0x01
+};
+
 /*! @class    Snapshot
  *  @brief    The Snapshot class declares the programmatic interface for a file that contains
  *            an emulator snapshot (frozen internal state).
@@ -73,6 +93,22 @@ private:
     //! @brief    Internal state data
     uint8_t *state;
 	
+    /*! @brief    Hashes of all blobs the internal state refers to
+     *  @details  The snapshot holds a reference to each blob. When the snapshot is written
+     *            to a file, the blob contents are appended, so the file is self-contained.
+     */
+    uint64_t *blobs;
+    
+    //! @brief    Number of referenced blobs
+    unsigned numBlobs;
+    
+    //! @brief    Screenshot pixels (palette indices)
+    uint8_t *image;
+    
+    //! @brief    Screenshot pixels in RGBA format (created on demand)
+    uint32_t *imageRGBA;
+    
+
 public:
 
 	//! @brief    Constructor
@@ -93,6 +129,12 @@ public:
     //! @brief    Allocates memory for storing internal state
     bool setCapacity(size_t size);
     
+    //! @brief    Replaces the list of referenced blobs
+    void setBlobs(const uint64_t *hashes, unsigned count);
+    
+    //! @brief    Releases all referenced blobs
+    void releaseBlobs();
+    
     //! @brief    Returns true iff buffer contains a snapshot
     static bool isSnapshot(const uint8_t *buffer, size_t length);
 
@@ -129,6 +171,14 @@ public:
 	const char *typeAsString();
 
 
+    /*! @brief    Compresses a serialized snapshot
+     *  @param    buffer Snapshot data as written by writeToBuffer()
+     *  @param    length Size of the snapshot data in bytes
+     *  @param    result Size of the compressed snapshot in bytes
+     *  @return   Compressed snapshot, allocated with new[]
+     */
+    static uint8_t *compress(const uint8_t *buffer, size_t length, size_t *result);
+    
     //! @brief    Returns size of header
     size_t headerSize() { return sizeof(SnapshotHeader); }
 
@@ -151,8 +201,10 @@ public:
 	//! Returns true, if snapshot does not contain data yet
 	bool isEmpty() { return state == NULL; }
 	
-	//! Return screen buffer
-	unsigned char *getImageData() { return (unsigned char *)(header()->screenshot.screen); }
+	/*! @brief    Returns the screenshot in RGBA format
+     *  @details  The palette-indexed image is converted when this function is called first.
+     */
+	unsigned char *getImageData();
 
     //! Return image width
     unsigned getImageWidth() { return header()->screenshot.width; }
@@ -160,8 +212,24 @@ public:
     //! Return image height
     unsigned getImageHeight() { return header()->screenshot.height; }
 
-    //! Take screenshot
-    void takeScreenshot(uint32_t *buf, bool pal);
+    /*! @brief    Takes a screenshot
+     *  @details  The visible screen area is downscaled by the specified factor. Pixels
+     *            are point-sampled, so that each of them still maps to one of the 16
+     *            colors in the palette. A factor of 1 stores the full screenshot.
+     *  @param    buf     Screen buffer in RGBA format
+     *  @param    pal     Indicates whether the screen buffer holds a PAL or NTSC image
+     *  @param    palette The 16 colors the screen buffer was drawn with
+     *  @param    scale   Downscaling factor
+     */
+    void takeScreenshot(uint32_t *buf, bool pal, const uint32_t *palette, unsigned scale);
+    
+private:
+    
+    //! @brief    Frees the screenshot pixels
+    void releaseImage();
+    
+    //! @brief    Returns the palette index of a color (the nearest color if not found)
+    static uint8_t colorIndex(uint32_t rgba, const uint32_t *palette);
 
 };
 
@@ -0,0 +1,179 @@
+/*!
+ * @header      SnapshotWriter.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "SnapshotWriter.h"
+
+SnapshotWriter::SnapshotWriter()
+{
+    setDescription("SnapshotWriter");
+    
+    first = last = NULL;
+    pending = 0;
+    queue = NULL;
+    started = false;
+    quit = false;
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (started) {
+        
+        pthread_mutex_lock(&lock);
+        quit = true;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+        
+        pthread_join(thread, NULL);
+    }
+    
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+}
+
+void
+SnapshotWriter::write(Snapshot *snapshot, const char *path, bool compress)
+{
+    assert(snapshot != NULL);
+    assert(path != NULL);
+    
+    Job *job = new Job;
+    job->size = snapshot->writeToBuffer(NULL);
+    job->data = new uint8_t[job->size];
+    job->path = strdup(path);
+    job->compress = compress;
+    job->next = NULL;
+    snapshot->writeToBuffer(job->data);
+    
+    pthread_mutex_lock(&lock);
+    
+    if (!started) {
+        started = pthread_create(&thread, NULL, threadMain, (void *)this) == 0;
+    }
+    bool queued = started;
+    if (queued) {
+        if (last) last->next = job; else first = job;
+        last = job;
+        pending++;
+        pthread_cond_broadcast(&cond);
+    }
+    
+    pthread_mutex_unlock(&lock);
+    
+    if (queued) {
+        debug(2, "Queued snapshot %s (%zu bytes)\n", path, job->size);
+        return;
+    }
+    
+    // Write the snapshot on the caller's thread if the background thread can't be started
+    warn("Cannot start background thread. Writing snapshot %s directly\n", path);
+    bool success = process(job);
+    if (queue)
+        queue->putMessage(success ? MSG_SNAPSHOT_SAVED : MSG_SNAPSHOT_NOT_SAVED);
+}
+
+unsigned
+SnapshotWriter::numPending()
+{
+    pthread_mutex_lock(&lock);
+    unsigned result = pending;
+    pthread_mutex_unlock(&lock);
+    
+    return result;
+}
+
+void
+SnapshotWriter::flush()
+{
+    pthread_mutex_lock(&lock);
+    while (started && pending > 0)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void *
+SnapshotWriter::threadMain(void *writer)
+{
+    ((SnapshotWriter *)writer)->processRequests();
+    return NULL;
+}
+
+void
+SnapshotWriter::processRequests()
+{
+    pthread_mutex_lock(&lock);
+    
+    while (true) {
+        
+        // Wait for work. Pending requests are processed before quitting.
+        while (first == NULL && !quit)
+            pthread_cond_wait(&cond, &lock);
+        if (first == NULL)
+            break;
+        
+        Job *job = first;
+        first = job->next;
+        if (first == NULL) last = NULL;
+        
+        pthread_mutex_unlock(&lock);
+        bool success = process(job);
+        if (queue)
+            queue->putMessage(success ? MSG_SNAPSHOT_SAVED : MSG_SNAPSHOT_NOT_SAVED);
+        pthread_mutex_lock(&lock);
+        
+        pending--;
+        pthread_cond_broadcast(&cond);
+    }
+    
+    pthread_mutex_unlock(&lock);
+}
+
+bool
+SnapshotWriter::process(Job *job)
+{
+    uint8_t *data = job->data;
+    size_t size = job->size;
+    bool success = false;
+    FILE *file;
+    
+    if (job->compress) {
+        data = Snapshot::compress(job->data, job->size, &size);
+        debug(2, "Compressed snapshot from %zu to %zu bytes\n", job->size, size);
+    }
+    
+    if ((file = fopen(job->path, "w")) != NULL) {
+        success = fwrite(data, 1, size, file) == size;
+        success &= fclose(file) == 0;
+    }
+    
+    if (!success) {
+        warn("Failed to write snapshot %s\n", job->path);
+    }
+    
+    if (data != job->data)
+        delete[] data;
+    delete[] job->data;
+    free(job->path);
+    delete job;
+    
+    return success;
+}
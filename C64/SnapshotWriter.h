@@ -0,0 +1,118 @@
+/*!
+ * @header      SnapshotWriter.h
+ * @author      agent
+ * @copyright   2026 agent
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _SNAPSHOTWRITER_INC
+#define _SNAPSHOTWRITER_INC
+
+#include "Snapshot.h"
+#include "Message.h"
+
+/*! @class    SnapshotWriter
+ *  @brief    Writes snapshot files in the background
+ *  @details  The caller hands over a serialized snapshot, which is queued up. A background
+ *            thread compresses the data if requested and writes it to disk. When a file has
+ *            been written, MSG_SNAPSHOT_SAVED or MSG_SNAPSHOT_NOT_SAVED is put into the
+ *            message queue. The thread is started with the first request.
+ *
+ *            A front end owns a writer and hands over snapshots taken by the emulator,
+ *            e.g., with C64::takeUserSnapshot(). Compressed snapshots are decompressed
+ *            transparently when loaded.
+ */
+class SnapshotWriter : public VC64Object {
+    
+private:
+    
+    //! @brief    A single write request
+    typedef struct Job {
+        
+        uint8_t *data;
+        size_t size;
+        char *path;
+        bool compress;
+        struct Job *next;
+        
+    } Job;
+    
+    //! @brief    Pending write requests (oldest first)
+    Job *first;
+    
+    //! @brief    Last pending write request
+    Job *last;
+    
+    //! @brief    Number of pending write requests, including the one in progress
+    unsigned pending;
+    
+    //! @brief    Message queue for reporting completed requests
+    MessageQueue *queue;
+    
+    //! @brief    Background thread
+    pthread_t thread;
+    
+    //! @brief    Indicates whether the background thread has been started
+    bool started;
+    
+    //! @brief    Asks the background thread to terminate
+    bool quit;
+    
+    //! @brief    Protects the request queue
+    pthread_mutex_t lock;
+    
+    //! @brief    Signals new requests and completed requests
+    pthread_cond_t cond;
+    
+public:
+    
+    //! @brief    Constructor
+    SnapshotWriter();
+    
+    //! @brief    Destructor
+    /*! @details  Waits until all pending requests have been processed.
+     */
+    ~SnapshotWriter();
+    
+    //! @brief    Sets the message queue for reporting completed requests
+    void setMessageQueue(MessageQueue *q) { queue = q; }
+    
+    /*! @brief    Queues up a snapshot for writing
+     *  @details  The snapshot is serialized on the caller's thread. Everything else
+     *            happens in the background.
+     */
+    void write(Snapshot *snapshot, const char *path, bool compress);
+    
+    //! @brief    Returns the number of snapshots that have not been written yet
+    unsigned numPending();
+    
+    //! @brief    Waits until all pending snapshots have been written
+    void flush();
+    
+private:
+    
+    //! @brief    Entry point of the background thread
+    static void *threadMain(void *writer);
+    
+    //! @brief    Processes requests until asked to quit
+    void processRequests();
+    
+    //! @brief    Compresses and writes a single snapshot
+    bool process(Job *job);
+};
+
+#endif
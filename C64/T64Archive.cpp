@@ -172,7 +172,7 @@ T64Archive::makeT64ArchiveWithAnyArchive(Archive *otherArchive)
 
 void T64Archive::dealloc()
 {
-    if (data) free(data);
+    releaseBuffer(data);
     data = NULL;
     size = 0;
     fp = -1;
@@ -221,10 +221,9 @@ T64Archive::readFromBuffer(const uint8_t *buffer, size_t length)
 {
     assert(buffer != NULL);
     
-	if ((data = (uint8_t *)malloc(length)) == NULL)
+	if ((data = adoptBuffer(buffer, length)) == NULL)
 		return false;
 
-	memcpy(data, buffer, length);
 	size = length;
 
     // Some T64 archives contain incosistencies. We fix them asap
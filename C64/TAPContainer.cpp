@@ -87,7 +87,7 @@ TAPContainer::isTAPFile(const char *filename)
 void
 TAPContainer::dealloc()
 {
-    if (data) free(data);
+    releaseBuffer(data);
     data = NULL;
     size = 0;
     fp = -1;
@@ -114,10 +114,9 @@ TAPContainer::hasSameType(const char *filename)
 bool
 TAPContainer::readFromBuffer(const uint8_t *buffer, size_t length)
 {
-    if ((data = (uint8_t *)malloc(length)) == NULL)
+    if ((data = adoptBuffer(buffer, length)) == NULL)
         return false;
     
-    memcpy(data, buffer, length);
     size = length;
     
     int l = LO_LO_HI_HI(data[0x10], data[0x11], data[0x12], data[0x13]);
@@ -27,6 +27,14 @@ VC1541::VC1541()
 	cpu.setDescription("1541CPU");
     cpu.chipModel = MOS_6502;
     
+    // Setup references
+    cpu.mem = &mem;
+    cpu.floppy = this;
+    mem.cpu = &cpu;
+    mem.floppy = this;
+    via1.floppy = this;
+    via2.floppy = this;
+    
     // Register sub components
     VirtualComponent *subcomponents[] = { &mem, &cpu, &via1, &via2, &disk, NULL };
     registerSubComponents(subcomponents, sizeof(subcomponents)); 
@@ -59,12 +67,15 @@ VC1541::VC1541()
     
     bitAccuracy = true;
     sendSoundMessages = true;
+    deviceNr = 8;
+    d64Image = NULL;
     resetDisk();
 }
 
 VC1541::~VC1541()
 {
 	debug(3, "Releasing VC1541...\n");
+    delete d64Image;
 }
 
 void
@@ -74,10 +85,26 @@ VC1541::reset()
     
     // Establish bindings
     // iec = &c64->iec;
-    // cpu.mem = &mem;
     
     cpu.setPC(0xEAA0);
     halftrack = 41;
+    disk.requestHalftrack(halftrack);
+    headBitsCount = 0;
+}
+
+void
+VC1541::loadFromBuffer(uint8_t **buffer)
+{
+    VirtualComponent::loadFromBuffer(buffer);
+    
+    // The prefetched bits may belong to a different head position
+    headBitsCount = 0;
+}
+
+bool
+VC1541::savesSubComponent(VirtualComponent *component)
+{
+    return component == &disk || iec->driveIsConnected(deviceNr);
 }
 
 void
@@ -87,17 +114,25 @@ VC1541::resetDisk()
     
     // Disk properties
     disk.clearDisk();
+    headBitsCount = 0;
     diskInserted = false;
     diskPartiallyInserted = false;
 }
 
+void
+VC1541::putMessage(VC64Message msg)
+{
+    if (deviceNr == 8)
+        c64->putMessage(msg);
+}
+
 void
 VC1541::ping()
 {
     debug(3, "Pinging VC1541...\n");
-    c64->putMessage(redLED ? MSG_VC1541_RED_LED_ON : MSG_VC1541_RED_LED_OFF);
-    c64->putMessage(rotating ? MSG_VC1541_MOTOR_ON : MSG_VC1541_MOTOR_OFF);
-    c64->putMessage(diskInserted ? MSG_VC1541_DISK : MSG_VC1541_NO_DISK);
+    putMessage(redLED ? MSG_VC1541_RED_LED_ON : MSG_VC1541_RED_LED_OFF);
+    putMessage(rotating ? MSG_VC1541_MOTOR_ON : MSG_VC1541_MOTOR_OFF);
+    putMessage(diskInserted ? MSG_VC1541_DISK : MSG_VC1541_NO_DISK);
 
     // TODO: Replace manual pinging of sub components by a call to super::ping()
     cpu.ping();
@@ -260,10 +295,10 @@ VC1541::setRedLED(bool b)
 {
     if (!redLED && b) {
         redLED = true;
-        c64->putMessage(MSG_VC1541_RED_LED_ON);
+        putMessage(MSG_VC1541_RED_LED_ON);
     } else if (redLED && !b) {
         redLED = false;
-        c64->putMessage(MSG_VC1541_RED_LED_OFF);
+        putMessage(MSG_VC1541_RED_LED_OFF);
     }
 }
 
@@ -272,10 +307,10 @@ VC1541::setRotating(bool b)
 {
     if (!rotating && b) {
         rotating = true;
-        c64->putMessage(MSG_VC1541_MOTOR_ON);
+        putMessage(MSG_VC1541_MOTOR_ON);
     } else if (rotating && !b) {
         rotating = false;
-        c64->putMessage(MSG_VC1541_MOTOR_OFF);
+        putMessage(MSG_VC1541_MOTOR_OFF);
     }
 }
 
@@ -286,6 +321,7 @@ VC1541::moveHeadUp()
 
         float position = (float)bitoffset / (float)disk.length.halftrack[halftrack];
         halftrack++;
+        disk.requestHalftrack(halftrack);
         bitoffset = position * disk.length.halftrack[halftrack];
          
         // Make sure new bitoffset starts at the beginning of a new byte to keep fast loader happy
@@ -297,9 +333,9 @@ VC1541::moveHeadUp()
    
     assert(disk.isValidDiskPositon(halftrack, bitoffset));
     
-    c64->putMessage(MSG_VC1541_HEAD_UP);
+    putMessage(MSG_VC1541_HEAD_UP);
     if (halftrack % 2 && sendSoundMessages)
-        c64->putMessage(MSG_VC1541_HEAD_UP_SOUND); // play sound for full tracks, only
+        putMessage(MSG_VC1541_HEAD_UP_SOUND); // play sound for full tracks, only
 }
 
 void
@@ -308,6 +344,7 @@ VC1541::moveHeadDown()
     if (halftrack > 1) {
         float position = (float)bitoffset / (float)disk.length.halftrack[halftrack];
         halftrack--;
+        disk.requestHalftrack(halftrack);
         bitoffset = position * disk.length.halftrack[halftrack];
 
         // Make sure new bitoffset starts at the beginning of a new byte to keep fast loader happy
@@ -319,9 +356,9 @@ VC1541::moveHeadDown()
     
     assert(disk.isValidDiskPositon(halftrack, bitoffset));
     
-    c64->putMessage(MSG_VC1541_HEAD_DOWN);
+    putMessage(MSG_VC1541_HEAD_DOWN);
     if (halftrack % 2 && sendSoundMessages)
-        c64->putMessage(MSG_VC1541_HEAD_DOWN_SOUND); // play sound for full tracks, only
+        putMessage(MSG_VC1541_HEAD_DOWN_SOUND); // play sound for full tracks, only
 }
 
 void
@@ -374,10 +411,13 @@ VC1541::insertDisk(Archive *a)
             break;
     }
     
+    disk.requestHalftrack(halftrack);
+    disk.shareData();
+    headBitsCount = 0;
     diskInserted = true;
-    c64->putMessage(MSG_VC1541_DISK);
+    putMessage(MSG_VC1541_DISK);
     if (sendSoundMessages)
-        c64->putMessage(MSG_VC1541_DISK_SOUND);
+        putMessage(MSG_VC1541_DISK_SOUND);
 
     // If bit accuracy is disabled, we write-protect the disk
     disk.setWriteProtection(!bitAccuracy);
@@ -404,33 +444,67 @@ VC1541::ejectDisk()
 	setDiskPartiallyInserted(false);
 		
     // Notify listener
-	c64->putMessage(MSG_VC1541_NO_DISK);
+	putMessage(MSG_VC1541_NO_DISK);
     if (sendSoundMessages)
-        c64->putMessage(MSG_VC1541_NO_DISK_SOUND);
+        putMessage(MSG_VC1541_NO_DISK_SOUND);
 }
 
 D64Archive *
 VC1541::convertToD64()
 {
-    D64Archive *archive = new D64Archive();
     debug(1, "Creating D64 archive from currently inserted diskette ...\n");
     
+    D64Archive *image = getD64Image();
+    
+    if (image == NULL)
+        return NULL;
+    
+    // Hand out a copy, because the image is owned by the drive
+    size_t size = image->writeToBuffer(NULL);
+    uint8_t *buffer = new uint8_t[size];
+    image->writeToBuffer(buffer);
+    D64Archive *archive = D64Archive::makeD64ArchiveWithBuffer(buffer, size);
+    delete[] buffer;
+    
+    return archive;
+}
+
+D64Archive *
+VC1541::getD64Image()
+{
+    if (d64Image == NULL) {
+        d64Image = new D64Archive();
+        d64Image->setNumberOfTracks(42);
+    }
+    
+    // Decode all tracks that have been written since the previous call
+    if (disk.decodeModifiedTracks(d64Image)) {
+        return d64Image;
+    }
+    
+    // The disk has an irregular layout. Decode it as a whole.
+    debug(2, "Decoding the whole diskette ...\n");
+    
     // Perform test run
     int error;
     if (disk.decodeDisk(NULL, &error) > D64_802_SECTORS_ECC || error) {
-        archive->warn("Cannot create archive (error code: %d)\n", error);
-        delete archive;
+        d64Image->warn("Cannot create archive (error code: %d)\n", error);
+        delete d64Image;
+        d64Image = NULL;
         return NULL;
     }
     
     // Decode diskette
-    archive->setNumberOfTracks(42);
-    disk.decodeDisk(archive->getData());
+    memset(d64Image->getData(), 0, d64Image->writeToBuffer(NULL));
+    disk.decodeDisk(d64Image->getData());
     
-    archive->debug(2, "Archive has %d files\n", archive->getNumberOfItems());
-    archive->debug(2, "Item %d has size: %d\n", 0, archive->getSizeOfItem(0));
+    // Make sure that the next call doesn't mix up both layouts
+    disk.setModifiedHalftracks();
     
-    return archive;
+    d64Image->debug(2, "Archive has %d files\n", d64Image->getNumberOfItems());
+    d64Image->debug(2, "Item %d has size: %d\n", 0, d64Image->getSizeOfItem(0));
+    
+    return d64Image;
 }
 
 bool
@@ -438,14 +512,12 @@ VC1541::exportToD64(const char *filename)
 {
     assert(filename != NULL);
 
-    D64Archive *archive = convertToD64();
+    D64Archive *archive = getD64Image();
     
     if (archive == NULL)
         return false;
     
-    archive->writeToFile(filename);
-    delete archive;
-    return true;
+    return archive->writeToFile(filename);
 }
 
 void
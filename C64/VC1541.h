@@ -64,6 +64,14 @@ public:
     
     //! @brief    Resets the VC1541 drive.
     void reset();
+    
+    //! @brief    Loads the current state from a buffer
+    void loadFromBuffer(uint8_t **buffer);
+    
+    /*! @brief    Leaves the drive out of snapshots while it is disconnected
+     *  @details  A disconnected drive is switched off and doesn't run. Only the disk is saved.
+     */
+    bool savesSubComponent(VirtualComponent *component);
 
     /*! @brief    Resets disk properties
      *  @details  Resets all disk related properties. reset() keeps the disk alive. 
@@ -121,6 +129,15 @@ public:
     //! @brief    Enables or disables bit accurate drive emulation.
     void setBitAccuracy(bool b);
 
+    //! @brief    Returns the device number of this drive (8 to 11).
+    inline unsigned getDeviceNr() { return deviceNr; }
+    
+    /*! @brief    Sets the device number of this drive.
+     *  @details  The number is hard-wired like the address jumpers of a real drive. The DOS
+     *            reads it from VIA1 port B. Call this function before the drive is reset.
+     */
+    inline void setDeviceNr(unsigned nr) { assert(nr >= 8 && nr <= 11); deviceNr = nr; }
+
     
     //
     //! @functiongroup Accessing drive properties
@@ -177,7 +194,17 @@ public:
      */
     D64Archive *convertToD64();
 
-    //! @brief    Exports the currently inserted disk to D64 file.
+    /*! @brief    Returns an up-to-date D64 image of the currently inserted disk
+     *  @details  Only the tracks that have been written since the previous call are decoded.
+     *            Hence, calling this function periodically, e.g., to autosave a disk, is cheap.
+     *  @result   The image is owned by the drive and stays valid until the next call.
+     *            NULL if the disk cannot be converted.
+     */
+    D64Archive *getD64Image();
+    
+    /*! @brief    Exports the currently inserted disk to D64 file.
+     *  @see      getD64Image
+     */
     bool exportToD64(const char *filename);
     
     //
@@ -268,6 +295,12 @@ private:
      */
     bool diskPartiallyInserted;
     
+    /*! @brief    D64 image of the inserted disk
+     *  @details  The image is created by the first call to getD64Image() and kept up to date
+     *            by decoding the modified tracks, only. It is not part of a snapshot.
+     */
+    D64Archive *d64Image;
+    
     /*! @brief    Indicates whether VC1541 is simulated on the bit level
      *  @details  Bit level simulation is the standard emulation mode. If it is disabled, the
      *            emulator uses a fast load mechanism to make disk data available whenever the
@@ -278,6 +311,14 @@ private:
 
     //! @brief    Indicates whether the VC1541 shall provide sound notification messages to the GUI
     bool sendSoundMessages;
+    
+    //! @brief    Device number on the IEC bus
+    unsigned deviceNr;
+    
+    /*! @brief    Sends a notification message to the GUI
+     *  @details  The GUI displays a single drive. Hence, only device 8 sends messages.
+     */
+    void putMessage(VC64Message msg);
 
 
     // ---------------------------------------------------------------------------------------------
@@ -305,6 +346,18 @@ private:
     //! @brief    Bit position of the read/write head inside the current track
     uint16_t bitoffset;
     
+    /*! @brief    Bits passing under the read/write head next
+     *  @details  The bits are prefetched from the current halftrack, starting at bitoffset which
+     *            is stored in bit 63. rotateDisk() shifts out one bit at a time. The prefetched
+     *            bits never cross the end of the halftrack. Hence, the wrap-around needs to be
+     *            dealt with once per refill, only. This variable is derived from the drive state
+     *            and not part of a snapshot.
+     */
+    uint64_t headBits;
+    
+    //! @brief    Number of valid bits in headBits (0 = refill on next read)
+    unsigned headBitsCount;
+    
     /*! @brief    Current disk zone
      *  @details  Each track belongs to one of four zones. Whenever the drive moves the r/w head,
      *            it computed the new number and writes into PB5 and PB6 of via2. These bits are
@@ -346,7 +399,7 @@ public:
 
     //! @brief    Sets the current halftrack position of the drive head
     void setHalftrack(Halftrack ht) {
-        if (isHalftrackNumber(ht)) halftrack = ht;
+        if (isHalftrackNumber(ht)) { halftrack = ht; disk.requestHalftrack(ht); headBitsCount = 0; }
     }
 
     //! @brief    Returns the number of bits in the current halftrack
@@ -357,7 +410,7 @@ public:
 
     //! @brief    Sets bit position of the read/write head inside the current track
     void setBitOffset(uint16_t offset) {
-        if (hasDisk() && disk.isValidDiskPositon(halftrack, offset)) bitoffset = offset;
+        if (hasDisk() && disk.isValidDiskPositon(halftrack, offset)) { bitoffset = offset; headBitsCount = 0; }
     }
 
     //! @brief    Moves head one halftrack up
@@ -385,35 +438,60 @@ public:
     /*! @brief    Reads a single bit from the disk head
      *  @result   0 or 1
      */
-    inline uint8_t readBitFromHead() { return disk.readBitFromHalftrack(halftrack, bitoffset); }
+    inline uint8_t readBitFromHead() {
+        if (headBitsCount == 0 && !prefetchHeadBits())
+            return disk.readBitFromHalftrack(halftrack, bitoffset);
+        return (uint8_t)(headBits >> 63); }
 
     /*! @brief    Reads a single byte from the disk head
      *  @result   0 ... 255
      */
-    inline uint8_t readByteFromHead() { return disk.readByteFromHalftrack(halftrack, bitoffset); }
+    inline uint8_t readByteFromHead() {
+        if (headBitsCount < 8 && prefetchHeadBits() < 8)
+            return disk.readByteFromHalftrack(halftrack, bitoffset);
+        return (uint8_t)(headBits >> 56); }
     
     //! @brief Writes a single bit to the disk head
-    inline void writeBitToHead(uint8_t bit) { disk.writeBitToHalftrack(halftrack, bitoffset, bit); }
+    inline void writeBitToHead(uint8_t bit) {
+        disk.writeBitToHalftrack(halftrack, bitoffset, bit);
+        headBits = bit ? (headBits | (1ULL << 63)) : (headBits & ~(1ULL << 63)); }
     
     //! @brief Writes a single byte to the disk head
-    inline void writeByteToHead(uint8_t byte) { disk.writeByteToHalftrack(halftrack, bitoffset, byte); }
+    inline void writeByteToHead(uint8_t byte) {
+        disk.writeByteToHalftrack(halftrack, bitoffset, byte); headBitsCount = 0; }
 
     //! @brief  Advances drive head position by one bit
-    inline void rotateDisk() { if (++bitoffset >= disk.length.halftrack[halftrack]) bitoffset = 0; }
+    inline void rotateDisk() {
+        if (++bitoffset >= disk.length.halftrack[halftrack]) bitoffset = 0;
+        if (headBitsCount) { headBits <<= 1; headBitsCount--; } }
 
     //! @brief  Moves drive head position back by one bit
-    inline void rotateBack() { bitoffset = (bitoffset > 0) ? (bitoffset - 1) : (disk.length.halftrack[halftrack] - 1); }
+    inline void rotateBack() {
+        bitoffset = (bitoffset > 0) ? (bitoffset - 1) : (disk.length.halftrack[halftrack] - 1);
+        headBitsCount = 0; }
 
 private:
     
+    /*! @brief  Refills headBits, starting at the current head position
+     *  @result Number of prefetched bits (0 if the head position is beyond the end of the halftrack)
+     */
+    unsigned prefetchHeadBits() {
+        return headBitsCount = disk.readBitsFromHalftrack(halftrack, bitoffset, &headBits); }
+    
     //! @brief  Advances drive head position by eight bits
-    inline void rotateDiskByOneByte() { for (unsigned i = 0; i < 8; i++) rotateDisk(); }
+    inline void rotateDiskByOneByte() {
+        if (headBitsCount >= 8 && bitoffset + 8 < disk.length.halftrack[halftrack]) {
+            bitoffset += 8; headBits <<= 8; headBitsCount -= 8;
+        } else {
+            for (unsigned i = 0; i < 8; i++) rotateDisk();
+        }
+    }
 
     //! @brief  Moves drive head position back by eight bits
     inline void rotateBackByOneByte() { for (unsigned i = 0; i < 8; i++) rotateBack(); }
 
     //! @brief  Align drive head to the beginning of a byte
-    inline void alignHead() { bitoffset &= 0xFFF8; byteReadyCounter = 0; }
+    inline void alignHead() { bitoffset &= 0xFFF8; byteReadyCounter = 0; headBitsCount = 0; }
 
     //! @brief Signals the CPU that a byte has been processed
     inline void byteReady();
@@ -26,13 +26,14 @@ VC1541Memory::VC1541Memory()
     // Register snapshot items
     SnapshotItem items[] = {
 
-    { mem,              0xC000,     CLEAR_ON_RESET },
-    { &mem[0xC000],     0x4000,     KEEP_ON_RESET  }, /* VC1541 Rom */
+    { mem,              0xC000,     CLEAR_ON_RESET, dirty,          0x100 },
+    { &mem[0xC000],     0x4000,     KEEP_ON_RESET,  &dirty[0xC0],   0x100,  &romBlob }, /* VC1541 Rom */
     { NULL,             0,          0 }};
 
     registerSnapshotItems(items, sizeof(items));
 
 	romFile = NULL;
+    romBlob = 0;
 }
 
 VC1541Memory::~VC1541Memory()
@@ -75,6 +76,7 @@ VC1541Memory::loadRom(const char *filename)
 	if (is1541Rom(filename)) {
 		romFile = strdup(filename);
 		flashRom(filename, 0xC000);
+        shareBlob(&romBlob, &mem[0xC000], 0x4000);
 		return true;
 	}
 	return false;
@@ -171,12 +173,15 @@ void
 VC1541Memory::pokeRam(uint16_t addr, uint8_t value)
 {
 	mem[addr] = value;
+    dirty[addr >> 8] = 1;
 }
 
 void 
 VC1541Memory::pokeRom(uint16_t addr, uint8_t value)
 {
+    if (romBlob) unshareBlob(&romBlob);
 	mem[addr] = value;
+    dirty[addr >> 8] = 1;
 }
              
 void 
@@ -197,6 +202,7 @@ VC1541Memory::poke(uint16_t addr, uint8_t value)
 	if (addr < 0x1000) {
 		// RAM (repeats multiply times, hence we apply a bitmask)
 		mem[addr & 0x7ff] = value;
+        dirty[(addr & 0x7ff) >> 8] = 1;
 	} else if (addr >= 0xc000) { 
 		// ROM (poking to ROM has no effect)
 	} else {
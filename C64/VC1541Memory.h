@@ -39,6 +39,15 @@ public:
 		
 	//! @brief    The VC1541s memory space
 	uint8_t mem[65536];
+    
+    /*! @brief    Dirty flags of the memory pages
+     *  @details  The flag of a 256 byte page is set whenever the page is written.
+     *  @see      VirtualComponent::saveDirtyToBuffer
+     */
+    uint8_t dirty[256];
+    
+    //! @brief    Blob store hash of the ROM image (0 if the ROM is not shared)
+    uint64_t romBlob;
 	
     /*! @brief    File name of the VC1541 ROM image.
      *  @details  The file name is set in loadRom(). It is saved for further reference, so the ROM can be reloaded
@@ -94,6 +94,10 @@ public:
      */
     static void setDefaultDebugLevel(unsigned level) { defaultDebugLevel = level; }
 
+    /*! @brief    Returns the debug level of this object.
+     */
+    unsigned getDebugLevel() { return debugLevel; }
+
     /*! @brief    Changes the debug level for a specific object.
      */
     void setDebugLevel(unsigned level) { debugLevel = level; }
@@ -56,9 +56,6 @@ VIA6522::~VIA6522()
 void VIA6522::reset()
 {
     VirtualComponent::reset();
-
-    // Establish bindings
-    floppy = &c64->floppy;
 }
 
 void 
@@ -438,6 +435,7 @@ uint8_t VIA1::peek(uint16_t addr)
             // Port values (outside the chip)
             uint8_t external =
             (floppy->iec->getAtnLine() /* 7 */ ? 0x00 : 0x80) |
+            ((floppy->getDeviceNr() - 8) << 5) /* 6,5 */ |
             (floppy->iec->getClockLine() /* 2 */ ? 0x00 : 0x04) |
             (floppy->iec->getDataLine() /* 0 */ ? 0x00 : 0x01);
             
@@ -446,10 +444,6 @@ uint8_t VIA1::peek(uint16_t addr)
             (ddrb & orb) |      // Values of bits configured as outputs
             (~ddrb & external); // Values of bits configured as inputs
             
-            // Set device address to zero
-            // TODO: Device address is "hard-wired". Set it in "external", above
-            result &= 0x9F;
-            
             return result;
         }
             
@@ -479,6 +473,7 @@ uint8_t VIA1::read(uint16_t addr)
             // Port values (outside the chip)
             uint8_t external =
             (floppy->iec->getAtnLine() /* 7 */ ? 0x00 : 0x80) |
+            ((floppy->getDeviceNr() - 8) << 5) /* 6,5 */ |
             (floppy->iec->getClockLine() /* 2 */ ? 0x00 : 0x04) |
             (floppy->iec->getDataLine() /* 0 */ ? 0x00 : 0x01);
             
@@ -487,7 +482,6 @@ uint8_t VIA1::read(uint16_t addr)
             (ddrb & orb) |      // Values of bits configured as outputs
             (~ddrb & external); // Values of bits configured as inputs
             
-            result &= 0x9F;
             return result;
         }
             
@@ -518,7 +512,7 @@ void VIA1::poke(uint16_t addr, uint8_t value)
             // |  in   |               |  out  |  out  |  in   |  out  |  in   |
 
 			orb = value;
-			floppy->iec->updateDevicePins(orb, ddrb);
+			floppy->iec->updateDevicePins(floppy->getDeviceNr(), orb, ddrb);
 			return;
 
 		case 0x1: // ORA - Output register A
@@ -539,7 +533,7 @@ void VIA1::poke(uint16_t addr, uint8_t value)
 		
 		case 0x2:
 			ddrb = value;
-			floppy->iec->updateDevicePins(orb, ddrb);
+			floppy->iec->updateDevicePins(floppy->getDeviceNr(), orb, ddrb);
 			return; 
 						
 		default:
@@ -117,6 +117,7 @@ VIC::reset()
     cp.backgroundColor[0] = PixelEngine::BLUE;
     setScreenMemoryAddr(0x400);
     memset(&c64->mem.ram[0x400], 32, 40*25);
+    memset(&c64->mem.dirtyRam[0x04], 1, 4);
 	p.registerCTRL1 = 0x10;
 	expansionFF = 0xFF;
     
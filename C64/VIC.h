@@ -456,6 +456,9 @@ public:
 	//! @brief    Returns the screen buffer that is currently stable.
     inline void *screenBuffer() { return pixelEngine.screenBuffer(); }
 
+    //! @brief    Hides or shows the frame that is currently drawn
+    void setHideFrame(bool value) { pixelEngine.hideFrame = value; }
+
 	//! @brief    Restores the initial state.
 	void reset();
 		
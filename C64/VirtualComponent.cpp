@@ -21,22 +21,34 @@
 
 VirtualComponent::VirtualComponent()
 {
+    c64 = NULL;
     running = false;
 	suspendCounter = 0;	
     snapshotItems = NULL;
+    nativeItems = NULL;
+    nativeFormat = false;
     subComponents = NULL;
     snapshotSize = 0;
+    numBlobItems = 0;
 }
 
 VirtualComponent::~VirtualComponent()
 {
 	debug(3, "Terminated\n");
     
+    // Release all shared data blocks
+    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++)
+        if (snapshotItems[i].blob != NULL && *snapshotItems[i].blob != 0)
+            BlobStore::unshare(*snapshotItems[i].blob, snapshotItems[i].blob);
+    
     if (subComponents)
         delete [] subComponents;
 
     if (snapshotItems)
         delete [] snapshotItems;
+    
+    if (nativeItems)
+        delete [] nativeItems;
 }
 
 void
@@ -59,8 +71,13 @@ VirtualComponent::reset()
     // Clear snapshot items marked with 'CLEAR_ON_RESET'
     if (snapshotItems != NULL)
         for (unsigned i = 0; snapshotItems[i].data != NULL; i++)
-            if (snapshotItems[i].flags & CLEAR_ON_RESET)
+            if (snapshotItems[i].flags & CLEAR_ON_RESET) {
+                if (snapshotItems[i].blob != NULL)
+                    unshareBlob(snapshotItems[i].blob);
                 memset(snapshotItems[i].data, 0, snapshotItems[i].size);
+            }
+    
+    markItemsDirty();
     
     stopTracing();
     
@@ -174,8 +191,32 @@ VirtualComponent::registerSnapshotItems(SnapshotItem *items, unsigned length) {
     std::copy(items, items + numItems, &snapshotItems[0]);
     
     // Determine size of snapshot on disk
-    for (i = snapshotSize = 0; snapshotItems[i].data != NULL; i++)
-        snapshotSize += snapshotItems[i].size;
+    for (i = snapshotSize = numBlobItems = 0; snapshotItems[i].data != NULL; i++)
+        if (snapshotItems[i].blob == NULL)
+            snapshotSize += snapshotItems[i].size;
+        else
+            numBlobItems++;
+    
+    // Merge items that are adjacent in memory for the native format
+    unsigned j = 0;
+    nativeItems = new SnapshotItem[numItems];
+    for (i = 0; snapshotItems[i].data != NULL; i++) {
+        
+        SnapshotItem *item = &snapshotItems[i];
+        SnapshotItem *prev = j ? &nativeItems[j - 1] : NULL;
+        bool plain = item->dirty == NULL && item->blob == NULL;
+        
+        if (plain && prev && prev->dirty == NULL && prev->blob == NULL &&
+            (uint8_t *)prev->data + prev->size == item->data) {
+            prev->size += item->size;
+            continue;
+        }
+        nativeItems[j] = *item;
+        nativeItems[j++].flags = BYTE_FORMAT;
+    }
+    nativeItems[j] = snapshotItems[i];
+    
+    debug(3, "%d snapshot items (%d in native format)\n", i, j);
 }
 
 void
@@ -196,58 +237,50 @@ VirtualComponent::registerSubComponents(VirtualComponent **components, unsigned
 size_t
 VirtualComponent::stateSize()
 {
-    uint32_t result = snapshotSize;
+    size_t result = itemsSize();
     
     if (subComponents != NULL)
         for (unsigned i = 0; subComponents[i] != NULL; i++)
-            result += subComponents[i]->stateSize();
+            if (savesSubComponent(subComponents[i]))
+                result += subComponents[i]->stateSize();
+
+    return result;
+}
 
+size_t
+VirtualComponent::itemsSize()
+{
+    size_t result = snapshotSize;
+    
+    // Add items that can be shared via the blob store (tag byte plus hash or data)
+    for (unsigned i = 0; numBlobItems && snapshotItems[i].data != NULL; i++)
+        if (snapshotItems[i].blob != NULL)
+            result += 1 + (*snapshotItems[i].blob ? sizeof(uint64_t) : snapshotItems[i].size);
+    
     return result;
 }
 
 void
 VirtualComponent::loadFromBuffer(uint8_t **buffer)
 {
-    uint8_t *old = *buffer;
-    
-    debug(3, "    Loading internal state (%d bytes) ...\n", VirtualComponent::stateSize());
+    debug(3, "    Loading internal state ...\n");
     
     // Load internal state of sub components
     if (subComponents != NULL)
         for (unsigned i = 0; subComponents[i] != NULL; i++)
-            subComponents[i]->loadFromBuffer(buffer);
+            if (savesSubComponent(subComponents[i]))
+                subComponents[i]->loadFromBuffer(buffer);
 
-    // Load own internal state
-    void *data; size_t size; int flags;
-    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++) {
-        
-        data  = snapshotItems[i].data;
-        flags = snapshotItems[i].flags & 0x0F;
-        size  = snapshotItems[i].size;
-        
-        if (flags == 0) { // Auto detect size
-
-            switch (snapshotItems[i].size) {
-                case 1:  *(uint8_t *)data  = read8(buffer); break;
-                case 2:  *(uint16_t *)data = read16(buffer); break;
-                case 4:  *(uint32_t *)data = read32(buffer); break;
-                case 8:  *(uint64_t *)data = read64(buffer); break;
-                default: readBlock(buffer, (uint8_t *)data, size);
-            }
+    uint8_t *old = *buffer;
 
-        } else { // Format is specified manually
-            
-            switch (flags) {
-                case BYTE_FORMAT: readBlock(buffer, (uint8_t *)data, size); break;
-                case WORD_FORMAT: readBlock16(buffer, (uint16_t *)data, size); break;
-                case DOUBLE_WORD_FORMAT: readBlock32(buffer, (uint32_t *)data, size); break;
-                case QUAD_WORD_FORMAT: readBlock64(buffer, (uint64_t *)data, size); break;
-                default: assert(0);
-            }
-        }
-    }
+    // Load own internal state
+    SnapshotItem *items = nativeFormat ? nativeItems : snapshotItems;
+    for (unsigned i = 0; items != NULL && items[i].data != NULL; i++)
+        loadItemFromBuffer(&items[i], buffer);
+    
+    markItemsDirty();
     
-    if (*buffer - old != VirtualComponent::stateSize()) {
+    if ((size_t)(*buffer - old) != itemsSize()) {
         panic("loadFromBuffer: Snapshot size is wrong.\n");
         assert(false);
     }
@@ -256,52 +289,315 @@ VirtualComponent::loadFromBuffer(uint8_t **buffer)
 void
 VirtualComponent::saveToBuffer(uint8_t **buffer)
 {
-    uint8_t *old = *buffer;
-
-    debug(3, "    Saving internal state (%d bytes) ...\n", VirtualComponent::stateSize());
+    debug(3, "    Saving internal state ...\n");
 
     // Save internal state of sub components
     if (subComponents != NULL) {
         for (unsigned i = 0; subComponents[i] != NULL; i++)
-            subComponents[i]->saveToBuffer(buffer);
+            if (savesSubComponent(subComponents[i]))
+                subComponents[i]->saveToBuffer(buffer);
     }
     
+    uint8_t *old = *buffer;
+    
     // Save own internal state
-    void *data; size_t size; int flags;
-    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++) {
-        
-        data  = snapshotItems[i].data;
-        flags = snapshotItems[i].flags & 0x0F;
-        size  = snapshotItems[i].size;
+    SnapshotItem *items = nativeFormat ? nativeItems : snapshotItems;
+    for (unsigned i = 0; items != NULL && items[i].data != NULL; i++)
+        saveItemToBuffer(&items[i], buffer);
+    
+    if ((size_t)(*buffer - old) != itemsSize()) {
+        panic("saveToBuffer: Snapshot size is wrong.");
+        assert(false);
+    }
+}
 
-        if (flags == 0) { // Auto detect size
-            
-            switch (snapshotItems[i].size) {
-                case 1:  write8(buffer, *(uint8_t *)data); break;
-                case 2:  write16(buffer, *(uint16_t *)data); break;
-                case 4:  write32(buffer, *(uint32_t *)data); break;
-                case 8:  write64(buffer, *(uint64_t *)data); break;
-                default: writeBlock(buffer, (uint8_t *)data, size);
-            }
-            
-        } else { // Format is specified manually
+void
+VirtualComponent::saveDirtyToBuffer(uint8_t **buffer)
+{
+    // Components without dirty flags might override saveToBuffer()
+    if (!tracksDirtyPages()) {
+        saveToBuffer(buffer);
+        return;
+    }
+    
+    debug(3, "    Updating internal state ...\n");
+    
+    // Update internal state of sub components
+    if (subComponents != NULL) {
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            if (savesSubComponent(subComponents[i]))
+                subComponents[i]->saveDirtyToBuffer(buffer);
+    }
+    
+    uint8_t *old = *buffer;
+    
+    // Update own internal state
+    SnapshotItem *items = nativeFormat ? nativeItems : snapshotItems;
+    for (unsigned i = 0; items != NULL && items[i].data != NULL; i++) {
+        
+        SnapshotItem *item = &items[i];
+        
+        if (item->dirty == NULL || (item->blob != NULL && *item->blob != 0)) {
+            saveItemToBuffer(item, buffer);
+            continue;
+        }
+        if (item->blob != NULL) {
+            write8(buffer, 0);
+        }
+        
+        // Only write the dirty pages
+        for (size_t offset = 0, page = 0; offset < item->size; offset += item->pageSize, page++) {
             
-            switch (flags) {
-                case BYTE_FORMAT: writeBlock(buffer, (uint8_t *)data, size); break;
-                case WORD_FORMAT: writeBlock16(buffer, (uint16_t *)data, size); break;
-                case DOUBLE_WORD_FORMAT: writeBlock32(buffer, (uint32_t *)data, size); break;
-                case QUAD_WORD_FORMAT: writeBlock64(buffer, (uint64_t *)data, size); break;
-                default: assert(0);
+            size_t size = MIN(item->pageSize, item->size - offset);
+            if (item->dirty[page]) {
+                memcpy(*buffer, (uint8_t *)item->data + offset, size);
+                item->dirty[page] = 0;
             }
+            *buffer += size;
         }
     }
     
-    if (*buffer - old != VirtualComponent::stateSize()) {
-        panic("saveToBuffer: Snapshot size is wrong.");
+    if ((size_t)(*buffer - old) != itemsSize()) {
+        panic("saveDirtyToBuffer: Snapshot size is wrong.");
         assert(false);
     }
 }
 
+uint64_t
+VirtualComponent::stateHash()
+{
+    uint64_t result = 0;
+    
+    // Hash internal state of sub components
+    if (subComponents != NULL) {
+        for (unsigned i = 0; subComponents[i] != NULL; i++) {
+            if (!savesSubComponent(subComponents[i]))
+                continue;
+            uint64_t hash = subComponents[i]->stateHash();
+            result = hashBlock(&hash, sizeof(hash), result);
+        }
+    }
+    
+    // Hash own internal state
+    for (unsigned i = 0; nativeItems != NULL && nativeItems[i].data != NULL; i++) {
+        
+        SnapshotItem *item = &nativeItems[i];
+        
+        if (item->blob != NULL && *item->blob != 0) {
+            result = hashBlock(item->blob, sizeof(uint64_t), result);
+        } else {
+            result = hashBlock(item->data, item->size, result);
+        }
+    }
+    
+    return result;
+}
+
+void
+VirtualComponent::saveItemToBuffer(SnapshotItem *item, uint8_t **buffer)
+{
+    void *data = item->data;
+    int flags = item->flags & 0x0F;
+    size_t size = item->size;
+    
+    // Shared items are saved as a tag byte, followed by the hash or the data
+    if (item->blob != NULL) {
+        write8(buffer, *item->blob ? 1 : 0);
+        if (*item->blob) {
+            write64(buffer, *item->blob);
+            return;
+        }
+    }
+    
+    if (flags == 0) { // Auto detect size
+        
+        switch (size) {
+            case 1:  write8(buffer, *(uint8_t *)data); break;
+            case 2:  write16(buffer, *(uint16_t *)data); break;
+            case 4:  write32(buffer, *(uint32_t *)data); break;
+            case 8:  write64(buffer, *(uint64_t *)data); break;
+            default: writeBlock(buffer, (uint8_t *)data, size);
+        }
+        
+    } else { // Format is specified manually
+        
+        switch (flags) {
+            case BYTE_FORMAT: writeBlock(buffer, (uint8_t *)data, size); break;
+            case WORD_FORMAT: writeBlock16(buffer, (uint16_t *)data, size); break;
+            case DOUBLE_WORD_FORMAT: writeBlock32(buffer, (uint32_t *)data, size); break;
+            case QUAD_WORD_FORMAT: writeBlock64(buffer, (uint64_t *)data, size); break;
+            default: assert(0);
+        }
+    }
+}
+
+void
+VirtualComponent::loadItemFromBuffer(SnapshotItem *item, uint8_t **buffer)
+{
+    void *data = item->data;
+    int flags = item->flags & 0x0F;
+    size_t size = item->size;
+    
+    if (item->blob != NULL && loadBlobFromBuffer(item, buffer))
+        return;
+    
+    if (flags == 0) { // Auto detect size
+        
+        switch (size) {
+            case 1:  *(uint8_t *)data  = read8(buffer); break;
+            case 2:  *(uint16_t *)data = read16(buffer); break;
+            case 4:  *(uint32_t *)data = read32(buffer); break;
+            case 8:  *(uint64_t *)data = read64(buffer); break;
+            default: readBlock(buffer, (uint8_t *)data, size);
+        }
+        
+    } else { // Format is specified manually
+        
+        switch (flags) {
+            case BYTE_FORMAT: readBlock(buffer, (uint8_t *)data, size); break;
+            case WORD_FORMAT: readBlock16(buffer, (uint16_t *)data, size); break;
+            case DOUBLE_WORD_FORMAT: readBlock32(buffer, (uint32_t *)data, size); break;
+            case QUAD_WORD_FORMAT: readBlock64(buffer, (uint64_t *)data, size); break;
+            default: assert(0);
+        }
+    }
+}
+
+bool
+VirtualComponent::loadBlobFromBuffer(SnapshotItem *item, uint8_t **buffer)
+{
+    uint64_t hash = read8(buffer) ? read64(buffer) : 0;
+    
+    if (hash == 0) {
+        
+        // The data follows inline
+        unshareBlob(item->blob);
+        return false;
+    }
+    
+    if (hash != *item->blob) {
+        
+        if (*item->blob)
+            BlobStore::unshare(*item->blob, item->blob);
+        *item->blob = hash;
+        
+        if (!BlobStore::copy(hash, (uint8_t *)item->data, item->size) || !BlobStore::retain(hash)) {
+            warn("Blob %016llX is missing. Snapshot is corrupted.\n", hash);
+            memset(item->data, 0, item->size);
+            *item->blob = 0;
+        }
+    }
+    
+    return true;
+}
+
+void
+VirtualComponent::shareBlob(uint64_t *blob, const void *data, size_t size)
+{
+    if (*blob)
+        BlobStore::unshare(*blob, blob);
+    *blob = BlobStore::share((const uint8_t *)data, size, blob);
+
+    // The snapshot layout has changed
+    if (c64 != NULL)
+        c64->markDirty();
+}
+
+bool
+VirtualComponent::retainBlob(uint64_t *blob, uint64_t hash)
+{
+    if (*blob == hash)
+        return true;
+    if (!BlobStore::retain(hash))
+        return false;
+    
+    if (*blob)
+        BlobStore::unshare(*blob, blob);
+    *blob = hash;
+    
+    // The snapshot layout has changed
+    if (c64 != NULL)
+        c64->markDirty();
+    return true;
+}
+
+void
+VirtualComponent::unshareBlob(uint64_t *blob)
+{
+    if (*blob == 0)
+        return;
+    
+    BlobStore::unshare(*blob, blob);
+    *blob = 0;
+    
+    // The snapshot layout has changed
+    if (c64 != NULL)
+        c64->markDirty();
+}
+
+unsigned
+VirtualComponent::collectBlobs(uint64_t *hashes, unsigned max)
+{
+    unsigned count = 0;
+    
+    if (subComponents != NULL)
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            if (savesSubComponent(subComponents[i]))
+                count += subComponents[i]->collectBlobs(hashes + count, max - count);
+    
+    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++)
+        if (snapshotItems[i].blob != NULL && *snapshotItems[i].blob != 0 && count < max)
+            hashes[count++] = *snapshotItems[i].blob;
+    
+    return count;
+}
+
+void
+VirtualComponent::markDirty()
+{
+    if (subComponents != NULL)
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            subComponents[i]->markDirty();
+    
+    markItemsDirty();
+}
+
+void
+VirtualComponent::markItemsDirty()
+{
+    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++) {
+        
+        SnapshotItem *item = &snapshotItems[i];
+        if (item->dirty != NULL)
+            memset(item->dirty, 1, (item->size + item->pageSize - 1) / item->pageSize);
+    }
+}
+
+void
+VirtualComponent::setNativeFormat(bool value)
+{
+    if (subComponents != NULL)
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            subComponents[i]->setNativeFormat(value);
+    
+    nativeFormat = value;
+}
+
+bool
+VirtualComponent::tracksDirtyPages()
+{
+    for (unsigned i = 0; snapshotItems != NULL && snapshotItems[i].data != NULL; i++)
+        if (snapshotItems[i].dirty != NULL)
+            return true;
+    
+    if (subComponents != NULL)
+        for (unsigned i = 0; subComponents[i] != NULL; i++)
+            if (subComponents[i]->tracksDirtyPages())
+                return true;
+    
+    return false;
+}
+
 void
 VirtualComponent::write8_delayed(uint8_delayed &var, uint8_t value)
 {
@@ -22,6 +22,7 @@
 #define _VIRTUAL_COMPONENT_INC
 
 #include "VC64Object.h"
+#include "BlobStore.h"
 
 // Forward declarations
 class C64;
@@ -178,12 +179,22 @@ protected:
     };
 
     /*! @brief Fingerprint of a snapshot item
-     */
-    typedef struct {
+     *  @details Large byte arrays can be equipped with dirty flags, one for each page of
+     *           pageSize bytes. The owning component has to set the flag of a page whenever
+     *           it writes into it. saveDirtyToBuffer() skips all pages that are not dirty.
+     *           Immutable byte arrays such as ROMs can be shared via the blob store. As long
+     *           as the blob hash is not 0, only the hash is written into snapshots.
+     *           The optional fields default to zero, so that items can be specified by
+     *           data, size, and flags only.
+     */
+    typedef struct SnapshotItem {
         
         void *data;
         size_t size;
         uint8_t flags;
+        uint8_t *dirty = NULL;
+        size_t pageSize = 0;
+        uint64_t *blob = NULL;
         
     } SnapshotItem;
     
@@ -192,10 +203,26 @@ protected:
      */
     SnapshotItem *snapshotItems;
     
+    /*! @brief    Snapshot items used in native format
+     *  @details  The list is derived from snapshotItems in registerSnapshotItems(). Items
+     *            that are adjacent in memory are merged into a single byte block, so that
+     *            they can be copied with a single memcpy.
+     */
+    SnapshotItem *nativeItems;
+    
+    /*! @brief    Indicates whether the internal state is serialized in native format
+     *  @see      setNativeFormat
+     */
+    bool nativeFormat;
+    
     /*! @brief    Snapshot size on disk (in bytes)
+     *  @details  Items that can be shared via the blob store are not included.
      */
     unsigned snapshotSize;
     
+    //! @brief    Number of snapshot items that can be shared via the blob store
+    unsigned numBlobItems;
+    
     /*! @brief    Registers all snapshot items for this component
      *  @abstract Snaphshot items are usually registered in the constructor of a virtual component.
      *  @param    items Pointer to the first element of a SnapshotItem* array. The end of the array
@@ -216,6 +243,31 @@ protected:
      *  @param    legth Size of the subComponent array in bytes.
      */
     void registerSubComponents(VirtualComponent **subComponents, unsigned length);
+    
+    /*! @brief    Indicates whether the state of a sub component is saved
+     *  @details  Components override this function to leave out sub components that are
+     *            switched off. The answer determines the snapshot layout. When a snapshot
+     *            is loaded, it must already be known before the sub component is reached.
+     */
+    virtual bool savesSubComponent(VirtualComponent *) { return true; }
+
+    /*! @brief    Puts a data block into the blob store
+     *  @details  A previously shared blob is released. The blob refers to the data where
+     *            it is. If the blob store cannot take the data, the blob hash is set to 0
+     *            and the data is saved as usual.
+     */
+    void shareBlob(uint64_t *blob, const void *data, size_t size);
+    
+    /*! @brief    Refers to a data block that is already in the blob store
+     *  @details  Like shareBlob(), but the data doesn't need to be hashed again.
+     *  @return   false, if the blob store doesn't contain a blob with this hash.
+     */
+    bool retainBlob(uint64_t *blob, uint64_t hash);
+    
+    /*! @brief    Releases a shared data block
+     *  @details  Call this function before the data is modified or freed.
+     */
+    void unshareBlob(uint64_t *blob);
 
 
 public:
@@ -244,6 +296,73 @@ public:
      */
     virtual void saveToBuffer(uint8_t **buffer);
     
+    /*! @brief    Updates a previously saved internal state in a memory buffer
+     *  @details  The buffer must contain the state written by the previous call to this
+     *            function. Pages that have not been written since then are skipped, all
+     *            other data is written as in saveToBuffer(). Afterwards, all pages are
+     *            marked clean again. Hence, only a single buffer can be kept up to date
+     *            this way.
+     *  @note     Components with dirty flags must not override saveToBuffer(). Components
+     *            without dirty flags are always saved with saveToBuffer().
+     *  @param    buffer Pointer to next byte to write
+     */
+    virtual void saveDirtyToBuffer(uint8_t **buffer);
+    
+    /*! @brief    Marks all pages of all snapshot items as dirty
+     *  @details  The next call to saveDirtyToBuffer() will write the complete state.
+     */
+    void markDirty();
+    
+    //! @brief    Returns true if this component or one of its sub components tracks dirty pages
+    bool tracksDirtyPages();
+    
+    /*! @brief    Selects the format of the serialized state
+     *  @details  By default, all multi-byte items are stored in big endian byte order, which
+     *            makes the state portable across machines. In native format, all items are
+     *            copied as they are laid out in memory. The state has the same size in both
+     *            formats, but saving and loading is faster in native format. Use it only for
+     *            states that never leave the running process, e.g., in the rewind buffer.
+     *            The format is propagated to all sub components.
+     */
+    void setNativeFormat(bool value);
+    
+    /*! @brief    Collects the hashes of all blobs referenced by the internal state
+     *  @return   Number of hashes written into the array (at most max)
+     */
+    virtual unsigned collectBlobs(uint64_t *hashes, unsigned max);
+    
+    /*! @brief    Computes a hash over the internal state
+     *  @details  The snapshot items of this component and all of its sub components are
+     *            hashed where they live in memory. Nothing is serialized. Items shared via
+     *            the blob store contribute their blob hash. Equal states produce equal
+     *            hashes on hosts with the same byte order. Call the function on a sub
+     *            component to get the hash of this component alone.
+     */
+    virtual uint64_t stateHash();
+    
+private:
+    
+    //! @brief    Saves a single snapshot item to memory buffer
+    void saveItemToBuffer(SnapshotItem *item, uint8_t **buffer);
+    
+    /*! @brief    Returns the size of the own snapshot items in bytes
+     *  @details  In contrast to stateSize(), sub components are not taken into account.
+     */
+    size_t itemsSize();
+    
+    //! @brief    Loads a single snapshot item from memory buffer
+    void loadItemFromBuffer(SnapshotItem *item, uint8_t **buffer);
+    
+    /*! @brief    Loads the tag byte and the hash of a shared snapshot item
+     *  @return   false, if the item data follows inline.
+     */
+    bool loadBlobFromBuffer(SnapshotItem *item, uint8_t **buffer);
+    
+    //! @brief    Marks all pages of the own snapshot items as dirty
+    void markItemsDirty();
+    
+public:
+    
     
     //
     //! @functiongroup Saving single snapshot items
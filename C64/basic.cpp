@@ -17,6 +17,7 @@
  */
 
 #include "basic.h"
+#include "PackedFile.h"
 
 struct timeval t;
 long tv_base = ((void)gettimeofday(&t,NULL), t.tv_sec);
@@ -73,6 +74,21 @@ ascii2pet(uint8_t asciichar)
     }
 }
 
+bool
+matchFilename(const uint8_t *pattern, unsigned length, const char *name)
+{
+    unsigned i;
+    
+    for (i = 0; i < length; i++) {
+        
+        if (pattern[i] == '*')
+            return true;
+        if (name[i] == 0 || (pattern[i] != '?' && pattern[i] != (uint8_t)name[i]))
+            return false;
+    }
+    return name[i] == 0;
+}
+
 
 
 #if 0
@@ -325,6 +341,13 @@ checkFileSuffix(const char *filename, const char *suffix)
 	assert(filename != NULL);
 	assert(suffix != NULL);
 	
+	if (PackedFile::isPackedPath(filename)) {
+        char *unpacked = PackedFile::getUnpackedPath(filename);
+        bool result = checkFileSuffix(unpacked, suffix);
+        free(unpacked);
+        return result;
+    }
+    
 	if (strlen(suffix) > strlen(filename))
 		return false;
 	
@@ -343,6 +366,13 @@ getSizeOfFile(const char *filename)
     if (filename == NULL)
         return -1;
     
+    if (PackedFile::isPackedPath(filename)) {
+        PackedFile *packed = PackedFile::makePackedFileWithPath(filename);
+        long result = packed ? (long)packed->getSizeOfMember(packed->getSelectedMember()) : -1;
+        delete packed;
+        return result;
+    }
+    
     if (stat(filename, &fileProperties) != 0)
         return -1;
     
@@ -376,6 +406,19 @@ checkFileHeader(const char *filename, const uint8_t *header)
 	assert(filename != NULL);
 	assert(header != NULL);
 	
+    // Only decompress the first bytes of a packed file
+    if (PackedFile::isPackedPath(filename)) {
+        PackedFile *packed = PackedFile::makePackedFileWithPath(filename);
+        size_t length = strlen((const char *)header);
+        uint8_t *buffer = (uint8_t *)malloc(length);
+        result = packed && length <= packed->getSizeOfMember(packed->getSelectedMember()) &&
+        packed->extractMember(packed->getSelectedMember(), buffer, length) &&
+        memcmp(buffer, header, length) == 0;
+        free(buffer);
+        delete packed;
+        return result;
+    }
+    
 	if ((file = fopen(filename, "r")) == NULL)
 		return false; 
 
@@ -391,6 +434,54 @@ checkFileHeader(const char *filename, const uint8_t *header)
 	return result;
 }
 
+//! @brief    Rotates a 64 bit value to the left
+static inline uint64_t rotl64(uint64_t x, unsigned n) { return (x << n) | (x >> (64 - n)); }
+
+uint64_t
+hashBlock(const void *data, size_t size, uint64_t seed)
+{
+    const uint64_t k1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint8_t *ptr = (const uint8_t *)data;
+    uint64_t h = seed ^ (size * k1);
+    uint64_t w[4];
+    
+    // Process 32 byte blocks in four independent lanes
+    if (size >= 32) {
+        
+        uint64_t lane[4] = { h + k1 + k2, h + k2, h, h - k1 };
+        
+        for (; size >= 32; size -= 32, ptr += 32) {
+            memcpy(w, ptr, 32);
+            for (unsigned i = 0; i < 4; i++)
+                lane[i] = rotl64(lane[i] + w[i] * k2, 31) * k1;
+        }
+        
+        h = rotl64(lane[0], 1) + rotl64(lane[1], 7) + rotl64(lane[2], 12) + rotl64(lane[3], 18);
+    }
+    
+    // Process remaining words
+    for (; size >= 8; size -= 8, ptr += 8) {
+        memcpy(w, ptr, 8);
+        h ^= rotl64(w[0] * k2, 31) * k1;
+        h = rotl64(h, 27) * k1 + k2;
+    }
+    
+    // Process remaining bytes
+    w[0] = 0;
+    memcpy(w, ptr, size);
+    h ^= rotl64(w[0] * k2, 31) * k1;
+    
+    // Final mix (taken from MurmurHash3)
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    
+    return h;
+}
+
 //! Returns elepased time since application start in microseconds
 uint64_t 
 usec()
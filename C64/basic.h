@@ -30,6 +30,8 @@
 #include <limits.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/param.h>
 #include <time.h>
 #include <mach/mach.h>
@@ -125,6 +127,9 @@ uint8_t petscii2printable(uint8_t c, uint8_t subst);
  */
 uint8_t ascii2pet(uint8_t asciichar);
 
+//! @brief    Checks if a PETSCII file name matches a search pattern with wildcards ('*' and '?')
+bool matchFilename(const uint8_t *pattern, unsigned length, const char *name);
+
 //! @brief    Writes the ASCII representation of 8 bit value to a string.
 void binary8_to_string(uint8_t value, char *s);
 
@@ -162,10 +167,14 @@ char *ExtractFilenameWithoutSuffix(const char *path);
 
 /*! @brief    Check file suffix
  *  @details  The function is used for determining the type of a file. 
+ *            Packed files are checked by the suffix of the decompressed file.
+ *  @see      PackedFile
  */
 bool checkFileSuffix(const char *filename, const char *suffix);
 
-//! @brief    Returns the size of a file in bytes
+/*! @brief    Returns the size of a file in bytes
+ *  @details  The size of a packed file is its size after decompression.
+ */
 long getSizeOfFile(const char *filename);
 
 /*! @brief    Checks the size of a file
@@ -184,6 +193,18 @@ bool checkFileSize(const char *filename, long min, long max);
 */
 bool checkFileHeader(const char *filename, const uint8_t *header);
 
+
+//
+//! @functiongroup Hashing
+//
+
+/*! @brief    Computes a fast, non-cryptographic 64 bit hash of a memory block
+ *  @details  Multiple blocks are hashed by passing the previous result as seed.
+ *            The data is processed in 64 bit words. Hence, the result depends on the
+ *            byte order of the host.
+ */
+uint64_t hashBlock(const void *data, size_t size, uint64_t seed);
+
 //
 //! @functiongroup Managing time
 //
@@ -76,7 +76,10 @@ protected:
   // The 16 selectable sustain levels.
   static reg8 sustain_level[];
 
+  RESID_INLINE void step();
+
 friend class SID;
+friend class VoiceLanes;
 };
 
 
@@ -110,7 +113,16 @@ void EnvelopeGenerator::clock()
   }
 
   rate_counter = 0;
+  step();
+}
 
+
+// ----------------------------------------------------------------------------
+// Envelope step on rate counter match.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void EnvelopeGenerator::step()
+{
   // The first envelope step in the attack state also resets the exponential
   // counter. This has been verified by sampling ENV3.
   //
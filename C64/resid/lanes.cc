@@ -0,0 +1,65 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2026  agent
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#define __LANES_CC__
+#include "lanes.h"
+
+#if RESID_SOA
+
+RESID_NAMESPACE_START
+
+// ----------------------------------------------------------------------------
+// Constructor.
+// ----------------------------------------------------------------------------
+VoiceLanes::VoiceLanes()
+{
+  valid = false;
+}
+
+
+// ----------------------------------------------------------------------------
+// Copy the voice state into the lanes.
+// ----------------------------------------------------------------------------
+void VoiceLanes::load(Voice* voice)
+{
+  for (int i = 0; i < 3; i++) {
+    WaveformGenerator& wave = voice[i].wave;
+    EnvelopeGenerator& envelope = voice[i].envelope;
+    accumulator[i] = wave.accumulator;
+    shift_register[i] = wave.shift_register;
+    freq[i] = wave.freq;
+    test[i] = wave.test ? ~0u : 0;
+    sync[i] = wave.sync ? ~0u : 0;
+    msb_rising[i] = wave.msb_rising ? ~0u : 0;
+    rate_counter[i] = envelope.rate_counter;
+    rate_period[i] = envelope.rate_period;
+  }
+
+  // The unused lane never changes and never matches its rate period.
+  accumulator[3] = shift_register[3] = freq[3] = 0;
+  test[3] = sync[3] = msb_rising[3] = 0;
+  rate_counter[3] = 0;
+  rate_period[3] = 0x10000;
+
+  valid = true;
+}
+
+RESID_NAMESPACE_STOP
+
+#endif // RESID_SOA
@@ -0,0 +1,181 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2026  agent
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#ifndef __LANES_H__
+#define __LANES_H__
+
+#include "siddefs.h"
+#include "voice.h"
+
+#if RESID_SOA
+
+RESID_NAMESPACE_START
+
+// A group of four 32 bit lanes. Lanes 0 - 2 hold the state of voice 1 - 3,
+// lane 3 is unused. Comparisons yield all one bits (true) or all zero bits
+// (false) per lane, which is used for branch free selection.
+typedef unsigned int reg_lanes __attribute__ ((vector_size (16)));
+
+// ----------------------------------------------------------------------------
+// Structure-of-arrays copy of the oscillator and rate counter state of all
+// three voices, allowing them to be clocked in a single SIMD lane group.
+// The WaveformGenerator and EnvelopeGenerator objects remain the master copy:
+// the lanes are written back after each cycle, and reloaded whenever the
+// objects have been modified elsewhere (see invalidate()).
+// ----------------------------------------------------------------------------
+class VoiceLanes
+{
+public:
+  VoiceLanes();
+
+  RESID_INLINE void invalidate();
+  RESID_INLINE void clock(Voice* voice);
+
+protected:
+  void load(Voice* voice);
+  RESID_INLINE void store(Voice* voice);
+
+  // Indicates whether the lanes mirror the voices.
+  bool valid;
+
+  reg_lanes accumulator;
+  reg_lanes shift_register;
+  reg_lanes freq;
+  reg_lanes test;
+  reg_lanes sync;
+  reg_lanes msb_rising;
+  reg_lanes rate_counter;
+  reg_lanes rate_period;
+};
+
+
+// ----------------------------------------------------------------------------
+// Inline functions.
+// The following functions are defined inline because they are called every
+// time a sample is calculated.
+// ----------------------------------------------------------------------------
+
+#if RESID_INLINING || defined(__LANES_CC__)
+
+// ----------------------------------------------------------------------------
+// Force a reload of the lanes on the next clock.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void VoiceLanes::invalidate()
+{
+  valid = false;
+}
+
+
+// ----------------------------------------------------------------------------
+// Write back the lanes.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void VoiceLanes::store(Voice* voice)
+{
+  for (int i = 0; i < 3; i++) {
+    voice[i].wave.accumulator = accumulator[i];
+    voice[i].wave.shift_register = shift_register[i];
+    voice[i].wave.msb_rising = msb_rising[i] != 0;
+    voice[i].envelope.rate_counter = rate_counter[i];
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - 1 cycle.
+// Equivalent to EnvelopeGenerator::clock(), WaveformGenerator::clock(), and
+// WaveformGenerator::synchronize() called for all three voices.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void VoiceLanes::clock(Voice* voice)
+{
+  if (!valid) {
+    load(voice);
+  }
+
+  // Clock rate counters. On the rare occasion of a rate counter match, the
+  // envelope is stepped by the EnvelopeGenerator itself.
+  rate_counter += 1;
+  reg_lanes wrap = (reg_lanes)((rate_counter & 0x8000) != 0);
+  rate_counter = (rate_counter & ~wrap) | (wrap & 1);
+
+  reg_lanes match = (reg_lanes)(rate_counter == rate_period);
+  if (match[0] | match[1] | match[2]) {
+    rate_counter &= ~match;
+    for (int i = 0; i < 3; i++) {
+      if (match[i]) {
+	voice[i].envelope.rate_counter = 0;
+	voice[i].envelope.step();
+	rate_period[i] = voice[i].envelope.rate_period;
+      }
+    }
+  }
+
+  // Clock oscillators. Lanes with the test bit set keep their state,
+  // including the MSB rising flag.
+  reg_lanes accumulator_prev = accumulator;
+  accumulator =
+    (accumulator_prev & test) | (((accumulator_prev + freq) & 0xffffff) & ~test);
+
+  reg_lanes rising = ~accumulator_prev & accumulator;
+  msb_rising =
+    (msb_rising & test) | ((reg_lanes)((rising & 0x800000) != 0) & ~test);
+
+  // Shift noise register once for each time accumulator bit 19 is set high.
+  reg_lanes shift = (reg_lanes)((rising & 0x080000) != 0);
+  reg_lanes bit0 = ((shift_register >> 22) ^ (shift_register >> 17)) & 0x1;
+  shift_register = (shift_register & ~shift)
+    | ((((shift_register << 1) & 0x7fffff) | bit0) & shift);
+
+  // Synchronize oscillators. The sync source of voice n is voice n - 1.
+  // The destination is not synced if the source is synced itself on the same
+  // cycle (see WaveformGenerator::synchronize()).
+  reg_lanes source_msb_rising =
+    __builtin_shufflevector(msb_rising, msb_rising, 2, 0, 1, 3);
+  reg_lanes source_sync =
+    __builtin_shufflevector(sync, sync, 2, 0, 1, 3);
+  reg_lanes source_source_msb_rising =
+    __builtin_shufflevector(msb_rising, msb_rising, 1, 2, 0, 3);
+  accumulator &=
+    ~(source_msb_rising & sync & ~(source_sync & source_source_msb_rising));
+
+  store(voice);
+}
+
+#endif // RESID_INLINING || defined(__LANES_CC__)
+
+RESID_NAMESPACE_STOP
+
+#else // not RESID_SOA
+
+RESID_NAMESPACE_START
+
+// Scalar clocking keeps no copy of the voice state.
+class VoiceLanes
+{
+public:
+  void invalidate() { }
+};
+
+RESID_NAMESPACE_STOP
+
+#endif // RESID_SOA
+
+#endif // not __LANES_H__
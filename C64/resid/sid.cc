@@ -57,6 +57,8 @@ SID::SID()
   bus_value = 0;
   bus_value_ttl = 0;
 
+  envelope_delta_t[0] = envelope_delta_t[1] = 0;
+
   ext_in = 0;
 }
 
@@ -98,6 +100,10 @@ void SID::reset()
 
   bus_value = 0;
   bus_value_ttl = 0;
+
+  envelope_delta_t[0] = envelope_delta_t[1] = 0;
+
+  lanes.invalidate();
 }
 
 
@@ -189,6 +195,18 @@ void SID::write(reg8 offset, reg8 value)
   bus_value = value;
   bus_value_ttl = 0x2000;
 
+  lanes.invalidate();
+
+  // Bring a lagging envelope up to date before its registers change.
+  if (offset >= 0x04 && offset <= 0x06 && envelope_delta_t[0]) {
+    voice[0].envelope.clock(envelope_delta_t[0]);
+    envelope_delta_t[0] = 0;
+  }
+  else if (offset >= 0x0b && offset <= 0x0d && envelope_delta_t[1]) {
+    voice[1].envelope.clock(envelope_delta_t[1]);
+    envelope_delta_t[1] = 0;
+  }
+
   switch (offset) {
   case 0x00:
     voice[0].wave.writeFREQ_LO(value);
@@ -320,6 +338,8 @@ SID::State SID::read_state()
   State state;
   int i, j;
 
+  synchronize_silent();
+
   for (i = 0, j = 0; i < 3; i++, j += 7) {
     WaveformGenerator& wave = voice[i].wave;
     EnvelopeGenerator& envelope = voice[i].envelope;
@@ -397,6 +417,8 @@ void SID::write_state(const State& state)
     voice[i].envelope.state = state.envelope_state[i];
     voice[i].envelope.hold_zero = state.hold_zero[i];
   }
+
+  lanes.invalidate();
 }
 
 
@@ -636,14 +658,18 @@ PointPlotter<sound_sample> SID::fc_plotter()
 // ----------------------------------------------------------------------------
 void SID::clock()
 {
-  int i;
-
   // Age bus value.
   if (--bus_value_ttl <= 0) {
     bus_value = 0;
     bus_value_ttl = 0;
   }
 
+#if RESID_SOA
+  // Clock amplitude modulators and oscillators, and synchronize oscillators.
+  lanes.clock(voice);
+#else
+  int i;
+
   // Clock amplitude modulators.
   for (i = 0; i < 3; i++) {
     voice[i].envelope.clock();
@@ -658,6 +684,7 @@ void SID::clock()
   for (i = 0; i < 3; i++) {
     voice[i].wave.synchronize();
   }
+#endif
 
   // Clock filter.
   filter.clock(voice[0].output(), voice[1].output(), voice[2].output(), ext_in);
@@ -678,6 +705,8 @@ void SID::clock(cycle_count delta_t)
     return;
   }
 
+  lanes.invalidate();
+
   // Age bus value.
   bus_value_ttl -= delta_t;
   if (bus_value_ttl <= 0) {
@@ -747,6 +776,105 @@ void SID::clock(cycle_count delta_t)
 }
 
 
+// ----------------------------------------------------------------------------
+// SID clocking without audio output - delta_t cycles.
+//
+// Only the state that can be observed through the registers is kept up to
+// date, i.e. the bus value, the oscillators (OSC3 depends on the other two
+// voices by ring modulation and hard sync), and the envelope of voice 3
+// (ENV3). The filter and the external filter are not clocked at all.
+// The envelopes of voice 1 and 2 are not visible to the CPU. The cycles
+// they lag behind are accumulated and caught up in one go, either when one
+// of their registers is written, when synchronize_silent() is called, or
+// when the lag exceeds envelope_lag_max cycles (about one PAL frame).
+// ----------------------------------------------------------------------------
+void SID::clock_silent(cycle_count delta_t)
+{
+  int i;
+
+  if (delta_t <= 0) {
+    return;
+  }
+
+  lanes.invalidate();
+
+  // Age bus value.
+  bus_value_ttl -= delta_t;
+  if (bus_value_ttl <= 0) {
+    bus_value = 0;
+    bus_value_ttl = 0;
+  }
+
+  // Clock amplitude modulators.
+  // The lag of voice 1 and 2 is bounded to keep the counters from
+  // overflowing and the eventual catch-up short.
+  for (i = 0; i < 2; i++) {
+    envelope_delta_t[i] += delta_t;
+    if (envelope_delta_t[i] >= envelope_lag_max) {
+      voice[i].envelope.clock(envelope_delta_t[i]);
+      envelope_delta_t[i] = 0;
+    }
+  }
+  voice[2].envelope.clock(delta_t);
+
+  // Clock and synchronize oscillators (see SID::clock(cycle_count)).
+  cycle_count delta_t_osc = delta_t;
+  while (delta_t_osc) {
+    cycle_count delta_t_min = delta_t_osc;
+
+    for (i = 0; i < 3; i++) {
+      WaveformGenerator& wave = voice[i].wave;
+
+      if (!(wave.sync_dest->sync && wave.freq)) {
+	continue;
+      }
+
+      reg16 freq = wave.freq;
+      reg24 accumulator = wave.accumulator;
+
+      reg24 delta_accumulator =
+	(accumulator & 0x800000 ? 0x1000000 : 0x800000) - accumulator;
+
+      cycle_count delta_t_next = delta_accumulator/freq;
+      if (delta_accumulator%freq) {
+	++delta_t_next;
+      }
+
+      if (delta_t_next < delta_t_min) {
+	delta_t_min = delta_t_next;
+      }
+    }
+
+    for (i = 0; i < 3; i++) {
+      voice[i].wave.clock(delta_t_min);
+    }
+
+    for (i = 0; i < 3; i++) {
+      voice[i].wave.synchronize();
+    }
+
+    delta_t_osc -= delta_t_min;
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Catch up the envelopes skipped by clock_silent().
+// Must be called before switching back to clocking with audio output.
+// ----------------------------------------------------------------------------
+void SID::synchronize_silent()
+{
+  lanes.invalidate();
+
+  for (int i = 0; i < 2; i++) {
+    if (envelope_delta_t[i]) {
+      voice[i].envelope.clock(envelope_delta_t[i]);
+      envelope_delta_t[i] = 0;
+    }
+  }
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling.
 // Fixpoint arithmetics is used.
@@ -22,6 +22,7 @@
 
 #include "siddefs.h"
 #include "voice.h"
+#include "lanes.h"
 #include "filter.h"
 #include "extfilt.h"
 #include "pot.h"
@@ -48,6 +49,8 @@ public:
   void clock();
   void clock(cycle_count delta_t);
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
+  void clock_silent(cycle_count delta_t);
+  void synchronize_silent();
   void reset();
   
   // Read/write registers.
@@ -100,6 +103,7 @@ protected:
 				       int n, int interleave);
 
   Voice voice[3];
+  VoiceLanes lanes;
   Filter filter;
   ExternalFilter extfilt;
   Potentiometer potx;
@@ -108,6 +112,10 @@ protected:
   reg8 bus_value;
   cycle_count bus_value_ttl;
 
+  // Cycles the envelopes of voice 1 and 2 lag behind in silent clocking.
+  cycle_count envelope_delta_t[2];
+  enum { envelope_lag_max = 20000 };
+
   double clock_frequency;
 
   // External audio input.
@@ -27,6 +27,26 @@
 #define RESID_INLINING 1
 #define RESID_INLINE inline
 
+// Structure-of-arrays clocking of the three voices on/off.
+// Requires GCC vector extensions and __builtin_shufflevector (Clang, GCC 12
+// and later). Other compilers fall back to scalar clocking.
+// Tools/sidreplay.cpp checks that both settings produce identical output.
+#ifndef RESID_SOA
+#define RESID_SOA 0
+#endif
+
+#if RESID_SOA
+#  if defined(__has_builtin)
+#    if !__has_builtin(__builtin_shufflevector)
+#      undef RESID_SOA
+#      define RESID_SOA 0
+#    endif
+#  else
+#    undef RESID_SOA
+#    define RESID_SOA 0
+#  endif
+#endif
+
 // Support namespace
 
 #ifdef RESID_NAMESPACE
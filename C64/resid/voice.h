@@ -54,6 +54,7 @@ protected:
   sound_sample voice_DC;
 
 friend class SID;
+friend class VoiceLanes;
 };
 
 
@@ -116,6 +116,7 @@ protected:
 
 friend class Voice;
 friend class SID;
+friend class VoiceLanes;
 };
 
 
@@ -601,7 +601,7 @@ struct CRTContainerWrapper { CRTContainer *crtcontainer; };
     joystickB = [[JoystickProxy alloc] initWithJoystick:&c64->joystickB];
     iec = [[IECProxy alloc] initWithIEC:&c64->iec];
     expansionport = [[ExpansionPortProxy alloc] initWithExpansionPort:&c64->expansionport];
-	vc1541 = [[VC1541Proxy alloc] initWithVC1541:&c64->floppy];
+	vc1541 = [[VC1541Proxy alloc] initWithVC1541:&c64->floppy[0]];
     datasette = [[DatasetteProxy alloc] initWithDatasette:&c64->datasette];
     
     // Initialize audio interface
@@ -727,13 +727,13 @@ struct CRTContainerWrapper { CRTContainer *crtcontainer; };
     return wrapper->c64->mem.kernalRomIsLoaded();
 }
 - (bool) isVC1541Rom:(NSURL *)url {
-    return wrapper->c64->floppy.mem.is1541Rom([[url path] UTF8String]);
+    return wrapper->c64->floppy[0].mem.is1541Rom([[url path] UTF8String]);
 }
 - (bool) loadVC1541Rom:(NSURL *)url {
     return [self isVC1541Rom:url] && wrapper->c64->loadRom([[url path] UTF8String]);
 }
 - (bool) isVC1541RomLoaded {
-    return wrapper->c64->floppy.mem.romIsLoaded();
+    return wrapper->c64->floppy[0].mem.romIsLoaded();
 }
 - (bool) isRom:(NSURL *)url {
     return [self isBasicRom:url] || [self isCharRom:url] || [self isKernalRom:url] || [self isVC1541Rom:url];
@@ -773,8 +773,9 @@ struct CRTContainerWrapper { CRTContainer *crtcontainer; };
 - (NSInteger) numAutoSnapshots { return wrapper->c64->numAutoSnapshots(); }
 - (NSData *)autoSnapshotData:(NSInteger)nr {
     Snapshot *snapshot = wrapper->c64->autoSnapshot((unsigned)nr);
-    return [NSData dataWithBytes: (void *)snapshot->header()
-                          length: snapshot->sizeOnDisk()];
+    NSMutableData *data = [NSMutableData dataWithLength: snapshot->sizeOnDisk()];
+    snapshot->writeToBuffer((uint8_t *)[data mutableBytes]);
+    return data;
 }
 - (unsigned char *)autoSnapshotImageData:(NSInteger)nr {
     Snapshot *s = wrapper->c64->autoSnapshot((int)nr); return s ? s->getImageData() : NULL; }
@@ -790,8 +791,9 @@ struct CRTContainerWrapper { CRTContainer *crtcontainer; };
 - (NSInteger) numUserSnapshots { return wrapper->c64->numUserSnapshots(); }
 - (NSData *)userSnapshotData:(NSInteger)nr {
     Snapshot *snapshot = wrapper->c64->userSnapshot((unsigned)nr);
-    return [NSData dataWithBytes: (void *)snapshot->header()
-                          length: snapshot->sizeOnDisk()];
+    NSMutableData *data = [NSMutableData dataWithLength: snapshot->sizeOnDisk()];
+    snapshot->writeToBuffer((uint8_t *)[data mutableBytes]);
+    return data;
 }
 - (unsigned char *)userSnapshotImageData:(NSInteger)nr {
     Snapshot *s = wrapper->c64->userSnapshot((int)nr); return s ? s->getImageData() : NULL; }
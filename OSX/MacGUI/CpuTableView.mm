@@ -83,7 +83,7 @@
         return;
     
     uint16_t addr = [self addressForRow:row];
-	if ([[c64 cpu] breakpoint:addr] == HARD_BREAKPOINT) {
+	if ([[c64 cpu] breakpoint:addr] & HARD_BREAKPOINT) {
 		[cell setTextColor:[NSColor redColor]];
 	} else {
 		[cell setTextColor:[NSColor blackColor]];
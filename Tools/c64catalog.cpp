@@ -0,0 +1,147 @@
+/*!
+ * @header      c64catalog.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ * @brief       Command line tool for indexing a library of archives
+ * @details     The tool builds or updates a catalog file and lists its contents.
+ *              Listing a catalog only maps the index file into memory. No archive
+ *              is opened.
+ *
+ *              Build: c++ -O2 -I../C64 -I../C64/resid c64catalog.cpp <emulator core> -lpthread
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "Catalog.h"
+
+static void
+usage()
+{
+    fprintf(stderr,
+            "Usage: c64catalog -f catalog [-j threads] -b|-u file|directory ...\n"
+            "       c64catalog -f catalog [-l] [archive ...]\n"
+            "  -f  Catalog file\n"
+            "  -b  Build a new catalog of the given files and directory trees\n"
+            "  -u  Update the catalog (unchanged archives are not scanned again)\n"
+            "  -j  Number of worker threads (default: one per CPU core)\n"
+            "  -l  List the directories of all (or the given) archives\n");
+}
+
+static const char *
+typeAsString(ContainerType type)
+{
+    switch (type) {
+        case D64_CONTAINER: return "D64";
+        case T64_CONTAINER: return "T64";
+        case PRG_CONTAINER: return "PRG";
+        case P00_CONTAINER: return "P00";
+        case G64_CONTAINER: return "G64";
+        case NIB_CONTAINER: return "NIB";
+        default: return "???";
+    }
+}
+
+static void
+listImage(Catalog *catalog, unsigned i, bool directory)
+{
+    printf("%-6s %4u items  %s%s\n",
+           typeAsString(catalog->getTypeOfImage(i)),
+           catalog->getNumberOfItems(i),
+           catalog->getPathOfImage(i),
+           catalog->isUpToDate(i) ? "" : " (modified)");
+
+    if (!directory)
+        return;
+
+    for (unsigned n = 0; n < catalog->getNumberOfItems(i); n++) {
+        printf("       %5zu \"%s\" %-5s $%04X %zu bytes\n",
+               catalog->getSizeOfItemInBlocks(i, n),
+               catalog->getNameOfItem(i, n),
+               catalog->getTypeOfItem(i, n),
+               catalog->getDestinationAddrOfItem(i, n),
+               catalog->getSizeOfItem(i, n));
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    unsigned threads = 0;
+    bool build = false, update = false, directory = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:j:bul")) != -1) {
+        switch (opt) {
+            case 'f': filename = optarg; break;
+            case 'j': threads = atoi(optarg); break;
+            case 'b': build = true; break;
+            case 'u': update = true; break;
+            case 'l': directory = true; break;
+            default: usage(); return 1;
+        }
+    }
+    if (filename == NULL || (build && update) || ((build || update) && optind == argc)) {
+        usage();
+        return 1;
+    }
+
+    VC64Object::setDefaultDebugLevel(0);
+    Catalog catalog;
+
+    if (build || update) {
+
+        Catalog previous;
+        if (update && !previous.load(filename)) {
+            return 2;
+        }
+
+        uint64_t start = usec();
+        if (!catalog.build((const char **)argv + optind, argc - optind, threads, update ? &previous : NULL) ||
+            !catalog.save(filename)) {
+            fprintf(stderr, "Cannot build catalog %s\n", filename);
+            return 2;
+        }
+
+        unsigned items = 0;
+        for (unsigned i = 0; i < catalog.getNumberOfImages(); i++)
+            items += catalog.getNumberOfItems(i);
+        printf("%u archives with %u items indexed in %.2f s\n",
+               catalog.getNumberOfImages(), items, (usec() - start) / 1000000.0);
+        return 0;
+    }
+
+    uint64_t start = usec();
+    if (!catalog.load(filename)) {
+        return 2;
+    }
+
+    if (optind == argc) {
+        for (unsigned i = 0; i < catalog.getNumberOfImages(); i++)
+            listImage(&catalog, i, directory);
+    } else {
+        for (int i = optind; i < argc; i++) {
+            int nr = catalog.findImage(argv[i]);
+            if (nr < 0) {
+                printf("%s: not indexed\n", argv[i]);
+            } else {
+                listImage(&catalog, nr, true);
+            }
+        }
+    }
+    fprintf(stderr, "%u archives listed in %.2f ms\n", catalog.getNumberOfImages(), (usec() - start) / 1000.0);
+
+    return 0;
+}
@@ -0,0 +1,518 @@
+/*!
+ * @header      c64disk.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ * @brief       Command line tool for checking and converting disk images in bulk
+ * @details     The tool processes D64, G64, and NIB images without creating a virtual
+ *              computer. Each worker thread owns a single virtual floppy disk which is
+ *              reused for all images it processes.
+ *
+ *              Build: c++ -O2 -I../C64 -I../C64/resid c64disk.cpp <emulator core> -lpthread
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "Disk525.h"
+#include "D64Archive.h"
+#include "G64Archive.h"
+#include "NIBArchive.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+//! @brief    Outcome of processing a single image
+typedef enum {
+    RESULT_OK = 0,
+    RESULT_WARNING,
+    RESULT_ERROR
+} ResultCode;
+
+//! @brief    Result of processing a single image
+typedef struct {
+
+    ResultCode code;
+
+    //! @brief    Human readable summary
+    char message[160];
+
+    //! @brief    Processing time in microseconds
+    uint64_t time;
+
+} Result;
+
+//! @brief    Work shared by all worker threads
+typedef struct {
+
+    //! @brief    Input files
+    char **files;
+    unsigned count;
+
+    //! @brief    Directory of each input file relative to the directory tree it was found in
+    char **dirs;
+
+    //! @brief    Target format (D64_CONTAINER, G64_CONTAINER, or UNKNOWN_CONTAINER_FORMAT to check only)
+    ContainerType target;
+
+    //! @brief    Output directory (NULL = next to the input file)
+    const char *outdir;
+
+    //! @brief    Indicates whether existing files may be overwritten
+    bool force;
+
+    //! @brief    One result per input file
+    Result *results;
+
+    //! @brief    Index of the next file to process
+    unsigned next;
+    pthread_mutex_t lock;
+
+} Job;
+
+
+//
+// Collecting input files
+//
+
+//! @brief    Returns true iff the file has a suffix of a supported disk image format
+static bool
+isDiskImage(const char *path)
+{
+    const char *suffix = strrchr(path, '.');
+
+    return suffix && (strcasecmp(suffix, ".d64") == 0 ||
+                      strcasecmp(suffix, ".g64") == 0 ||
+                      strcasecmp(suffix, ".nib") == 0);
+}
+
+//! @brief    Appends a path to the list of input files
+static void
+addFile(Job *job, const char *path, const char *dir)
+{
+    if ((job->count & (job->count - 1)) == 0) {
+        size_t capacity = job->count ? 2 * job->count : 1;
+        job->files = (char **)realloc(job->files, sizeof(char *) * capacity);
+        job->dirs = (char **)realloc(job->dirs, sizeof(char *) * capacity);
+    }
+    job->files[job->count] = strdup(path);
+    job->dirs[job->count++] = strdup(dir);
+}
+
+/*! @brief    Adds a file or all disk images found in a directory tree
+ *  @param    dir   Location of path relative to the root of the directory tree ("" for the root)
+ */
+static void
+collectFiles(Job *job, const char *path, const char *dir = "")
+{
+    DIR *handle = opendir(path);
+
+    if (handle == NULL) {
+        addFile(job, path, "");
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        char *child = (char *)malloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(child, "%s/%s", path, entry->d_name);
+
+        DIR *subdir = opendir(child);
+        if (subdir) {
+            closedir(subdir);
+            char *childDir = (char *)malloc(strlen(dir) + strlen(entry->d_name) + 2);
+            sprintf(childDir, "%s%s%s", dir, dir[0] ? "/" : "", entry->d_name);
+            collectFiles(job, child, childDir);
+            free(childDir);
+        } else if (isDiskImage(child)) {
+            addFile(job, child, dir);
+        }
+        free(child);
+    }
+    closedir(handle);
+}
+
+
+//
+// Processing images
+//
+
+//! @brief    Creates a directory and all missing parent directories
+static int
+makeDirectories(char *path)
+{
+    if (path[0] == 0)
+        return ENOENT;
+
+    for (char *slash = strchr(path + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+
+        if (slash) slash[0] = 0;
+        int result = mkdir(path, 0777) == 0 || errno == EEXIST ? 0 : errno;
+        if (slash) slash[0] = '/';
+
+        if (result || slash == NULL)
+            return result;
+    }
+}
+
+/*! @brief    Writes an image next to the input file or into the output directory
+ *  @details  Inside the output directory, the directory layout of the input is recreated.
+ *            Existing files are only replaced if the force option is set.
+ *  @return   0 on success, an error number otherwise.
+ */
+static int
+writeImage(Job *job, Container *image, unsigned index, const char *suffix)
+{
+    const char *path = job->files[index];
+    const char *subdir = job->dirs[index];
+    char *name = ExtractFilenameWithoutSuffix(path);
+    char *dir;
+    int result = 0;
+
+    if (job->outdir) {
+        dir = (char *)malloc(strlen(job->outdir) + strlen(subdir) + 2);
+        sprintf(dir, "%s%s%s", job->outdir, subdir[0] ? "/" : "", subdir);
+        result = makeDirectories(dir);
+    } else {
+        dir = strdup(path);
+        char *slash = strrchr(dir, '/');
+        if (slash) slash[0] = 0; else strcpy(dir, ".");
+    }
+
+    char *target = (char *)malloc(strlen(dir) + strlen(name) + strlen(suffix) + 2);
+    sprintf(target, "%s/%s%s", dir, name, suffix);
+
+    size_t size = image->writeToBuffer(NULL);
+    uint8_t *buffer = (uint8_t *)malloc(size);
+    int flags = O_WRONLY | O_CREAT | (job->force ? O_TRUNC : O_EXCL);
+    int fd = -1;
+
+    if (result) {
+        // Output directory cannot be created
+    } else if (size == 0 || buffer == NULL || image->writeToBuffer(buffer) != size) {
+        result = EINVAL;
+    } else if ((fd = open(target, flags, 0666)) < 0) {
+        result = errno;
+    } else {
+        if (write(fd, buffer, size) != (ssize_t)size)
+            result = errno ? errno : EIO;
+        if (close(fd) != 0 && result == 0)
+            result = errno;
+        if (result)
+            unlink(target);
+    }
+
+    free(buffer);
+    free(target);
+    free(dir);
+    free(name);
+    return result;
+}
+
+//! @brief    Checks a D64 image and converts it to G64 if requested
+static void
+processD64(Job *job, Disk525 *disk, unsigned index, Result *result)
+{
+    const char *path = job->files[index];
+    D64Archive *d64 = D64Archive::makeD64ArchiveWithFile(path);
+
+    if (d64 == NULL) {
+        sprintf(result->message, "Cannot read D64 image");
+        result->code = RESULT_ERROR;
+        return;
+    }
+
+    // Check the error information stored in the image
+    unsigned tracks = d64->numberOfTracks(), badSectors = 0;
+    for (unsigned t = 1; t <= tracks; t++) {
+        for (unsigned s = 0; s < D64Archive::numberOfSectors(2 * t - 1); s++) {
+            if (d64->errorCode(t, s) > 1)
+                badSectors++;
+        }
+    }
+
+    // Encode the image and make sure that it decodes to the original data
+    disk->encodeArchive(d64);
+    D64Archive *decoded = D64Archive::makeD64ArchiveWithDisk(disk);
+    size_t size = d64->writeToBuffer(NULL);
+
+    if (decoded == NULL || decoded->writeToBuffer(NULL) != size ||
+        memcmp(decoded->getData(), d64->getData(), size) != 0) {
+        sprintf(result->message, "%d tracks, GCR round trip failed", tracks);
+        result->code = RESULT_ERROR;
+
+    } else if (job->target == G64_CONTAINER) {
+        G64Archive *g64 = G64Archive::makeG64ArchiveWithDisk(disk);
+        int err = g64 ? writeImage(job, g64, index, ".g64") : EINVAL;
+        if (err) {
+            sprintf(result->message, "%d tracks, cannot write G64 image (%s)", tracks, strerror(err));
+            result->code = RESULT_ERROR;
+        } else {
+            sprintf(result->message, "%d tracks, converted to G64", tracks);
+        }
+        delete g64;
+
+    } else {
+        sprintf(result->message, "%d tracks", tracks);
+    }
+
+    if (badSectors && result->code == RESULT_OK) {
+        sprintf(result->message + strlen(result->message), ", %d sectors marked bad", badSectors);
+        result->code = RESULT_WARNING;
+    }
+
+    delete decoded;
+    delete d64;
+}
+
+//! @brief    Checks a G64 or NIB image and converts it if requested
+static void
+processGCR(Job *job, Disk525 *disk, unsigned index, Result *result)
+{
+    const char *path = job->files[index];
+    bool isG64 = G64Archive::isG64File(path);
+
+    if (isG64) {
+
+        G64Archive *g64 = G64Archive::makeG64ArchiveWithFile(path);
+        if (g64 == NULL) {
+            sprintf(result->message, "Cannot read G64 image");
+            result->code = RESULT_ERROR;
+            return;
+        }
+        disk->encodeArchive(g64);
+        delete g64;
+
+    } else {
+
+        NIBArchive *nib = NIBArchive::makeNIBArchiveWithFile(path);
+        if (nib == NULL) {
+            sprintf(result->message, "Cannot read NIB image");
+            result->code = RESULT_ERROR;
+            return;
+        }
+        disk->encodeArchive(nib);
+        delete nib;
+    }
+
+    // Check if the disk can be decoded with the standard layout
+    D64Archive *d64 = D64Archive::makeD64ArchiveWithDisk(disk);
+    unsigned tracks = disk->numTracks;
+
+    if (d64) {
+        sprintf(result->message, "%d tracks", tracks);
+    } else {
+        sprintf(result->message, "%d tracks, no standard DOS layout", tracks);
+        result->code = RESULT_WARNING;
+    }
+
+    if (job->target == G64_CONTAINER && !isG64) {
+
+        G64Archive *g64 = G64Archive::makeG64ArchiveWithDisk(disk);
+        int err = g64 ? writeImage(job, g64, index, ".g64") : EINVAL;
+        if (err) {
+            sprintf(result->message + strlen(result->message), ", cannot write G64 image (%s)", strerror(err));
+            result->code = RESULT_ERROR;
+        } else {
+            strcat(result->message, ", converted to G64");
+        }
+        delete g64;
+    }
+
+    if (job->target == D64_CONTAINER) {
+
+        int err = d64 ? writeImage(job, d64, index, ".d64") : 0;
+        if (d64 == NULL) {
+            strcat(result->message, ", cannot convert to D64");
+            result->code = RESULT_ERROR;
+        } else if (err) {
+            sprintf(result->message + strlen(result->message), ", cannot write D64 image (%s)", strerror(err));
+            result->code = RESULT_ERROR;
+        } else {
+            strcat(result->message, ", converted to D64");
+        }
+    }
+
+    delete d64;
+}
+
+//! @brief    Worker thread
+static void *
+worker(void *arg)
+{
+    Job *job = (Job *)arg;
+    Disk525 *disk = new Disk525();
+
+    while (true) {
+
+        pthread_mutex_lock(&job->lock);
+        unsigned index = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        if (index >= job->count)
+            break;
+
+        const char *path = job->files[index];
+        Result *result = &job->results[index];
+        uint64_t start = usec();
+
+        result->code = RESULT_OK;
+        if (D64Archive::isD64File(path)) {
+            processD64(job, disk, index, result);
+        } else if (G64Archive::isG64File(path) || NIBArchive::isNIBFile(path)) {
+            processGCR(job, disk, index, result);
+        } else {
+            sprintf(result->message, "Unknown file format");
+            result->code = RESULT_ERROR;
+        }
+        result->time = usec() - start;
+    }
+
+    delete disk;
+    return NULL;
+}
+
+
+//
+// Main program
+//
+
+static void
+usage()
+{
+    fprintf(stderr,
+            "Usage: c64disk [-t d64|g64] [-o dir] [-f] [-j threads] [-q] file|directory ...\n"
+            "  -t  Convert all images to the specified format (default: check only)\n"
+            "      D64 images are converted to G64, G64 and NIB images to D64 or G64\n"
+            "  -o  Output directory (default: next to the input file)\n"
+            "      The directory layout below each directory argument is recreated\n"
+            "  -f  Overwrite existing files\n"
+            "  -j  Number of worker threads (default: one per CPU core)\n"
+            "  -q  Only report images with warnings or errors\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    Job job;
+    unsigned threads = 0;
+    bool quiet = false;
+    int opt;
+
+    memset(&job, 0, sizeof(job));
+    job.target = UNKNOWN_CONTAINER_FORMAT;
+
+    while ((opt = getopt(argc, argv, "t:o:fj:q")) != -1) {
+        switch (opt) {
+            case 't':
+                if (strcasecmp(optarg, "d64") == 0) {
+                    job.target = D64_CONTAINER;
+                } else if (strcasecmp(optarg, "g64") == 0) {
+                    job.target = G64_CONTAINER;
+                } else {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'o':
+                job.outdir = optarg;
+                break;
+            case 'f':
+                job.force = true;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (optind == argc) {
+        usage();
+        return 1;
+    }
+
+    // Only report warnings that are not reflected in the results
+    VC64Object::setDefaultDebugLevel(0);
+
+    for (int i = optind; i < argc; i++)
+        collectFiles(&job, argv[i]);
+    if (job.count == 0) {
+        fprintf(stderr, "No disk images found\n");
+        return 1;
+    }
+    job.results = (Result *)calloc(job.count, sizeof(Result));
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (unsigned)cores : 1;
+    }
+    if (threads > job.count) {
+        threads = job.count;
+    }
+
+    // Images are processed in parallel. Hence, NIB archives are scanned single-threaded.
+    NIBArchive::setScanThreads(1);
+
+    // The main thread is one of the workers
+    uint64_t start = usec();
+    pthread_t *workers = new pthread_t[threads];
+    unsigned started = 0;
+    for (unsigned i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, worker, &job) == 0)
+            started++;
+    }
+    worker(&job);
+
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    uint64_t elapsed = usec() - start;
+
+    // Report results
+    const char *label[] = { "OK     ", "WARNING", "ERROR  " };
+    unsigned count[3] = { 0, 0, 0 };
+    uint64_t total = 0;
+    for (unsigned i = 0; i < job.count; i++) {
+
+        Result *r = &job.results[i];
+        count[r->code]++;
+        total += r->time;
+        if (!quiet || r->code != RESULT_OK) {
+            printf("%s %8.2f ms  %s: %s\n", label[r->code], r->time / 1000.0, job.files[i], r->message);
+        }
+    }
+    printf("%u images (%u ok, %u warnings, %u errors) in %.2f s using %u threads (%.2f ms per image)\n",
+           job.count, count[RESULT_OK], count[RESULT_WARNING], count[RESULT_ERROR],
+           elapsed / 1000000.0, started + 1, total / 1000.0 / job.count);
+
+    for (unsigned i = 0; i < job.count; i++) {
+        free(job.files[i]);
+        free(job.dirs[i]);
+    }
+    free(job.files);
+    free(job.dirs);
+    free(job.results);
+    delete[] workers;
+    pthread_mutex_destroy(&job.lock);
+
+    return count[RESULT_ERROR] ? 2 : 0;
+}
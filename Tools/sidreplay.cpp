@@ -0,0 +1,135 @@
+/*!
+ * @header      sidreplay.cpp
+ * @author      agent
+ * @copyright   2026 agent
+ * @brief       Replay check for the structure-of-arrays clocking of the SID voices
+ * @details     The tool feeds a reproducible stream of random register writes into
+ *              reSID in all four sampling modes. It prints a checksum of the generated
+ *              samples, the OSC3 and ENV3 reads, and the final chip state per mode.
+ *              Build the tool once with RESID_SOA disabled and once with RESID_SOA
+ *              enabled. Both builds must print identical lines.
+ *
+ *              Build: c++ -O2 -DRESID_SOA=0 -I../C64/resid sidreplay.cpp ../C64/resid/*.cc -o sidreplay-scalar
+ *                     c++ -O2 -DRESID_SOA=1 -I../C64/resid sidreplay.cpp ../C64/resid/*.cc -o sidreplay-soa
+ *              Check: diff <(./sidreplay-scalar) <(./sidreplay-soa)
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+//! @brief    Number of register writes replayed per sampling mode
+static const unsigned numWrites = 60000;
+
+//! @brief    Reproducible pseudo random numbers (xorshift32)
+static uint32_t
+nextRandom(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+//! @brief    Folds data into a 64 bit FNV-1a checksum
+static void
+hash(uint64_t *checksum, const void *data, size_t length)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    for (size_t i = 0; i < length; i++) {
+        *checksum ^= ptr[i];
+        *checksum *= 0x100000001B3ULL;
+    }
+}
+
+//! @brief    Replays the write stream in a single sampling mode
+static uint64_t
+replay(sampling_method method, chip_model model, uint32_t seed)
+{
+    SID *sid = new SID();
+    uint64_t checksum = 0xCBF29CE484222325ULL;
+    uint32_t random = seed;
+    short buffer[1024];
+
+    sid->set_chip_model(model);
+    sid->set_sampling_parameters(985248, method, 44100);
+
+    for (unsigned i = 0; i < numWrites; i++) {
+
+        uint32_t r = nextRandom(&random);
+        reg8 offset = r % 0x19;
+        reg8 value = (r >> 8) & 0xFF;
+
+        // Let the chip run for a random number of cycles
+        cycle_count delta_t = 1 + (r >> 16) % 400;
+        while (delta_t > 0) {
+            int n = sid->clock(delta_t, buffer, 1024);
+            hash(&checksum, buffer, n * sizeof(short));
+        }
+
+        // Keep the waveform and the gate bit in a useful range most of the time
+        if (offset % 7 == 4 && (r >> 28) != 0) {
+            value = (value & 0xF1) | (1 << (4 + (r >> 24) % 4));
+        }
+        sid->write(offset, value);
+
+        reg8 osc3 = sid->read(0x1B);
+        reg8 env3 = sid->read(0x1C);
+        hash(&checksum, &osc3, 1);
+        hash(&checksum, &env3, 1);
+    }
+
+    SID::State state = sid->read_state();
+    hash(&checksum, state.sid_register, sizeof(state.sid_register));
+    hash(&checksum, state.accumulator, sizeof(state.accumulator));
+    hash(&checksum, state.shift_register, sizeof(state.shift_register));
+    hash(&checksum, state.rate_counter, sizeof(state.rate_counter));
+    hash(&checksum, state.exponential_counter, sizeof(state.exponential_counter));
+    hash(&checksum, state.envelope_counter, sizeof(state.envelope_counter));
+    hash(&checksum, state.envelope_state, sizeof(state.envelope_state));
+    hash(&checksum, state.hold_zero, sizeof(state.hold_zero));
+
+    delete sid;
+    return checksum;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct { sampling_method method; const char *name; } modes[] = {
+        { SAMPLE_FAST, "SAMPLE_FAST" },
+        { SAMPLE_INTERPOLATE, "SAMPLE_INTERPOLATE" },
+        { SAMPLE_RESAMPLE_INTERPOLATE, "SAMPLE_RESAMPLE_INTERPOLATE" },
+        { SAMPLE_RESAMPLE_FAST, "SAMPLE_RESAMPLE_FAST" }
+    };
+    uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 0x1541;
+
+    if (seed == 0) {
+        fprintf(stderr, "Usage: %s [seed]   (seed must not be 0)\n", argv[0]);
+        return 1;
+    }
+
+    for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        printf("%-28s 6581 %016llx  8580 %016llx\n", modes[i].name,
+               (unsigned long long)replay(modes[i].method, MOS6581, seed),
+               (unsigned long long)replay(modes[i].method, MOS8580, seed));
+    }
+    return 0;
+}